@@ -12,6 +12,8 @@
 #include <iostream>
 #include <cstring>
 #include <functional>
+#include <atomic>
+#include <thread>
 #include "adefs.h"
 #include "package_fs.h"
 
@@ -30,6 +32,7 @@ MountPoint::MountPoint(const std::string & name,Attributes attr,MountPoint * p_p
 	: m_p_parent(p_parent)
 	, m_name(name)
 	, m_attributes(attr)
+	, m_b_lazy_pending(false)
 {
 }
 
@@ -45,14 +48,31 @@ MountPoint::reset()
 	m_children.clear();
 	m_directories.clear();
 	m_name.clear();
+
+	{
+		std::unique_lock<std::mutex> lazy_lock(m_lazy_mutex);
+		m_lazy_mounts.clear();
+		m_b_lazy_pending = false;
+	}
+
 	m_attributes = 0;
 	m_p_parent = nullptr;
 }
 
 
+std::uint64_t
+MountPoint::next_mount_order()
+{
+	static std::atomic<std::uint64_t> s_order(0);
+	return ++s_order;
+}
+
 MountPoint *					
-MountPoint::get_mountpoint(const std::string & path,bool b_create)
+MountPoint::get_mountpoint(const std::string & path,bool b_create,bool b_resolve)
 {
+	if(b_resolve)
+		resolve_lazy_mounts();
+
 	//-------------------------------------------------------------------------
 	//	If the path is empty then this is the mountpoint that we are looking 
 	//	for.
@@ -64,7 +84,7 @@ MountPoint::get_mountpoint(const std::string & path,bool b_create)
 	//	Strip any leading '/'.
 	//-------------------------------------------------------------------------
 	if(path[0] == '/')
-		return get_mountpoint(path.substr(1));
+		return get_mountpoint(path.substr(1),b_create,b_resolve);
 	
 	//-------------------------------------------------------------------------
 	//	Peel off the first directory name from the path.
@@ -88,7 +108,7 @@ MountPoint::get_mountpoint(const std::string & path,bool b_create)
 	//-------------------------------------------------------------------------
 	auto ifind = m_children.find(sub_dir);
 	if(ifind != m_children.end())
-		return ifind->second->get_mountpoint(sub_path);
+		return ifind->second->get_mountpoint(sub_path,b_create,b_resolve);
 
 	//-------------------------------------------------------------------------
 	//	The mountpoint was not found so create it if b_create is true.
@@ -101,7 +121,7 @@ MountPoint::get_mountpoint(const std::string & path,bool b_create)
 		{
 			mountpoint_shared_ptr p_new_mp = std::make_shared<MountPoint>(sub_dir,m_attributes,this);
 			m_children[sub_dir] = p_new_mp;
-			p_mp = p_new_mp->get_mountpoint(sub_path,b_create);
+			p_mp = p_new_mp->get_mountpoint(sub_path,b_create,b_resolve);
 		}
 		catch(...){}
 	}
@@ -112,6 +132,12 @@ MountPoint::get_mountpoint(const std::string & path,bool b_create)
 
 int								
 MountPoint::mount(const std::string & path,directory_shared_ptr p_dir)
+{
+	return mount(path,p_dir,next_mount_order());
+}
+
+int								
+MountPoint::mount(const std::string & path,directory_shared_ptr p_dir,std::uint64_t order)
 {
 	bool err = false;
 
@@ -121,13 +147,13 @@ MountPoint::mount(const std::string & path,directory_shared_ptr p_dir)
 	if(path.empty())
 	{
 		//std::cout << "Adding directory to path '" << fullpath() << "'" << std::endl;
-		m_directories.push_back(p_dir);
+		insert_directory(p_dir,order);
 	}
 	//-------------------------------------------------------------------------
 	//	If the path starts with a '/' then strip it.
 	//-------------------------------------------------------------------------
 	else if(path[0] == '/')
-		err = !!mount(path.substr(1),p_dir);
+		err = !!mount(path.substr(1),p_dir,order);
 	else
 	{
 		//---------------------------------------------------------------------
@@ -172,16 +198,113 @@ MountPoint::mount(const std::string & path,directory_shared_ptr p_dir)
 		//	it.
 		//---------------------------------------------------------------------
 		if(!err && p_mp)
-			err = !!p_mp->mount(sub_path,p_dir);			
+			err = !!p_mp->mount(sub_path,p_dir,order);			
 	}	
 
 	return (err ? -1 : 0);
 }
 
+void
+MountPoint::insert_directory(directory_shared_ptr p_dir,std::uint64_t order)
+{
+	//-------------------------------------------------------------------------
+	//	The directories are kept in mount order. Normal mounts always go on
+	//	the end, only lazy mounts are inserted further down.
+	//-------------------------------------------------------------------------
+	auto ipos = std::upper_bound(	m_directories.begin(),m_directories.end(),order,
+									[](std::uint64_t value,const MountedDirectory & dir) {return value < dir.order;} );
+
+	MountedDirectory dir;
+	dir.p_directory	= p_dir;
+	dir.order		= order;
+
+	m_directories.insert(ipos,dir);
+}
+
+int
+MountPoint::mount_lazy(const std::string & path,std::shared_ptr<IPackage> p_package)
+{
+	if(!p_package)
+		return -1;
+
+	auto p_mp = get_mountpoint(path,true,false);
+	if(!p_mp)
+		return -1;
+
+	std::unique_lock<std::mutex> lock(p_mp->m_lazy_mutex);
+
+	LazyMount lazy;
+	lazy.p_package	= p_package;
+	lazy.order		= next_mount_order();
+
+	p_mp->m_lazy_mounts.push_back(lazy);
+	p_mp->m_b_lazy_pending.store(true,std::memory_order_release);
+
+	return 0;
+}
+
+void
+MountPoint::resolve_lazy_mounts()
+{
+	if(!m_b_lazy_pending.load(std::memory_order_acquire))
+		return;
+
+	//-------------------------------------------------------------------------
+	//	Lookups that arrive while the packages are being scanned wait here
+	//	until the scan has finished, so each package is only scanned once.
+	//-------------------------------------------------------------------------
+	std::unique_lock<std::mutex> lock(m_lazy_mutex);
+
+	if(!m_b_lazy_pending.load(std::memory_order_relaxed))
+		return;
+
+	for(auto & lazy : m_lazy_mounts)
+	{
+		//---------------------------------------------------------------------
+		//	Mount the package into a private tree and then move its 
+		//	directories into this one at the position that it was mounted.
+		//---------------------------------------------------------------------
+		MountPoint staging("",m_attributes,nullptr);
+
+		try
+		{
+			if(!lazy.p_package->scan() && !lazy.p_package->mount(&staging))
+				splice(staging,lazy.order);
+		}
+		catch(...){}
+	}
+
+	m_lazy_mounts.clear();
+	m_b_lazy_pending.store(false,std::memory_order_release);
+}
+
+void
+MountPoint::splice(MountPoint & source,std::uint64_t order)
+{
+	for(auto & dir : source.m_directories)
+	{
+		auto p_dir = dir.p_directory.lock();
+		if(p_dir)
+			insert_directory(p_dir,order);
+	}
+
+	for(auto & mp_pair : source.m_children)
+	{
+		auto & p_mp = m_children[mp_pair.first];
+
+		if(!p_mp)
+			p_mp = std::make_shared<MountPoint>(mp_pair.first,m_attributes,this);
+
+		std::unique_lock<std::mutex> lock(p_mp->m_lazy_mutex);
+		p_mp->splice(*mp_pair.second,order);
+	}
+}
+
 
 IDirectory *
 MountPoint::find_file_owner(const std::string & path,Attributes required_attributes)
 {
+	resolve_lazy_mounts();
 
 	if(path[0] == '/')
 		return find_file_owner(path.substr(1));
@@ -206,7 +329,7 @@ MountPoint::find_file_owner(const std::string & path,Attributes required_attribu
 
 			while((idb != ide) && !p_owner)
 			{
-				auto p_dir = (*idb++).lock();
+				auto p_dir = (idb++)->p_directory.lock();
 		
 				if(!p_dir || ((p_dir->dir_attr() & required_attributes)!=required_attributes))
 					continue;
@@ -263,7 +386,7 @@ MountPoint::load(	const std::string &											filename,
 {
 	size_t size = 0;
 
-	auto p_file = openfile(filename);
+	auto p_file = openfile(filename,MODE_READ | MODE_STREAM);
 
 	if(p_file)
 	{
@@ -318,13 +441,15 @@ MountPoint::openfile(	const std::string & filename,
 void
 MountPoint::write_tree(std::ostream & stream,std::string & prefix)
 {
+	resolve_lazy_mounts();
+
 	stream << prefix << "+=[" << m_name << "]" << std::endl;
 
 	for(auto & dir : m_directories)
 	{
-		if(!dir.expired())
+		auto pdir = dir.p_directory.lock();
+		if(pdir)
 		{
-			auto pdir = dir.lock();
 			auto files = pdir->file_list();
 
 			for(auto & name : files)
@@ -391,14 +516,26 @@ AdeFS::mount(directory_shared_ptr p_dir,const std::string & mountpoint)
 }
 
 int
-AdeFS::mount(const std::string & package_name,const std::string & mountpoint)
+AdeFS::mount(const std::string & package_name,const std::string & mountpoint,bool b_lazy)
 {
+	//-------------------------------------------------------------------------
+	//	A lazy package is created now but is not scanned until it is used.
+	//-------------------------------------------------------------------------
+	if(b_lazy)
+	{
+		package_shared_ptr p_package = new_package(package_name);
+		if(!p_package || m_root.mount_lazy(mountpoint,p_package))
+			return -1;
+
+		m_owned_packages.push_back(p_package);
+		return 0;
+	}
 
 	package_shared_ptr p_package = create_package(package_name);
 	if(!p_package)
 		return -1;
 
-	auto p_mp = m_root.get_mountpoint(mountpoint);
+	auto p_mp = m_root.get_mountpoint(mountpoint,true,false);
 	if(!p_mp)
 		return -1;
 
@@ -410,6 +547,93 @@ AdeFS::mount(const std::string & package_name,const std::string & mountpoint)
 	return 0;
 }
 
+int
+AdeFS::mount(package_shared_ptr p_package,const std::string & mountpoint)
+{
+	if(!p_package || p_package->scan())
+		return -1;
+
+	auto p_mp = m_root.get_mountpoint(mountpoint,true,false);
+	if(!p_mp || p_package->mount(p_mp))
+		return -1;
+
+	m_owned_packages.push_back(p_package);
+
+	return 0;
+}
+
+int
+AdeFS::mount_many(const std::vector<MountRequest> & requests,unsigned thread_count)
+{
+	bool err = false;
+
+	//-------------------------------------------------------------------------
+	//	Create the packages on this thread. The factories are not required to
+	//	be thread safe, only the packages that they create.
+	//-------------------------------------------------------------------------
+	std::vector<package_shared_ptr>	packages(requests.size());
+	std::vector<char>				scanned(requests.size(),0);
+
+	for(size_t i = 0;i < requests.size();++i)
+		packages[i] = new_package(requests[i].package_name);
+
+	//-------------------------------------------------------------------------
+	//	Scan the packages in parallel. Each worker takes the next package from
+	//	the list until there are none left.
+	//-------------------------------------------------------------------------
+	std::atomic<size_t> next(0);
+
+	auto worker = [&]()
+	{
+		for(size_t i = next++;i < packages.size();i = next++)
+		{
+			try
+			{
+				if(packages[i] && !packages[i]->scan())
+					scanned[i] = 1;
+			}
+			catch(...){}
+		}
+	};
+
+	if(!thread_count)
+		thread_count = std::max(1u,std::thread::hardware_concurrency());
+
+	thread_count = static_cast<unsigned>(std::min<size_t>(thread_count,packages.size()));
+
+	std::vector<std::thread> threads;
+
+	try
+	{
+		for(unsigned i = 1;i < thread_count;++i)
+			threads.emplace_back(worker);
+	}
+	catch(...){}
+
+	worker();
+
+	for(auto & thread : threads)
+		thread.join();
+
+	//-------------------------------------------------------------------------
+	//	Mount the packages in the order that they were requested.
+	//-------------------------------------------------------------------------
+	for(size_t i = 0;i < requests.size();++i)
+	{
+		auto p_mp = (scanned[i] ? m_root.get_mountpoint(requests[i].mountpoint,true,false) : nullptr);
+
+		if(!p_mp || packages[i]->mount(p_mp))
+		{
+			err = true;
+			continue;
+		}
+
+		m_owned_packages.push_back(packages[i]);
+	}
+
+	return (err ? -1 : 0);
+}
+
 size_t
 AdeFS::load(const std::string & filename,
 			char *				p_buffer,
@@ -485,6 +709,25 @@ AdeFS::get_package_factory(const std::string & package_name)
 
 package_shared_ptr 
 AdeFS::create_package(const std::string & package_name)
+{
+	package_shared_ptr p_pkg;
+
+	try
+	{
+		auto p_np = new_package(package_name);
+		if(p_np && !p_np->scan())
+			p_pkg = p_np;
+	}
+	catch(...){}
+
+	return p_pkg;
+}
+
+//-----------------------------------------------------------------------------
+//	Create a package object without scanning it.
+//-----------------------------------------------------------------------------
+package_shared_ptr 
+AdeFS::new_package(const std::string & package_name)
 {
 	package_shared_ptr p_pkg;
 	auto p_factory = get_package_factory(package_name);
@@ -493,11 +736,7 @@ AdeFS::create_package(const std::string & package_name)
 	//	If a factory was found then use it to create a package.
 	//-------------------------------------------------------------------------
 	if(p_factory)
-	{
-		auto p_np = p_factory->create_package(package_name);
-		if(p_np && !p_np->scan())
-			p_pkg = p_np;
-	}
+		p_pkg = p_factory->create_package(package_name);
 	//-------------------------------------------------------------------------
 	//	If the package type is unknown then attempt to create a FS package.
 	//-------------------------------------------------------------------------
@@ -505,9 +744,7 @@ AdeFS::create_package(const std::string & package_name)
 	{
 		try
 		{
-			auto p_np = std::make_shared<package_fs::PackageFS>(package_name);
-			if(!p_np->scan())
-				p_pkg = p_np;
+			p_pkg = std::make_shared<package_fs::PackageFS>(package_name);
 		}
 		catch(...){}
 	}
@@ -560,13 +797,13 @@ FileInMemory::FileInMemory(	std::uint32_t	mode,
 int								
 FileInMemory::get()
 {
-	int value {0};
+	int value {EOF};
 
 	if(m_position >= m_data.size())
 		m_count = 0;
 	else
 	{
-		value = m_data.at(m_position);
+		value = static_cast<unsigned char>(m_data[m_position]);
 		++m_position;
 		m_count = 1;
 	}
@@ -587,6 +824,7 @@ FileInMemory::read(char * p_buffer,size_t size)
 		sz = std::min(size,m_data.size()-m_position);
 		if(sz)
 			std::memcpy(p_buffer,&m_data[m_position],sz);
+		m_position += static_cast<filepos>(sz);
 	}
 
 	m_count = sz;
@@ -606,30 +844,57 @@ FileInMemory::write(const char * p_data,size_t size)
 		if((m_position + size) > m_data.size())
 			m_data.resize(m_position + size);
 		std::memcpy(&m_data[m_position],p_data,size);
+		m_position += static_cast<filepos>(size);
 	}
 }
 
 void							
-FileInMemory::ignore(size_t /*count*/,int /*delimeter*/)
+FileInMemory::ignore(size_t count,int delimeter)
 {
+	if(m_position >= m_data.size())
+		return;
+
+	const size_t avail = std::min(count,m_data.size() - m_position);
+
+	if(delimeter < 0)
+		m_position += static_cast<filepos>(avail);
+	else
+	{
+		auto p_found = static_cast<const char *>(std::memchr(&m_data[m_position],delimeter,avail));
+		m_position = (p_found ? static_cast<filepos>(p_found - &m_data[0]) + 1 : m_position + static_cast<filepos>(avail));
+	}
 }
 
 void							
 FileInMemory::seek(filepos pos)
 {
-	m_position = pos;
+	//-------------------------------------------------------------------------
+	//	Files that can be written may be extended by seeking past the end.
+	//	Read only files stop at the end like the files in packages.
+	//-------------------------------------------------------------------------
+	m_position = ((m_mode & MODE_WRITE) ? pos : std::min<filepos>(pos,m_data.size()));
 }
 
 void							
-FileInMemory::seek(fileoffset /*offset*/,adefs::Seek /*dir*/)
+FileInMemory::seek(fileoffset offset,adefs::Seek dir)
 {
+	fileoffset pos;
 
+	switch(dir)
+	{
+		case adefs::Seek::BEGINNING :	pos = offset;										break;
+		case adefs::Seek::CURRENT :		pos = static_cast<fileoffset>(m_position) + offset;	break;
+		case adefs::Seek::END :			pos = static_cast<fileoffset>(m_data.size()) + offset;	break;
+		default :						return;
+	}
+
+	seek(static_cast<filepos>(pos < 0 ? 0 : pos));
 }
 
 size_t							
 FileInMemory::tell()
 {
-	return 0;
+	return m_position;
 }
 
 //-------------------------------------------------------------------------
@@ -641,6 +906,59 @@ FileInMemory::resize(size_t size)
 	m_data.resize(size);
 }
 
+//=============================================================================
+//
+//
+//	FILE - MEMORY VIEW
+//
+//
+//=============================================================================
+
+size_t
+FileMemoryView::read(char * p_buffer,size_t size)
+{
+	m_count = 0;
+
+	if(p_buffer && (m_position < m_size))
+	{
+		m_count = std::min(size,m_size - m_position);
+		std::memcpy(p_buffer,m_p_data + m_position,m_count);
+		m_position += m_count;
+	}
+
+	return m_count;
+}
+
+void
+FileMemoryView::ignore(size_t count,int delimeter)
+{
+	const size_t avail = std::min(count,m_size - std::min(m_position,m_size));
+
+	if(delimeter < 0)
+		m_position += avail;
+	else
+	{
+		auto p_found = static_cast<const char *>(std::memchr(m_p_data + m_position,delimeter,avail));
+		m_position = (p_found ? static_cast<size_t>(p_found - m_p_data) + 1 : m_position + avail);
+	}
+}
+
+void
+FileMemoryView::seek(fileoffset offset,adefs::Seek dir)
+{
+	fileoffset pos;
+
+	switch(dir)
+	{
+		case adefs::Seek::BEGINNING :	pos = offset;										break;
+		case adefs::Seek::CURRENT :		pos = static_cast<fileoffset>(m_position) + offset;	break;
+		case adefs::Seek::END :			pos = static_cast<fileoffset>(m_size) + offset;		break;
+		default :						return;
+	}
+
+	m_position = std::min<size_t>((pos < 0 ? 0 : static_cast<size_t>(pos)),m_size);
+}
+
 
 
 } // namespace adefs
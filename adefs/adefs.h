@@ -12,6 +12,7 @@
 #define GUARD_ADEFS_H
 
 #include <fstream>
+#include <cstdio>
 #include <cstdint>
 #include <memory>
 #include <algorithm>
@@ -21,6 +22,7 @@
 #include <cassert>
 #include <mutex>
 #include <functional>
+#include <atomic>
 
 #define ADEFS_VERSION					0x010000
 #define ADEFS_VERSION_STRING	"1.0.0"
@@ -38,8 +40,8 @@ namespace adefs
 
 typedef std::uint32_t	Handle;
 typedef std::uint16_t	Attributes;
-typedef std::int32_t	fileoffset;
-typedef std::uint32_t	filepos;
+typedef std::int64_t	fileoffset;
+typedef std::uint64_t	filepos;
 
 enum
 {
@@ -55,7 +57,8 @@ enum
 	MODE_WRITE		=	0x00002,
 	MODE_APPEND		=	0x00004,
 	MODE_AT_END		=	0x00008,
-	MODE_TRUNCATE	=	0x00010
+	MODE_TRUNCATE	=	0x00010,
+	MODE_STREAM		=	0x00020		// Sequential access hint. Compressed files may be decoded as they are read.
 };
 
 enum ErrorCode
@@ -71,7 +74,7 @@ enum class Seek
 {
 	BEGINNING,
 	CURRENT,
-	END
+	END						// The offset is added to the size of the file, as with fseek().
 };
 
 
@@ -120,6 +123,8 @@ split_path(	const std::string & in_path,
 class IFile
 {
 public:
+	virtual						~IFile() = default;
+
 	virtual int				get() = 0;
 	virtual	size_t		read(char * p_buffer,size_t size) = 0;
 	virtual	void			write(const char * p_data,size_t size) = 0;
@@ -174,17 +179,75 @@ public:
 	void			seek(fileoffset offset,adefs::Seek dir);
 	size_t		tell();
 	bool			is_fail() 		{return m_b_fail;}
-	bool			is_eof()			{return !!(m_position > m_data.size());}
+	bool			is_eof()			{return !!(m_position >= m_data.size());}
 	size_t		count()				{return m_count;}
 
 	//-------------------------------------------------------------------------
 	//	BUFFER FUNCTIONS
 	//-------------------------------------------------------------------------
 	void			resize(size_t size);
+	void			swap(std::vector<char> & data)	{m_data.swap(data);}
 	char *		data()			{return (m_data.empty() ? nullptr : &m_data[0]);}
 	size_t		size() 			{return m_data.size();}
 };
 
+//=============================================================================
+//
+//
+//	FILE - MEMORY VIEW
+//
+//	A read-only file over memory that is owned by something else (eg. a
+//	cache buffer or a mapped file). The owner is kept alive for as long as 
+//	the view exists.
+//
+//=============================================================================
+
+class FileMemoryView : public IFile
+{
+private:
+	std::shared_ptr<const void>	m_p_owner;
+	const char *				m_p_data;
+	size_t						m_size;
+	size_t						m_position		= 0;
+	size_t						m_count			= 0;
+
+public:
+	FileMemoryView(void) = delete;
+	FileMemoryView(const FileMemoryView &) = delete;
+	FileMemoryView & operator=(const FileMemoryView &) = delete;
+
+	FileMemoryView(	std::shared_ptr<const void>	p_owner,
+									const char *								p_data,
+									size_t											size )
+		: m_p_owner(std::move(p_owner))
+		, m_p_data(p_data)
+		, m_size(size)
+	{
+	}
+
+	~FileMemoryView(void) = default;
+
+	//-------------------------------------------------------------------------
+	//	INTERFACE FUNCTIONS
+	//-------------------------------------------------------------------------
+	int				get()					{m_count = (m_position < m_size ? 1 : 0); return (m_count ? static_cast<unsigned char>(m_p_data[m_position++]) : EOF);}
+	size_t		read(char * p_buffer,size_t size);
+	void			write(const char * /*p_data*/,size_t /*size*/) {}
+	void			ignore(size_t count,int delimeter = -1);
+	void			seek(filepos pos)		{m_position = std::min<size_t>(pos,m_size);}
+	void			seek(fileoffset offset,adefs::Seek dir);
+	size_t		tell()					{return m_position;}
+	bool			is_fail() 			{return false;}
+	bool			is_eof()				{return m_position >= m_size;}
+	size_t		count()					{return m_count;}
+	size_t		size() 					{return m_size;}
+
+	//-------------------------------------------------------------------------
+	//	BUFFER FUNCTIONS
+	//-------------------------------------------------------------------------
+	const char *	data() const	{return m_p_data;}
+};
+
 //=============================================================================
 //
 //
@@ -311,12 +374,32 @@ typedef std::weak_ptr<class MountPoint>		mountpoint_weak_ptr;
 class MountPoint
 {
 private:
+	//-------------------------------------------------------------------------
+	//	Every mount is given an order number so that directories that are 
+	//	added late (by a lazy mount) still sit below the ones mounted after
+	//	them.
+	//-------------------------------------------------------------------------
+	struct MountedDirectory
+	{
+		directory_weak_ptr													p_directory;
+		std::uint64_t																order;
+	};
+
+	struct LazyMount
+	{
+		std::shared_ptr<class IPackage>							p_package;
+		std::uint64_t																order;
+	};
+
 	MountPoint *																	m_p_parent;
 	std::map<std::string,mountpoint_shared_ptr>		m_children;
-	std::vector<directory_weak_ptr>								m_directories;
+	std::vector<MountedDirectory>									m_directories;
 	std::string																		m_name;
 	Attributes																		m_attributes;
 	std::mutex																		m_mutex;			// Mutex for exclusive access.
+	std::vector<LazyMount>												m_lazy_mounts;		// Packages that will be scanned on first use.
+	std::atomic<bool>															m_b_lazy_pending;	// True while m_lazy_mounts is not empty.
+	std::mutex																		m_lazy_mutex;		// Makes sure that each lazy mount is only resolved once.
 
 public:
 	MountPoint(void) = delete;
@@ -326,8 +409,14 @@ public:
 	MountPoint(const std::string & name,Attributes attr,MountPoint * p_parent);
 	~MountPoint(void);
 
-	MountPoint *						get_mountpoint(const std::string & path,bool b_create=true);
+													// Find a mountpoint. Lazily mounted packages on the way are scanned 
+													// unless b_resolve is false.
+	MountPoint *						get_mountpoint(const std::string & path,bool b_create=true,bool b_resolve=true);
 	int											mount(const std::string & path,directory_shared_ptr p_dir);
+
+													// Register a package that has not been scanned yet. It is scanned and 
+													// mounted the first time that a lookup reaches this mountpoint.
+	int											mount_lazy(const std::string & path,std::shared_ptr<class IPackage> p_package);
 	const std::string &			name() {return m_name;}
 	std::string							fullpath() {if(!m_p_parent) return m_name; return m_p_parent->fullpath() + "/" + m_name;}
 
@@ -360,6 +449,12 @@ public:
 
 private:
 	IDirectory *						find_file_owner(const std::string & path,Attributes required_attributes = 0);
+	int											mount(const std::string & path,directory_shared_ptr p_dir,std::uint64_t order);
+	void										insert_directory(directory_shared_ptr p_dir,std::uint64_t order);
+	void										resolve_lazy_mounts();
+	void										splice(MountPoint & source,std::uint64_t order);
+
+	static std::uint64_t		next_mount_order();
 
 };
 
@@ -370,12 +465,37 @@ private:
 //
 //
 //=============================================================================
+//-----------------------------------------------------------------------------
+//	Describes a file when the contents of a package are enumerated.
+//-----------------------------------------------------------------------------
+struct PackageEntry
+{
+	std::string				path;					// The path of the file within the package.
+	std::uint64_t			size				= 0;	// The size of the file.
+	std::uint64_t			stored_size	= 0;	// The size of the file's data in the package.
+	std::uint64_t			offset			= 0;	// The offset of the file's data in the package.
+	std::uint32_t			compression	= 0;	// The compression method (see decompressor.h).
+	std::uint32_t			crc					= 0;	// The CRC-32 of the file if the package stores one, otherwise zero.
+};
+
+												// Called for each file by IPackage::for_each_entry(). Returning 
+												// non-zero stops the enumeration.
+typedef std::function<int(const PackageEntry & entry,IFile & file)>	package_entry_func;
+
 class IPackage
 {
 public:
 	virtual int								mount(MountPoint * p_mountpoint) = 0;
 	virtual int								scan() = 0;
 	virtual Attributes				attributes() const = 0;
+
+														// Visit every file in the package in the order that the data is stored
+														// so that the package is read from start to end rather than seeking 
+														// for each file. 'func' is given a reader that streams the file's data.
+														// If func returns non-zero then the enumeration stops and that value is
+														// returned. Returns -1 if any file could not be read or if the package
+														// does not support enumeration.
+	virtual int								for_each_entry(const package_entry_func & /*func*/) {return -1;}
 };
 
 typedef std::shared_ptr<IPackage>	package_shared_ptr;
@@ -412,6 +532,16 @@ typedef std::weak_ptr<IPackageFactory>		package_factory_weak_ptr;
 
 class AdeFS
 {
+public:
+	//-------------------------------------------------------------------------
+	//	A package to be mounted by mount_many().
+	//-------------------------------------------------------------------------
+	struct MountRequest
+	{
+		std::string				package_name;
+		std::string				mountpoint;
+	};
+
 private:
 	MountPoint																				m_root;
 	std::vector<package_shared_ptr>										m_owned_packages;
@@ -425,8 +555,22 @@ public:
 	AdeFS(void);
 	~AdeFS(void);
 
-	int									mount(const std::string & package_name,const std::string & mountpoint = "/");
+											// Mount a package. If b_lazy is true then the package is not scanned 
+											// until a lookup first reaches its mountpoint.
+	int									mount(const std::string & package_name,const std::string & mountpoint = "/",bool b_lazy = false);
 	int									mount(directory_shared_ptr p_dir,const std::string & mountpoint = "/");
+
+											// Scan and mount a package that was created by the caller, for example
+											// one that reads from another package. The file system keeps the 
+											// package alive.
+	int									mount(package_shared_ptr p_package,const std::string & mountpoint = "/");
+
+											// Mount a list of packages. The packages are scanned in parallel on up to 
+											// 'thread_count' threads (0 means one per core) and are then mounted in 
+											// the order of the list, so later packages overlay earlier ones exactly 
+											// as if mount() had been called for each in turn. Packages that fail are 
+											// skipped and -1 is returned once the others have been mounted.
+	int									mount_many(const std::vector<MountRequest> & requests,unsigned thread_count = 0);
 	MountPoint *				get_mountpoint(const std::string & path="",bool b_create=true) {return m_root.get_mountpoint(path,b_create);}
 
 	size_t							load(	const std::string & filename,
@@ -459,6 +603,7 @@ public:
 private:
 	package_factory_shared_ptr	get_package_factory(const std::string & package_name);
 	package_shared_ptr					create_package(const std::string & package_name);
+	package_shared_ptr					new_package(const std::string & package_name);
 
 };
 
@@ -0,0 +1,204 @@
+//=============================================================================
+//	FILE:					block_cache.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Sharded LRU cache of package data blocks.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <algorithm>
+#include <thread>
+#include "block_cache.h"
+
+namespace adefs
+{
+
+std::atomic<std::uint32_t>	BlockCache::s_next_owner(1);
+
+BlockCache::BlockCache(size_t budget,unsigned shard_count)
+{
+	//-------------------------------------------------------------------------
+	//	By default there are a couple of shards per core, but not so many that
+	//	a shard's share of the budget drops below 1MB.
+	//-------------------------------------------------------------------------
+	if(!shard_count)
+	{
+		const size_t max_shards = std::max<size_t>(1,budget / (1024 * 1024));
+
+		shard_count = static_cast<unsigned>(std::min<size_t>(std::max(1u,std::thread::hardware_concurrency()) * 2,max_shards));
+	}
+
+	m_shards.reserve(shard_count);
+	for(unsigned index = 0;index < shard_count;++index)
+		m_shards.emplace_back(new Shard);
+
+	set_budget(budget);
+}
+
+BlockCache::block_shared_ptr
+BlockCache::find(std::uint32_t owner,std::uint32_t block)
+{
+	const Key	key{owner,block};
+	Shard &		shard = get_shard(key);
+
+	std::unique_lock<std::mutex> lock(shard.mutex);
+
+	auto ifind = shard.index.find(key);
+	if(ifind == shard.index.end())
+	{
+		++shard.stats.misses;
+		return nullptr;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Move the block to the front of the list to mark it as most recently
+	//	used.
+	//-------------------------------------------------------------------------
+	shard.entries.splice(shard.entries.begin(),shard.entries,ifind->second);
+	++shard.stats.hits;
+
+	return ifind->second->p_block;
+}
+
+BlockCache::block_shared_ptr
+BlockCache::insert(std::uint32_t owner,std::uint32_t block,const char * p_data,size_t size)
+{
+	const Key	key{owner,block};
+	Shard &		shard = get_shard(key);
+
+	block_shared_ptr p_block = std::make_shared<const std::vector<char>>(p_data,p_data + size);
+
+	std::unique_lock<std::mutex> lock(shard.mutex);
+
+	//-------------------------------------------------------------------------
+	//	Blocks that would never fit are passed straight back to the caller.
+	//-------------------------------------------------------------------------
+	if(size > shard.stats.budget)
+		return p_block;
+
+	//-------------------------------------------------------------------------
+	//	If another thread inserted the same block first then use theirs.
+	//-------------------------------------------------------------------------
+	auto ifind = shard.index.find(key);
+	if(ifind != shard.index.end())
+	{
+		shard.entries.splice(shard.entries.begin(),shard.entries,ifind->second);
+		return ifind->second->p_block;
+	}
+
+	shard.entries.push_front(Entry{key,p_block});
+	shard.index[key] = shard.entries.begin();
+
+	++shard.stats.blocks;
+	shard.stats.bytes += size;
+
+	trim(shard);
+
+	return p_block;
+}
+
+void
+BlockCache::erase_owner(std::uint32_t owner)
+{
+	for(auto & p_shard : m_shards)
+	{
+		std::unique_lock<std::mutex> lock(p_shard->mutex);
+
+		auto it = p_shard->entries.begin();
+		while(it != p_shard->entries.end())
+		{
+			if(it->key.owner == owner)
+			{
+				--p_shard->stats.blocks;
+				p_shard->stats.bytes -= it->p_block->size();
+				p_shard->index.erase(it->key);
+				it = p_shard->entries.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+}
+
+void
+BlockCache::clear()
+{
+	for(auto & p_shard : m_shards)
+	{
+		std::unique_lock<std::mutex> lock(p_shard->mutex);
+
+		p_shard->entries.clear();
+		p_shard->index.clear();
+		p_shard->stats.blocks	= 0;
+		p_shard->stats.bytes	= 0;
+	}
+}
+
+void
+BlockCache::set_budget(size_t budget)
+{
+	const size_t share = budget / m_shards.size();
+
+	for(auto & p_shard : m_shards)
+	{
+		std::unique_lock<std::mutex> lock(p_shard->mutex);
+
+		p_shard->stats.budget = share;
+		trim(*p_shard);
+	}
+}
+
+size_t
+BlockCache::budget() const
+{
+	return statistics().budget;
+}
+
+BlockCache::Statistics
+BlockCache::statistics() const
+{
+	Statistics stats;
+
+	for(auto & p_shard : m_shards)
+	{
+		std::unique_lock<std::mutex> lock(p_shard->mutex);
+
+		stats.hits		+= p_shard->stats.hits;
+		stats.misses	+= p_shard->stats.misses;
+		stats.evictions	+= p_shard->stats.evictions;
+		stats.blocks	+= p_shard->stats.blocks;
+		stats.bytes		+= p_shard->stats.bytes;
+		stats.budget	+= p_shard->stats.budget;
+	}
+
+	return stats;
+}
+
+void
+BlockCache::trim(Shard & shard)
+{
+	//-------------------------------------------------------------------------
+	//	Evict the least recently used blocks until the shard is within its
+	//	budget. Blocks are only held outside of the cache while they are being
+	//	copied, so a block that is in use is skipped rather than waited for.
+	//-------------------------------------------------------------------------
+	auto it = shard.entries.end();
+
+	while((shard.stats.bytes > shard.stats.budget) && (it != shard.entries.begin()))
+	{
+		--it;
+
+		if(it->p_block.use_count() > 1)
+			continue;
+
+		--shard.stats.blocks;
+		shard.stats.bytes -= it->p_block->size();
+		++shard.stats.evictions;
+		shard.index.erase(it->key);
+		it = shard.entries.erase(it);
+	}
+}
+
+} // namespace adefs
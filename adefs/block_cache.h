@@ -0,0 +1,122 @@
+//=============================================================================
+//	FILE:					block_cache.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Sharded LRU cache of package data blocks.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_BLOCK_CACHE_H
+#define GUARD_ADEFS_BLOCK_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	BLOCK CACHE
+//
+//	Holds recently read blocks of package data so that files which read the
+//	same blocks, or read them again, do not go back to the package file. A
+//	cache can be used by a single package or shared between packages.
+//
+//	The blocks are spread over a number of shards by their key and each shard
+//	has its own lock and its own share of the budget, so readers on different
+//	threads rarely wait for each other. Each shard evicts its least recently
+//	used blocks to stay within its share.
+//
+//=============================================================================
+
+class BlockCache
+{
+public:
+	typedef std::shared_ptr<const std::vector<char>>	block_shared_ptr;
+
+	struct Statistics
+	{
+		std::uint64_t						hits		= 0;	// Lookups that found the block.
+		std::uint64_t						misses		= 0;	// Lookups that did not find the block.
+		std::uint64_t						evictions	= 0;	// Blocks removed to stay within the budget.
+		size_t								blocks		= 0;	// Number of blocks currently cached.
+		size_t								bytes		= 0;	// Bytes currently cached.
+		size_t								budget		= 0;	// The maximum number of bytes to cache.
+	};
+
+private:
+	struct Key
+	{
+		std::uint32_t						owner;
+		std::uint32_t						block;
+
+		bool operator==(const Key & rhs) const {return (owner == rhs.owner) && (block == rhs.block);}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key & key) const {return static_cast<size_t>(((static_cast<std::uint64_t>(key.owner) << 32) | key.block) * 0x9E3779B97F4A7C15ull >> 16);}
+	};
+
+	struct Entry
+	{
+		Key									key;
+		block_shared_ptr					p_block;
+	};
+
+	typedef std::list<Entry>				EntryList;
+
+	struct Shard
+	{
+		std::mutex							mutex;			// Mutex for exclusive access to the shard.
+		EntryList							entries;		// Cached blocks, most recently used first.
+		std::unordered_map<Key,EntryList::iterator,KeyHash>	index;
+		Statistics							stats;			// The shard's statistics. 'budget' is the shard's share.
+	};
+
+	std::vector<std::unique_ptr<Shard>>		m_shards;
+
+	static std::atomic<std::uint32_t>		s_next_owner;
+
+public:
+	BlockCache(const BlockCache &) = delete;
+	BlockCache & operator=(const BlockCache &) = delete;
+
+									// 'budget' is in bytes. To hold a number of blocks pass the number of
+									// blocks multiplied by the block size. A shard count of 0 picks one
+									// from the number of cores.
+	explicit BlockCache(size_t budget = 32 * 1024 * 1024,unsigned shard_count = 0);
+	~BlockCache(void) = default;
+
+									// Allocate a unique owner id. Each package using the cache needs its own id.
+	static std::uint32_t			new_owner()		{return s_next_owner++;}
+
+	block_shared_ptr				find(std::uint32_t owner,std::uint32_t block);
+	block_shared_ptr				insert(std::uint32_t owner,std::uint32_t block,const char * p_data,size_t size);
+	void							erase_owner(std::uint32_t owner);
+	void							clear();
+
+	void							set_budget(size_t budget);
+	size_t							budget() const;
+	unsigned						shard_count() const	{return static_cast<unsigned>(m_shards.size());}
+	Statistics						statistics() const;
+
+private:
+	Shard &							get_shard(const Key & key)	{return *m_shards[KeyHash()(key) % m_shards.size()];}
+	void							trim(Shard & shard);
+};
+
+typedef std::shared_ptr<BlockCache>	block_cache_shared_ptr;
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_BLOCK_CACHE_H
@@ -0,0 +1,221 @@
+//=============================================================================
+//	FILE:					buffer_pool.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Pool of reusable, size classed scratch buffers.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include "buffer_pool.h"
+
+namespace adefs
+{
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+//	Returns the size class for a buffer size or CLASS_COUNT if the size is too
+//	big to be pooled.
+//-----------------------------------------------------------------------------
+unsigned
+size_class(size_t size)
+{
+	unsigned bits = BufferPool::MIN_CLASS_BITS;
+
+	while((bits <= BufferPool::MAX_CLASS_BITS) && ((static_cast<size_t>(1) << bits) < size))
+		++bits;
+
+	return bits - BufferPool::MIN_CLASS_BITS;
+}
+
+} // anonymous namespace
+
+//=============================================================================
+//
+//
+//	BUFFER
+//
+//
+//=============================================================================
+
+BufferPool::Buffer &
+BufferPool::Buffer::operator=(Buffer && rhs) noexcept
+{
+	if(this != &rhs)
+	{
+		release();
+
+		m_p_pool		= rhs.m_p_pool;
+		m_p_data		= std::move(rhs.m_p_data);
+		m_size			= rhs.m_size;
+		m_capacity		= rhs.m_capacity;
+
+		rhs.m_p_pool	= nullptr;
+		rhs.m_size		= 0;
+		rhs.m_capacity	= 0;
+	}
+
+	return *this;
+}
+
+void
+BufferPool::Buffer::release()
+{
+	if(m_p_pool && m_p_data)
+		m_p_pool->release(std::move(m_p_data),m_capacity);
+
+	m_p_pool	= nullptr;
+	m_p_data.reset();
+	m_size		= 0;
+	m_capacity	= 0;
+}
+
+//=============================================================================
+//
+//
+//	BUFFER POOL
+//
+//
+//=============================================================================
+
+BufferPool::BufferPool(size_t budget)
+{
+	m_stats.budget = budget;
+
+	//-------------------------------------------------------------------------
+	//	Reserve the free lists up front so that releasing a buffer never has
+	//	to allocate.
+	//-------------------------------------------------------------------------
+	for(auto & free_list : m_free)
+		free_list.reserve(MAX_FREE_PER_CLASS);
+}
+
+const std::shared_ptr<BufferPool> &
+BufferPool::instance()
+{
+	static const std::shared_ptr<BufferPool> p_pool = std::make_shared<BufferPool>();
+	return p_pool;
+}
+
+BufferPool::Buffer
+BufferPool::acquire(size_t size)
+{
+	Buffer buffer;
+
+	const unsigned index = size_class(size);
+
+	if(index < CLASS_COUNT)
+	{
+		buffer.m_capacity = static_cast<size_t>(1) << (index + MIN_CLASS_BITS);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		auto & free_list = m_free[index];
+		if(!free_list.empty())
+		{
+			buffer.m_p_data = std::move(free_list.back());
+			free_list.pop_back();
+
+			--m_stats.idle;
+			m_stats.bytes -= buffer.m_capacity;
+			++m_stats.hits;
+		}
+		else
+			++m_stats.misses;
+	}
+	else
+	{
+		buffer.m_capacity = size;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		++m_stats.misses;
+	}
+
+	if(!buffer.m_p_data)
+		buffer.m_p_data.reset(new char[buffer.m_capacity]);
+
+	buffer.m_p_pool	= this;
+	buffer.m_size	= size;
+
+	return buffer;
+}
+
+void
+BufferPool::release(std::unique_ptr<char[]> p_data,size_t capacity)
+{
+	const unsigned index = size_class(capacity);
+
+	if(index >= CLASS_COUNT)
+		return;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto & free_list = m_free[index];
+	if(		(free_list.size() < MAX_FREE_PER_CLASS)
+		&&	((m_stats.bytes + capacity) <= m_stats.budget) )
+	{
+		free_list.push_back(std::move(p_data));
+		++m_stats.idle;
+		m_stats.bytes += capacity;
+	}
+}
+
+void
+BufferPool::clear()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for(auto & free_list : m_free)
+		free_list.clear();
+
+	m_stats.idle	= 0;
+	m_stats.bytes	= 0;
+}
+
+void
+BufferPool::set_budget(size_t budget)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_stats.budget = budget;
+	trim();
+}
+
+size_t
+BufferPool::budget() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_stats.budget;
+}
+
+BufferPool::Statistics
+BufferPool::statistics() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void
+BufferPool::trim()
+{
+	//-------------------------------------------------------------------------
+	//	Free the largest idle buffers first until the pool is within budget.
+	//-------------------------------------------------------------------------
+	for(unsigned index = CLASS_COUNT;(index > 0) && (m_stats.bytes > m_stats.budget);--index)
+	{
+		auto &			free_list	= m_free[index-1];
+		const size_t	capacity	= static_cast<size_t>(1) << (index - 1 + MIN_CLASS_BITS);
+
+		while(!free_list.empty() && (m_stats.bytes > m_stats.budget))
+		{
+			free_list.pop_back();
+			--m_stats.idle;
+			m_stats.bytes -= capacity;
+		}
+	}
+}
+
+} // namespace adefs
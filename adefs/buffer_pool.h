@@ -0,0 +1,124 @@
+//=============================================================================
+//	FILE:					buffer_pool.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Pool of reusable, size classed scratch buffers.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_BUFFER_POOL_H
+#define GUARD_ADEFS_BUFFER_POOL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <mutex>
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	BUFFER POOL
+//
+//	Hands out scratch buffers for short lived work such as holding the
+//	compressed data of an entry while it is decompressed. Buffer sizes are
+//	rounded up to a power of two and released buffers are kept for reuse, so
+//	once the pool has warmed up acquiring a buffer does not allocate.
+//
+//	Buffers larger than the biggest size class are allocated exactly and are
+//	freed when they are released. The pool will not keep more than its budget
+//	of idle buffers.
+//
+//=============================================================================
+
+class BufferPool
+{
+public:
+	enum
+	{
+		MIN_CLASS_BITS		= 12,						// 4KB
+		MAX_CLASS_BITS		= 24,						// 16MB
+		CLASS_COUNT			= MAX_CLASS_BITS - MIN_CLASS_BITS + 1,
+		MAX_FREE_PER_CLASS	= 16						// Idle buffers kept for each size class.
+	};
+
+	struct Statistics
+	{
+		std::uint64_t						hits		= 0;	// Requests satisfied by an idle buffer.
+		std::uint64_t						misses		= 0;	// Requests that had to allocate.
+		size_t								idle		= 0;	// Number of idle buffers held by the pool.
+		size_t								bytes		= 0;	// Bytes held in idle buffers.
+		size_t								budget		= 0;	// The maximum number of idle bytes to keep.
+	};
+
+	//-------------------------------------------------------------------------
+	//	A buffer acquired from the pool. The buffer is returned to the pool
+	//	when this object is destroyed.
+	//-------------------------------------------------------------------------
+	class Buffer
+	{
+	private:
+		BufferPool *					m_p_pool		= nullptr;
+		std::unique_ptr<char[]>			m_p_data;
+		size_t							m_size			= 0;
+		size_t							m_capacity		= 0;
+
+		friend class BufferPool;
+
+	public:
+		Buffer(const Buffer &) = delete;
+		Buffer & operator=(const Buffer &) = delete;
+
+		Buffer(void) = default;
+		Buffer(Buffer && rhs) noexcept		{*this = std::move(rhs);}
+		~Buffer(void)						{release();}
+
+		Buffer &						operator=(Buffer && rhs) noexcept;
+
+		char *							data()				{return m_p_data.get();}
+		const char *					data() const		{return m_p_data.get();}
+		size_t							size() const		{return m_size;}
+		size_t							capacity() const	{return m_capacity;}
+		bool							empty() const		{return !m_size;}
+
+		void							release();
+	};
+
+private:
+	mutable std::mutex						m_mutex;						// Mutex for exclusive access.
+	std::vector<std::unique_ptr<char[]>>	m_free[CLASS_COUNT];			// Idle buffers for each size class.
+	Statistics								m_stats;
+
+public:
+	BufferPool(const BufferPool &) = delete;
+	BufferPool & operator=(const BufferPool &) = delete;
+
+	explicit BufferPool(size_t budget = 32 * 1024 * 1024);
+	~BufferPool(void) = default;
+
+									// The pool used by packages that have not been given one of their own.
+	static const std::shared_ptr<BufferPool> &	instance();
+
+									// Get a buffer that can hold at least 'size' bytes. Throws
+									// std::bad_alloc if the memory can not be allocated.
+	Buffer							acquire(size_t size);
+	void							clear();
+
+	void							set_budget(size_t budget);
+	size_t							budget() const;
+	Statistics						statistics() const;
+
+private:
+	void							release(std::unique_ptr<char[]> p_data,size_t capacity);
+	void							trim();
+};
+
+typedef std::shared_ptr<BufferPool>	buffer_pool_shared_ptr;
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_BUFFER_POOL_H
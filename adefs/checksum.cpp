@@ -0,0 +1,125 @@
+//=============================================================================
+//	FILE:					checksum.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Checksums used by the package formats.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <algorithm>
+#include "checksum.h"
+
+namespace adefs
+{
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+//	Tables for computing the CRC eight bytes at a time. Table 0 is the usual
+//	byte at a time table and table N gives the effect of a byte followed by
+//	N zero bytes.
+//-----------------------------------------------------------------------------
+struct CRCTables
+{
+	std::uint32_t	table[8][256];
+
+	CRCTables()
+	{
+		for(std::uint32_t n = 0;n < 256;++n)
+		{
+			std::uint32_t c = n;
+
+			for(int k = 0;k < 8;++k)
+				c = (c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1);
+
+			table[0][n] = c;
+		}
+
+		for(std::uint32_t n = 0;n < 256;++n)
+			for(int t = 1;t < 8;++t)
+				table[t][n] = table[0][table[t-1][n] & 0xFF] ^ (table[t-1][n] >> 8);
+	}
+};
+
+const CRCTables &
+crc_tables()
+{
+	static const CRCTables tables;
+	return tables;
+}
+
+} // anonymous namespace
+
+std::uint32_t
+crc32(const void * p_data,size_t size,std::uint32_t crc)
+{
+	const auto &			t	= crc_tables().table;
+	const unsigned char *	p	= static_cast<const unsigned char *>(p_data);
+
+	crc = ~crc;
+
+	//-------------------------------------------------------------------------
+	//	The bulk of the data is processed eight bytes at a time. The words are
+	//	assembled from bytes so that this works on any byte order.
+	//-------------------------------------------------------------------------
+	for(;size >= 8;p += 8,size -= 8)
+	{
+		const std::uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24));
+
+		crc =	t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+				t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+	}
+
+	while(size--)
+		crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+std::uint32_t
+adler32(const void * p_data,size_t size,std::uint32_t adler)
+{
+	//-------------------------------------------------------------------------
+	//	NMAX is the most bytes that can be summed before the sums could
+	//	overflow 32 bits, so the modulo is only needed once per NMAX bytes.
+	//-------------------------------------------------------------------------
+	const std::uint32_t		BASE	= 65521;
+	const size_t			NMAX	= 5552;
+	const unsigned char *	p		= static_cast<const unsigned char *>(p_data);
+	std::uint32_t			a		= adler & 0xFFFF;
+	std::uint32_t			b		= adler >> 16;
+
+	while(size)
+	{
+		size_t block = std::min(size,NMAX);
+		size -= block;
+
+		for(;block >= 8;p += 8,block -= 8)
+		{
+			a += p[0];	b += a;
+			a += p[1];	b += a;
+			a += p[2];	b += a;
+			a += p[3];	b += a;
+			a += p[4];	b += a;
+			a += p[5];	b += a;
+			a += p[6];	b += a;
+			a += p[7];	b += a;
+		}
+
+		while(block--)
+		{
+			a += *p++;
+			b += a;
+		}
+
+		a %= BASE;
+		b %= BASE;
+	}
+
+	return (b << 16) | a;
+}
+
+} // namespace adefs
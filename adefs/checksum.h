@@ -0,0 +1,34 @@
+//=============================================================================
+//	FILE:					checksum.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Checksums used by the package formats.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_CHECKSUM_H
+#define GUARD_ADEFS_CHECKSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace adefs
+{
+
+//-----------------------------------------------------------------------------
+//	CRC-32 as used by ZIP and zlib. Pass the result of the previous call as
+//	'crc' to continue a checksum over several buffers.
+//-----------------------------------------------------------------------------
+std::uint32_t							crc32(const void * p_data,size_t size,std::uint32_t crc = 0);
+
+//-----------------------------------------------------------------------------
+//	Adler-32 as used by zlib. Pass the result of the previous call as 'adler'
+//	to continue a checksum over several buffers.
+//-----------------------------------------------------------------------------
+std::uint32_t							adler32(const void * p_data,size_t size,std::uint32_t adler = 1);
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_CHECKSUM_H
@@ -0,0 +1,417 @@
+//=============================================================================
+//	FILE:					data_source.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Random access, thread safe readers for package data.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "data_source.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+#endif
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - FILE
+//
+//
+//=============================================================================
+
+DataSourceFile::~DataSourceFile(void)
+{
+	close();
+}
+
+#ifdef _WIN32
+
+int
+DataSourceFile::open(const std::string & filename)
+{
+	if(is_open())
+		return -1;
+
+	m_p_file = std::fopen(filename.c_str(),"rb");
+	if(!m_p_file)
+		return -1;
+
+	_fseeki64(m_p_file,0,SEEK_END);
+	m_size = static_cast<std::uint64_t>(_ftelli64(m_p_file));
+
+	return 0;
+}
+
+void
+DataSourceFile::close()
+{
+	if(m_p_file)
+		std::fclose(m_p_file);
+
+	m_p_file	= nullptr;
+	m_size		= 0;
+}
+
+bool
+DataSourceFile::is_open() const
+{
+	return !!m_p_file;
+}
+
+size_t
+DataSourceFile::read_at(std::uint64_t offset,void * p_buffer,size_t size)
+{
+	if(!m_p_file || !p_buffer || (offset >= m_size))
+		return 0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if(_fseeki64(m_p_file,static_cast<__int64>(offset),SEEK_SET))
+		return 0;
+
+	return std::fread(p_buffer,1,size,m_p_file);
+}
+
+void
+DataSourceFile::prefetch(std::uint64_t /*offset*/,size_t /*size*/)
+{
+}
+
+#else
+
+int
+DataSourceFile::open(const std::string & filename)
+{
+	if(is_open())
+		return -1;
+
+	m_fd = ::open(filename.c_str(),O_RDONLY | O_CLOEXEC);
+	if(m_fd < 0)
+		return -1;
+
+	struct stat st;
+	if(::fstat(m_fd,&st))
+	{
+		close();
+		return -1;
+	}
+
+	m_size = static_cast<std::uint64_t>(st.st_size);
+
+	return 0;
+}
+
+void
+DataSourceFile::close()
+{
+	if(m_fd >= 0)
+		::close(m_fd);
+
+	m_fd	= -1;
+	m_size	= 0;
+}
+
+bool
+DataSourceFile::is_open() const
+{
+	return (m_fd >= 0);
+}
+
+size_t
+DataSourceFile::read_at(std::uint64_t offset,void * p_buffer,size_t size)
+{
+	if((m_fd < 0) || !p_buffer)
+		return 0;
+
+	auto	p_dest	= static_cast<char *>(p_buffer);
+	size_t	total	= 0;
+
+	//-------------------------------------------------------------------------
+	//	pread() can return less than was asked for so keep going until the
+	//	read is complete, the end of the file is reached or there is an error.
+	//-------------------------------------------------------------------------
+	while(total < size)
+	{
+		const ssize_t result = ::pread(m_fd,p_dest + total,size - total,static_cast<off_t>(offset + total));
+
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+
+		if(!result)
+			break;
+
+		total += static_cast<size_t>(result);
+	}
+
+	return total;
+}
+
+void
+DataSourceFile::prefetch(std::uint64_t offset,size_t size)
+{
+#ifdef POSIX_FADV_WILLNEED
+	if((m_fd >= 0) && size)
+		::posix_fadvise(m_fd,static_cast<off_t>(offset),static_cast<off_t>(size),POSIX_FADV_WILLNEED);
+#else
+	(void)offset;
+	(void)size;
+#endif
+}
+
+#endif
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - MAPPED FILE
+//
+//
+//=============================================================================
+
+DataSourceMap::~DataSourceMap(void)
+{
+	close();
+}
+
+#ifdef _WIN32
+
+int
+DataSourceMap::open(const std::string & /*filename*/)
+{
+	return -1;
+}
+
+void
+DataSourceMap::close()
+{
+}
+
+void
+DataSourceMap::prefetch(std::uint64_t /*offset*/,size_t /*size*/)
+{
+}
+
+#else
+
+int
+DataSourceMap::open(const std::string & filename)
+{
+	if(is_open())
+		return -1;
+
+	const int fd = ::open(filename.c_str(),O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	The mapping stays valid after the file is closed. Empty files can't be
+	//	mapped.
+	//-------------------------------------------------------------------------
+	struct stat	st;
+	void *		p_map = MAP_FAILED;
+
+	if(!::fstat(fd,&st) && (st.st_size > 0))
+		p_map = ::mmap(nullptr,static_cast<size_t>(st.st_size),PROT_READ,MAP_SHARED,fd,0);
+
+	::close(fd);
+
+	if(p_map == MAP_FAILED)
+		return -1;
+
+	m_p_data	= static_cast<const char *>(p_map);
+	m_size		= static_cast<std::uint64_t>(st.st_size);
+
+	return 0;
+}
+
+void
+DataSourceMap::close()
+{
+	if(m_p_data)
+		::munmap(const_cast<char *>(m_p_data),static_cast<size_t>(m_size));
+
+	m_p_data	= nullptr;
+	m_size		= 0;
+}
+
+void
+DataSourceMap::prefetch(std::uint64_t offset,size_t size)
+{
+	if(!m_p_data || (offset >= m_size))
+		return;
+
+	//-------------------------------------------------------------------------
+	//	madvise() needs a page aligned address.
+	//-------------------------------------------------------------------------
+	static const std::uint64_t page_size = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+
+	const std::uint64_t start	= offset - (offset % page_size);
+	const std::uint64_t end		= std::min<std::uint64_t>(offset + size,m_size);
+
+	::madvise(const_cast<char *>(m_p_data) + start,static_cast<size_t>(end - start),MADV_WILLNEED);
+}
+
+#endif
+
+size_t
+DataSourceMap::read_at(std::uint64_t offset,void * p_buffer,size_t size)
+{
+	if(!m_p_data || !p_buffer || (offset >= m_size))
+		return 0;
+
+	size = static_cast<size_t>(std::min<std::uint64_t>(size,m_size - offset));
+	std::memcpy(p_buffer,m_p_data + offset,size);
+
+	return size;
+}
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - MEMORY
+//
+//
+//=============================================================================
+
+size_t
+DataSourceMemory::read_at(std::uint64_t offset,void * p_buffer,size_t size)
+{
+	if(!p_buffer || (offset >= m_size))
+		return 0;
+
+	size = static_cast<size_t>(std::min<std::uint64_t>(size,m_size - offset));
+	std::memcpy(p_buffer,m_p_data + offset,size);
+
+	return size;
+}
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - IFILE
+//
+//
+//=============================================================================
+
+DataSourceIFile::DataSourceIFile(	std::unique_ptr<IFile>	p_file,
+									std::uint64_t			offset,
+									std::uint64_t			size )
+	: m_p_file(std::move(p_file))
+{
+	if(m_p_file)
+	{
+		const std::uint64_t file_size = m_p_file->size();
+
+		m_offset	= std::min(offset,file_size);
+		m_size		= std::min(size,file_size - m_offset);
+	}
+}
+
+size_t
+DataSourceIFile::read_at(std::uint64_t offset,void * p_buffer,size_t size)
+{
+	if(!m_p_file || !p_buffer || (offset >= m_size))
+		return 0;
+
+	size = static_cast<size_t>(std::min<std::uint64_t>(size,m_size - offset));
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_p_file->seek(static_cast<filepos>(m_offset + offset));
+	if(m_p_file->is_fail())
+		return 0;
+
+	auto	p_dest	= static_cast<char *>(p_buffer);
+	size_t	total	= 0;
+
+	while(total < size)
+	{
+		const size_t readsize = m_p_file->read(p_dest + total,size - total);
+		if(!readsize)
+			break;
+
+		total += readsize;
+	}
+
+	return total;
+}
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - READ AHEAD
+//
+//
+//=============================================================================
+
+DataSourceReadAhead::DataSourceReadAhead(	data_source_shared_ptr	p_source,
+											size_t					window_size )
+	: m_p_source(std::move(p_source))
+	, m_window(std::max<size_t>(window_size,1))
+{
+}
+
+size_t
+DataSourceReadAhead::read_at(std::uint64_t offset,void * p_buffer,size_t size)
+{
+	if(!p_buffer)
+		return 0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto	p_dest	= static_cast<char *>(p_buffer);
+	size_t	total	= 0;
+
+	while(total < size)
+	{
+		//---------------------------------------------------------------------
+		//	Copy whatever is already in the buffer.
+		//---------------------------------------------------------------------
+		if((offset >= m_window_offset) && (offset < m_window_offset + m_window_size))
+		{
+			const size_t start		= static_cast<size_t>(offset - m_window_offset);
+			const size_t copysize	= std::min(size - total,m_window_size - start);
+
+			std::memcpy(p_dest + total,m_window.data() + start,copysize);
+			total	+= copysize;
+			offset	+= copysize;
+			continue;
+		}
+
+		//---------------------------------------------------------------------
+		//	Reads that are at least as big as the buffer gain nothing from it.
+		//---------------------------------------------------------------------
+		if(size - total >= m_window.size())
+		{
+			total += m_p_source->read_at(offset,p_dest + total,size - total);
+			break;
+		}
+
+		m_window_offset	= offset;
+		m_window_size	= m_p_source->read_at(offset,m_window.data(),m_window.size());
+
+		if(!m_window_size)
+			break;
+	}
+
+	return total;
+}
+
+} // namespace adefs
@@ -0,0 +1,236 @@
+//=============================================================================
+//	FILE:					data_source.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Random access, thread safe readers for package data.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_DATA_SOURCE_H
+#define GUARD_ADEFS_DATA_SOURCE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "adefs.h"
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	DATA SOURCE INTERFACE
+//
+//	A data source reads from an absolute offset without a shared file
+//	position, so one source can be used by any number of threads at once.
+//
+//=============================================================================
+
+class IDataSource
+{
+public:
+	virtual							~IDataSource() = default;
+
+									// Read up to 'size' bytes from 'offset'. Returns the number of bytes
+									// read, which is only less than 'size' at the end of the data or on
+									// error.
+	virtual size_t					read_at(std::uint64_t offset,void * p_buffer,size_t size) = 0;
+	virtual std::uint64_t			size() const = 0;
+
+									// Sources that hold all of their data in memory return a pointer to it
+									// so that it can be used in place. The pointer is valid for as long as
+									// the source exists. Other sources return nullptr.
+	virtual const char *			data() const				{return nullptr;}
+
+									// Hint that a range will be read soon so that the system can start 
+									// reading it in the background. Sources that can't use the hint ignore
+									// it.
+	virtual void					prefetch(std::uint64_t /*offset*/,size_t /*size*/)	{}
+};
+
+typedef std::shared_ptr<IDataSource>	data_source_shared_ptr;
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - FILE
+//
+//
+//=============================================================================
+
+class DataSourceFile : public IDataSource
+{
+private:
+#ifdef _WIN32
+	std::mutex						m_mutex;				// There is no pread() so reads are serialised.
+	std::FILE *						m_p_file	= nullptr;
+#else
+	int								m_fd		= -1;
+#endif
+	std::uint64_t					m_size		= 0;
+
+public:
+	DataSourceFile(const DataSourceFile &) = delete;
+	DataSourceFile & operator=(const DataSourceFile &) = delete;
+
+	DataSourceFile(void) = default;
+	~DataSourceFile(void);
+
+	int								open(const std::string & filename);
+	void							close();
+	bool							is_open() const;
+
+	size_t							read_at(std::uint64_t offset,void * p_buffer,size_t size) override;
+	std::uint64_t					size() const override		{return m_size;}
+	void							prefetch(std::uint64_t offset,size_t size) override;
+};
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - MAPPED FILE
+//
+//	Maps a whole file into memory so that it can be used in place. Mapping
+//	is only available on POSIX systems; elsewhere open() fails and the caller
+//	is expected to fall back to DataSourceFile.
+//
+//=============================================================================
+
+class DataSourceMap : public IDataSource
+{
+private:
+	const char *					m_p_data	= nullptr;
+	std::uint64_t					m_size		= 0;
+
+public:
+	DataSourceMap(const DataSourceMap &) = delete;
+	DataSourceMap & operator=(const DataSourceMap &) = delete;
+
+	DataSourceMap(void) = default;
+	~DataSourceMap(void);
+
+	int								open(const std::string & filename);
+	void							close();
+	bool							is_open() const				{return !!m_p_data;}
+
+	size_t							read_at(std::uint64_t offset,void * p_buffer,size_t size) override;
+	std::uint64_t					size() const override		{return m_size;}
+	const char *					data() const override		{return m_p_data;}
+	void							prefetch(std::uint64_t offset,size_t size) override;
+};
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - MEMORY
+//
+//	Reads from a region of memory that belongs to the caller, such as an 
+//	archive embedded in the executable or a shared memory block. The owner
+//	is kept alive for as long as the source exists.
+//
+//=============================================================================
+
+class DataSourceMemory : public IDataSource
+{
+private:
+	std::shared_ptr<const void>		m_p_owner;
+	const char *					m_p_data;
+	size_t							m_size;
+
+public:
+	DataSourceMemory(const DataSourceMemory &) = delete;
+	DataSourceMemory & operator=(const DataSourceMemory &) = delete;
+
+									// 'p_owner' may be nullptr if the memory lasts for the life of the
+									// program.
+	DataSourceMemory(	const void *				p_data,
+						size_t						size,
+						std::shared_ptr<const void>	p_owner = nullptr )
+		: m_p_owner(std::move(p_owner))
+		, m_p_data(static_cast<const char *>(p_data))
+		, m_size(p_data ? size : 0)
+	{
+	}
+
+	size_t							read_at(std::uint64_t offset,void * p_buffer,size_t size) override;
+	std::uint64_t					size() const override		{return m_size;}
+	const char *					data() const override		{return m_p_data;}
+};
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - IFILE
+//
+//	Reads a range of an open IFile, such as an entry of another package, so
+//	that it can be used as a package of its own. An IFile has a single file
+//	position so reads are serialised.
+//
+//=============================================================================
+
+class DataSourceIFile : public IDataSource
+{
+private:
+	std::mutex						m_mutex;
+	std::unique_ptr<IFile>			m_p_file;
+	std::uint64_t					m_offset	= 0;			// The start of the range in the file.
+	std::uint64_t					m_size		= 0;			// The size of the range.
+
+public:
+	DataSourceIFile(const DataSourceIFile &) = delete;
+	DataSourceIFile & operator=(const DataSourceIFile &) = delete;
+
+									// The range is clipped to the end of the file. By default it covers
+									// the whole file.
+	explicit DataSourceIFile(	std::unique_ptr<IFile>	p_file,
+								std::uint64_t			offset	= 0,
+								std::uint64_t			size	= UINT64_MAX );
+
+	size_t							read_at(std::uint64_t offset,void * p_buffer,size_t size) override;
+	std::uint64_t					size() const override		{return m_size;}
+};
+
+//=============================================================================
+//
+//
+//	DATA SOURCE - READ AHEAD
+//
+//	Reads another source through a large buffer so that a series of small
+//	reads that move forwards through the data becomes a few large sequential
+//	reads. Reads that go backwards or jump past the buffer start a new one.
+//
+//=============================================================================
+
+class DataSourceReadAhead : public IDataSource
+{
+private:
+	enum {DEFAULT_WINDOW_SIZE = 4 * 1024 * 1024};
+
+	std::mutex						m_mutex;
+	data_source_shared_ptr			m_p_source;
+	std::vector<char>				m_window;
+	std::uint64_t					m_window_offset	= 0;	// The offset of the buffered data in the source.
+	size_t							m_window_size	= 0;	// The amount of data in the buffer.
+
+public:
+	DataSourceReadAhead(const DataSourceReadAhead &) = delete;
+	DataSourceReadAhead & operator=(const DataSourceReadAhead &) = delete;
+
+	explicit DataSourceReadAhead(	data_source_shared_ptr	p_source,
+									size_t					window_size = DEFAULT_WINDOW_SIZE );
+
+	size_t							read_at(std::uint64_t offset,void * p_buffer,size_t size) override;
+	std::uint64_t					size() const override		{return m_p_source->size();}
+	const char *					data() const override		{return m_p_source->data();}
+	void							prefetch(std::uint64_t offset,size_t size) override	{m_p_source->prefetch(offset,size);}
+};
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_DATA_SOURCE_H
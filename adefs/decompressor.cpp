@@ -0,0 +1,466 @@
+//=============================================================================
+//	FILE:					decompressor.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Decompressor interface and runtime backend registry.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include "decompressor.h"
+#include "inflate.h"
+
+#ifdef HAVE_ZLIB
+	#include <zlib.h>
+#endif
+
+#ifdef HAVE_LIBDEFLATE
+	#include <libdeflate.h>
+#endif
+
+#ifdef HAVE_ZSTD
+	#include <zstd.h>
+#endif
+
+namespace adefs
+{
+
+namespace
+{
+
+//=============================================================================
+//
+//	BUILT-IN INFLATE
+//
+//=============================================================================
+
+class DecompressorInflate : public IDecompressor
+{
+private:
+	Inflater						m_inflater;
+
+public:
+	int								decompress(	const std::uint8_t *	p_source,
+												size_t					source_size,
+												std::uint8_t *			p_target,
+												size_t					target_size ) override
+									{
+										size_t size = 0;
+										if(m_inflater.inflate(p_source,source_size,p_target,target_size,size))
+											return -1;
+										return (size == target_size ? 0 : -1);
+									}
+};
+
+#ifdef HAVE_ZLIB
+//=============================================================================
+//
+//	ZLIB
+//
+//=============================================================================
+
+class DecompressorZlib : public IDecompressor
+{
+private:
+	z_stream						m_stream;
+	bool							m_b_init;
+
+public:
+	DecompressorZlib(void)
+	{
+		std::memset(&m_stream,0,sizeof(m_stream));
+		m_b_init = (inflateInit2(&m_stream,-MAX_WBITS) == Z_OK);
+	}
+
+	~DecompressorZlib(void)
+	{
+		if(m_b_init)
+			inflateEnd(&m_stream);
+	}
+
+	int								decompress(	const std::uint8_t *	p_source,
+												size_t					source_size,
+												std::uint8_t *			p_target,
+												size_t					target_size ) override
+									{
+										if(begin())
+											return -1;
+
+										int result = 0;
+										while(!result)
+										{
+											const size_t avail_in	= source_size;
+											const size_t avail_out	= target_size;
+
+											result = stream(p_source,source_size,p_target,target_size);
+
+											if((avail_in == source_size) && (avail_out == target_size) && !result)
+												result = -1;
+										}
+
+										return ((result > 0) && !target_size ? 0 : -1);
+									}
+
+	bool							can_stream() const override		{return m_b_init;}
+	int								begin() override				{return (m_b_init && (inflateReset(&m_stream) == Z_OK) ? 0 : -1);}
+
+	int								stream(	const std::uint8_t *&	p_source,
+											size_t &				source_size,
+											std::uint8_t *&			p_target,
+											size_t &				target_size ) override
+									{
+										//-----------------------------------------------------
+										//	zlib counts are 32 bit so larger buffers are fed in
+										//	pieces.
+										//-----------------------------------------------------
+										const uInt avail_in		= static_cast<uInt>(std::min<size_t>(source_size,std::numeric_limits<uInt>::max()));
+										const uInt avail_out	= static_cast<uInt>(std::min<size_t>(target_size,std::numeric_limits<uInt>::max()));
+
+										m_stream.next_in	= const_cast<Bytef *>(p_source);
+										m_stream.avail_in	= avail_in;
+										m_stream.next_out	= p_target;
+										m_stream.avail_out	= avail_out;
+
+										const int err = ::inflate(&m_stream,Z_NO_FLUSH);
+
+										p_source	+= (avail_in - m_stream.avail_in);
+										source_size	-= (avail_in - m_stream.avail_in);
+										p_target	+= (avail_out - m_stream.avail_out);
+										target_size	-= (avail_out - m_stream.avail_out);
+
+										switch(err)
+										{
+											case Z_STREAM_END :		return 1;
+											case Z_OK :
+											case Z_BUF_ERROR :		return 0;
+											default :				return -1;
+										}
+									}
+};
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_LIBDEFLATE
+//=============================================================================
+//
+//	LIBDEFLATE
+//
+//=============================================================================
+
+class DecompressorLibdeflate : public IDecompressor
+{
+private:
+	libdeflate_decompressor *		m_p_decompressor;
+
+public:
+	DecompressorLibdeflate(void) : m_p_decompressor(libdeflate_alloc_decompressor()) {}
+	~DecompressorLibdeflate(void)	{if(m_p_decompressor) libdeflate_free_decompressor(m_p_decompressor);}
+
+	int								decompress(	const std::uint8_t *	p_source,
+												size_t					source_size,
+												std::uint8_t *			p_target,
+												size_t					target_size ) override
+									{
+										if(!m_p_decompressor)
+											return -1;
+
+										return (libdeflate_deflate_decompress(m_p_decompressor,p_source,source_size,p_target,target_size,nullptr) == LIBDEFLATE_SUCCESS ? 0 : -1);
+									}
+};
+#endif // HAVE_LIBDEFLATE
+
+#ifdef HAVE_ZSTD
+//=============================================================================
+//
+//	ZSTD
+//
+//=============================================================================
+
+class DecompressorZstd : public IDecompressor
+{
+private:
+	ZSTD_DStream *					m_p_stream;
+
+public:
+	DecompressorZstd(void) : m_p_stream(ZSTD_createDStream()) {}
+	~DecompressorZstd(void)			{if(m_p_stream) ZSTD_freeDStream(m_p_stream);}
+
+	int								decompress(	const std::uint8_t *	p_source,
+												size_t					source_size,
+												std::uint8_t *			p_target,
+												size_t					target_size ) override
+									{
+										if(!m_p_stream)
+											return -1;
+
+										const size_t result = ZSTD_decompressDCtx(m_p_stream,p_target,target_size,p_source,source_size);
+										return (!ZSTD_isError(result) && (result == target_size) ? 0 : -1);
+									}
+
+	bool							can_stream() const override		{return !!m_p_stream;}
+	int								begin() override				{return (m_p_stream && !ZSTD_isError(ZSTD_initDStream(m_p_stream)) ? 0 : -1);}
+
+	int								stream(	const std::uint8_t *&	p_source,
+											size_t &				source_size,
+											std::uint8_t *&			p_target,
+											size_t &				target_size ) override
+									{
+										ZSTD_inBuffer	in	= {p_source,source_size,0};
+										ZSTD_outBuffer	out	= {p_target,target_size,0};
+
+										const size_t result = ZSTD_decompressStream(m_p_stream,&out,&in);
+
+										p_source	+= in.pos;
+										source_size	-= in.pos;
+										p_target	+= out.pos;
+										target_size	-= out.pos;
+
+										if(ZSTD_isError(result))
+											return -1;
+
+										return (result ? 0 : 1);
+									}
+};
+#endif // HAVE_ZSTD
+
+} // anonymous namespace
+
+//=============================================================================
+//
+//
+//	DECOMPRESSOR REGISTRY
+//
+//
+//=============================================================================
+
+DecompressorRegistry &
+DecompressorRegistry::instance()
+{
+	//-------------------------------------------------------------------------
+	//	The registry is never destroyed. Decompressors held by static objects
+	//	can then still be handed back to it while the program exits.
+	//-------------------------------------------------------------------------
+	static DecompressorRegistry * p_registry = []
+	{
+		auto p_new_registry = new DecompressorRegistry;
+		p_new_registry->register_builtin_backends();
+		return p_new_registry;
+	}();
+
+	return *p_registry;
+}
+
+void
+DecompressorRegistry::register_builtin_backends()
+{
+	//-------------------------------------------------------------------------
+	//	Backends are registered from slowest to fastest so that the fastest
+	//	one available is selected by default.
+	//-------------------------------------------------------------------------
+	register_backend(COMPRESSION_DEFLATE,"builtin",[]{return decompressor_unique_ptr(new DecompressorInflate);});
+
+#ifdef HAVE_ZLIB
+	register_backend(COMPRESSION_DEFLATE,"zlib",[]{return decompressor_unique_ptr(new DecompressorZlib);});
+#endif
+
+#ifdef HAVE_LIBDEFLATE
+	register_backend(COMPRESSION_DEFLATE,"libdeflate",[]{return decompressor_unique_ptr(new DecompressorLibdeflate);});
+#endif
+
+#ifdef HAVE_ZSTD
+	register_backend(COMPRESSION_ZSTD,"zstd",[]{return decompressor_unique_ptr(new DecompressorZstd);});
+#endif
+}
+
+void
+DecompressorRegistry::register_backend(std::uint16_t method,const std::string & name,Creator create)
+{
+	if(!create || name.empty())
+		return;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//-------------------------------------------------------------------------
+	//	Replace any existing backend with the same name.
+	//-------------------------------------------------------------------------
+	auto ifind = std::find_if(m_backends.begin(),m_backends.end(),[&](const Backend & backend){return (backend.method == method) && (backend.name == name);});
+	if(ifind != m_backends.end())
+	{
+		ifind->create = std::move(create);
+		ifind->serial = m_next_serial++;
+		ifind->idle.clear();
+	}
+	else
+	{
+		m_backends.push_back(Backend{method,name,std::move(create),m_next_serial++,{}});
+		m_backends.back().idle.reserve(MAX_IDLE);
+	}
+
+	//-------------------------------------------------------------------------
+	//	Make it the selected backend for the method.
+	//-------------------------------------------------------------------------
+	auto isel = std::find_if(m_selected.begin(),m_selected.end(),[&](const std::pair<std::uint16_t,std::string> & sel){return sel.first == method;});
+	if(isel != m_selected.end())
+		isel->second = name;
+	else
+		m_selected.emplace_back(method,name);
+}
+
+bool
+DecompressorRegistry::select(std::uint16_t method,const std::string & name)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto ifind = std::find_if(m_backends.begin(),m_backends.end(),[&](const Backend & backend){return (backend.method == method) && (backend.name == name);});
+	if(ifind == m_backends.end())
+		return false;
+
+	auto isel = std::find_if(m_selected.begin(),m_selected.end(),[&](const std::pair<std::uint16_t,std::string> & sel){return sel.first == method;});
+	if(isel != m_selected.end())
+		isel->second = name;
+	else
+		m_selected.emplace_back(method,name);
+
+	return true;
+}
+
+std::string
+DecompressorRegistry::selected(std::uint16_t method) const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for(auto & sel : m_selected)
+		if(sel.first == method)
+			return sel.second;
+
+	return std::string();
+}
+
+std::vector<std::string>
+DecompressorRegistry::backends(std::uint16_t method) const
+{
+	std::vector<std::string> names;
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for(auto & backend : m_backends)
+		if(backend.method == method)
+			names.push_back(backend.name);
+
+	return names;
+}
+
+decompressor_unique_ptr
+DecompressorRegistry::create(std::uint16_t method)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for(auto & sel : m_selected)
+		if(sel.first == method)
+			for(auto & backend : m_backends)
+				if((backend.method == method) && (backend.name == sel.second))
+					return create(backend,lock);
+
+	return decompressor_unique_ptr();
+}
+
+decompressor_unique_ptr
+DecompressorRegistry::create(std::uint16_t method,const std::string & name)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for(auto & backend : m_backends)
+		if((backend.method == method) && (backend.name == name))
+			return create(backend,lock);
+
+	return decompressor_unique_ptr();
+}
+
+decompressor_unique_ptr
+DecompressorRegistry::create(Backend & backend,std::unique_lock<std::mutex> & lock)
+{
+	decompressor_unique_ptr p_decompressor;
+
+	//-------------------------------------------------------------------------
+	//	Reuse an idle decompressor if there is one.
+	//-------------------------------------------------------------------------
+	if(!backend.idle.empty())
+	{
+		p_decompressor = decompressor_unique_ptr(backend.idle.back().release(),DecompressorDeleter{this,backend.serial});
+		backend.idle.pop_back();
+		return p_decompressor;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Otherwise create a new one. The lock is not held while the backend 
+	//	creates its state.
+	//-------------------------------------------------------------------------
+	Creator					create	= backend.create;
+	const std::uint32_t		serial	= backend.serial;
+
+	lock.unlock();
+
+	try
+	{
+		auto p_new = create();
+		if(p_new)
+			p_decompressor = decompressor_unique_ptr(p_new.release(),DecompressorDeleter{this,serial});
+	}
+	catch(...){}
+
+	return p_decompressor;
+}
+
+void
+DecompressorRegistry::release(std::uint32_t serial,IDecompressor * p_decompressor)
+{
+	std::unique_ptr<IDecompressor> p_owned(p_decompressor);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//-------------------------------------------------------------------------
+	//	Decompressors from a backend that has since been replaced are deleted.
+	//-------------------------------------------------------------------------
+	for(auto & backend : m_backends)
+	{
+		if(backend.serial == serial)
+		{
+			if(backend.idle.size() < MAX_IDLE)
+				backend.idle.push_back(std::move(p_owned));
+			break;
+		}
+	}
+}
+
+void
+DecompressorRegistry::clear_idle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for(auto & backend : m_backends)
+		backend.idle.clear();
+}
+
+//=============================================================================
+//
+//
+//	DECOMPRESSOR DELETER
+//
+//
+//=============================================================================
+
+void
+DecompressorDeleter::operator()(IDecompressor * p_decompressor) const
+{
+	if(!p_decompressor)
+		return;
+
+	if(p_registry)
+		p_registry->release(backend,p_decompressor);
+	else
+		delete p_decompressor;
+}
+
+} // namespace adefs
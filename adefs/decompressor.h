@@ -0,0 +1,170 @@
+//=============================================================================
+//	FILE:					decompressor.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Decompressor interface and runtime backend registry.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_DECOMPRESSOR_H
+#define GUARD_ADEFS_DECOMPRESSOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <functional>
+
+namespace adefs
+{
+
+//*****************************************************************************
+//
+//
+//	TYPES
+//
+//
+//*****************************************************************************
+
+//-----------------------------------------------------------------------------
+//	Compression methods. These use the ZIP compression method numbers.
+//-----------------------------------------------------------------------------
+enum
+{
+	COMPRESSION_STORE		= 0,
+	COMPRESSION_DEFLATE		= 8,
+	COMPRESSION_ZSTD		= 93
+};
+
+class IDecompressor;
+class DecompressorRegistry;
+
+//-----------------------------------------------------------------------------
+//	Decompressors created by a registry are handed back to it when they are
+//	destroyed so that their state can be reused. Decompressors created
+//	directly are simply deleted.
+//-----------------------------------------------------------------------------
+struct DecompressorDeleter
+{
+	DecompressorRegistry *				p_registry	= nullptr;
+	std::uint32_t						backend		= 0;
+
+	void								operator()(IDecompressor * p_decompressor) const;
+};
+
+typedef std::unique_ptr<IDecompressor,DecompressorDeleter>	decompressor_unique_ptr;
+
+//=============================================================================
+//
+//
+//	DECOMPRESSOR INTERFACE
+//
+//	A decompressor holds whatever state its backend needs and can be reused
+//	for any number of entries. A reused decompressor may be left in any state
+//	so decompress() and begin() must fully reset it.
+//
+//=============================================================================
+
+class IDecompressor
+{
+public:
+	virtual							~IDecompressor() = default;
+
+									// Decompress a complete entry into a buffer that is exactly the size
+									// of the uncompressed data. Returns 0 on success.
+	virtual int						decompress(	const std::uint8_t *	p_source,
+												size_t					source_size,
+												std::uint8_t *			p_target,
+												size_t					target_size ) = 0;
+
+									// Streaming. Backends that can decode incrementally return true from
+									// can_stream(). stream() advances the pointers and sizes past the
+									// data that was consumed and produced and returns 1 at the end of the
+									// stream, 0 if there is more to come or -1 on error.
+	virtual bool					can_stream() const		{return false;}
+	virtual int						begin()					{return -1;}
+	virtual int						stream(	const std::uint8_t *&	/*p_source*/,
+											size_t &				/*source_size*/,
+											std::uint8_t *&			/*p_target*/,
+											size_t &				/*target_size*/ )	{return -1;}
+};
+
+//=============================================================================
+//
+//
+//	DECOMPRESSOR REGISTRY
+//
+//	Maps compression methods to the available backends. Each method can have
+//	several backends (eg. the built-in inflater, zlib and libdeflate for
+//	DEFLATE). The most recently registered backend for a method is selected
+//	by default, so applications can override a backend by registering their
+//	own, or pick one of the existing backends with select().
+//
+//	Decompressors that are no longer needed are kept by the registry and
+//	handed out again by create(), so the allocation and set up of backend 
+//	state (eg. zlib's window) is only paid once per thread that is using it.
+//
+//=============================================================================
+
+class DecompressorRegistry
+{
+public:
+	typedef std::function<decompressor_unique_ptr()>	Creator;
+
+private:
+	enum {MAX_IDLE = 16};							// Idle decompressors kept for each backend.
+
+	struct Backend
+	{
+		std::uint16_t					method;
+		std::string						name;
+		Creator							create;
+		std::uint32_t					serial;			// Changes whenever the backend is replaced.
+		std::vector<std::unique_ptr<IDecompressor>>	idle;	// Decompressors waiting to be reused.
+	};
+
+	mutable std::mutex					m_mutex;			// Mutex for exclusive access.
+	std::vector<Backend>				m_backends;			// All registered backends in registration order.
+	std::vector<std::pair<std::uint16_t,std::string>>	m_selected;	// The selected backend for each method.
+	std::uint32_t						m_next_serial	= 1;
+
+	friend struct DecompressorDeleter;
+
+public:
+	DecompressorRegistry(const DecompressorRegistry &) = delete;
+	DecompressorRegistry & operator=(const DecompressorRegistry &) = delete;
+
+	DecompressorRegistry(void) = default;
+	~DecompressorRegistry(void) = default;			// Must outlive any decompressors it created.
+
+										// The registry used by the packages. It is created with the built-in
+										// backends and any optional backends that were compiled in, and is
+										// never destroyed.
+	static DecompressorRegistry &		instance();
+
+	void								register_backend(std::uint16_t method,const std::string & name,Creator create);
+	bool								select(std::uint16_t method,const std::string & name);
+	std::string							selected(std::uint16_t method) const;
+	std::vector<std::string>			backends(std::uint16_t method) const;
+	bool								is_supported(std::uint16_t method) const	{return !selected(method).empty();}
+
+										// Create a decompressor using the selected backend, or a named backend.
+										// An idle decompressor is reused if there is one.
+	decompressor_unique_ptr				create(std::uint16_t method);
+	decompressor_unique_ptr				create(std::uint16_t method,const std::string & name);
+
+										// Free the idle decompressors.
+	void								clear_idle();
+
+private:
+	void								register_builtin_backends();
+	decompressor_unique_ptr				create(Backend & backend,std::unique_lock<std::mutex> & lock);
+	void								release(std::uint32_t serial,IDecompressor * p_decompressor);
+};
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_DECOMPRESSOR_H
@@ -0,0 +1,162 @@
+//=============================================================================
+//	FILE:					entry_cache.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Byte budgeted LRU cache of decompressed package entries.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include "entry_cache.h"
+
+namespace adefs
+{
+
+std::atomic<std::uint32_t>	EntryCache::s_next_owner(1);
+
+EntryCache::EntryCache(size_t budget)
+{
+	m_stats.budget = budget;
+}
+
+EntryCache::buffer_shared_ptr
+EntryCache::find(std::uint32_t owner,std::uint32_t id)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto ifind = m_index.find(Key{owner,id});
+	if(ifind == m_index.end())
+	{
+		++m_stats.misses;
+		return nullptr;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Move the entry to the front of the list to mark it as most recently 
+	//	used.
+	//-------------------------------------------------------------------------
+	m_entries.splice(m_entries.begin(),m_entries,ifind->second);
+	++m_stats.hits;
+
+	return ifind->second->p_buffer;
+}
+
+EntryCache::buffer_shared_ptr
+EntryCache::insert(std::uint32_t owner,std::uint32_t id,std::vector<char> && data)
+{
+	const size_t size = data.size();
+	buffer_shared_ptr p_buffer = std::make_shared<const std::vector<char>>(std::move(data));
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//-------------------------------------------------------------------------
+	//	Entries that would never fit are passed straight back to the caller.
+	//-------------------------------------------------------------------------
+	if(size > m_stats.budget)
+		return p_buffer;
+
+	//-------------------------------------------------------------------------
+	//	If another thread inserted the same entry first then use theirs so that
+	//	all open files share the one buffer.
+	//-------------------------------------------------------------------------
+	const Key key{owner,id};
+
+	auto ifind = m_index.find(key);
+	if(ifind != m_index.end())
+	{
+		m_entries.splice(m_entries.begin(),m_entries,ifind->second);
+		return ifind->second->p_buffer;
+	}
+
+	m_entries.push_front(Entry{key,p_buffer});
+	m_index[key] = m_entries.begin();
+
+	++m_stats.entries;
+	m_stats.bytes += size;
+
+	trim();
+
+	return p_buffer;
+}
+
+void
+EntryCache::erase_owner(std::uint32_t owner)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto it = m_entries.begin();
+	while(it != m_entries.end())
+	{
+		if(it->key.owner == owner)
+		{
+			--m_stats.entries;
+			m_stats.bytes -= it->p_buffer->size();
+			m_index.erase(it->key);
+			it = m_entries.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+void
+EntryCache::clear()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_entries.clear();
+	m_index.clear();
+	m_stats.entries	= 0;
+	m_stats.bytes	= 0;
+}
+
+void
+EntryCache::set_budget(size_t budget)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_stats.budget = budget;
+	trim();
+}
+
+size_t
+EntryCache::budget() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_stats.budget;
+}
+
+EntryCache::Statistics
+EntryCache::statistics() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void
+EntryCache::trim()
+{
+	//-------------------------------------------------------------------------
+	//	Evict the least recently used entries until the cache is within budget.
+	//	Entries that are still referenced by an open file are pinned and are 
+	//	skipped.
+	//-------------------------------------------------------------------------
+	auto it = m_entries.end();
+
+	while((m_stats.bytes > m_stats.budget) && (it != m_entries.begin()))
+	{
+		--it;
+
+		if(it->p_buffer.use_count() > 1)
+			continue;
+
+		--m_stats.entries;
+		m_stats.bytes -= it->p_buffer->size();
+		++m_stats.evictions;
+		m_index.erase(it->key);
+		it = m_entries.erase(it);
+	}
+}
+
+} // namespace adefs
@@ -0,0 +1,112 @@
+//=============================================================================
+//	FILE:					entry_cache.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Byte budgeted LRU cache of decompressed package entries.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_ENTRY_CACHE_H
+#define GUARD_ADEFS_ENTRY_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	ENTRY CACHE
+//
+//	Holds the decompressed contents of package entries so that repeated opens
+//	do not have to read and decompress the entry again. A cache can be used by
+//	a single package or shared between any number of packages.
+//
+//	Buffers are handed out as shared pointers. A buffer that is referenced
+//	outside of the cache (ie. by an open file) is pinned and will not be
+//	evicted, so the cache can temporarily exceed its budget if everything in
+//	it is in use.
+//
+//=============================================================================
+
+class EntryCache
+{
+public:
+	typedef std::shared_ptr<const std::vector<char>>	buffer_shared_ptr;
+
+	struct Statistics
+	{
+		std::uint64_t						hits		= 0;	// Lookups that found the entry.
+		std::uint64_t						misses		= 0;	// Lookups that did not find the entry.
+		std::uint64_t						evictions	= 0;	// Entries removed to stay within the budget.
+		size_t								entries		= 0;	// Number of entries currently cached.
+		size_t								bytes		= 0;	// Bytes currently cached.
+		size_t								budget		= 0;	// The maximum number of bytes to cache.
+	};
+
+private:
+	struct Key
+	{
+		std::uint32_t						owner;
+		std::uint32_t						id;
+
+		bool operator==(const Key & rhs) const {return (owner == rhs.owner) && (id == rhs.id);}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key & key) const {return std::hash<std::uint64_t>()((static_cast<std::uint64_t>(key.owner) << 32) | key.id);}
+	};
+
+	struct Entry
+	{
+		Key									key;
+		buffer_shared_ptr					p_buffer;
+	};
+
+	typedef std::list<Entry>				EntryList;
+
+	mutable std::mutex						m_mutex;		// Mutex for exclusive access.
+	EntryList								m_entries;		// Cached entries, most recently used first.
+	std::unordered_map<Key,EntryList::iterator,KeyHash>	m_index;
+	Statistics								m_stats;
+
+	static std::atomic<std::uint32_t>		s_next_owner;
+
+public:
+	EntryCache(const EntryCache &) = delete;
+	EntryCache & operator=(const EntryCache &) = delete;
+
+	explicit EntryCache(size_t budget = 16 * 1024 * 1024);
+	~EntryCache(void) = default;
+
+									// Allocate a unique owner id. Each package using the cache needs its own id.
+	static std::uint32_t			new_owner()		{return s_next_owner++;}
+
+	buffer_shared_ptr				find(std::uint32_t owner,std::uint32_t id);
+	buffer_shared_ptr				insert(std::uint32_t owner,std::uint32_t id,std::vector<char> && data);
+	void							erase_owner(std::uint32_t owner);
+	void							clear();
+
+	void							set_budget(size_t budget);
+	size_t							budget() const;
+	Statistics						statistics() const;
+
+private:
+	void							trim();
+};
+
+typedef std::shared_ptr<EntryCache>	entry_cache_shared_ptr;
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_ENTRY_CACHE_H
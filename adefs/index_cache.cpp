@@ -0,0 +1,380 @@
+//=============================================================================
+//	FILE:					index_cache.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Persistent on-disk cache of parsed package indexes.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include "index_cache.h"
+
+#ifdef _WIN32
+	#include <direct.h>
+	#include <process.h>
+	#include <sys/types.h>
+	#include <sys/stat.h>
+#else
+	#include <climits>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+#endif
+
+namespace adefs
+{
+
+namespace
+{
+
+#pragma pack(push,1)
+
+//-----------------------------------------------------------------------------
+//	Cache File Header. It is followed by the archive path and then the index.
+//-----------------------------------------------------------------------------
+struct CacheFileHeader
+{
+	char			magic[8];			// "ADEFSIDX"
+	std::uint32_t	header_version;		// CACHE_FILE_VERSION
+	std::uint32_t	format_version;		// The version of the package's index layout.
+	char			format[8];			// The package format, zero padded.
+	std::uint64_t	archive_size;
+	std::int64_t	archive_mtime;
+	std::uint64_t	archive_inode;
+	std::uint64_t	archive_device;
+	std::uint32_t	path_size;
+	std::uint32_t	reserved;
+	std::uint64_t	data_size;			// Size of the index in bytes.
+	std::uint64_t	data_checksum;		// Checksum of the index.
+};
+
+#pragma pack(pop)
+
+const char			CACHE_FILE_MAGIC[8]	= {'A','D','E','F','S','I','D','X'};
+const std::uint32_t	CACHE_FILE_VERSION	= 1;
+
+//-----------------------------------------------------------------------------
+//	FNV-1a over the bytes of a string. Used to name the cache files.
+//-----------------------------------------------------------------------------
+std::uint64_t
+hash_string(const std::string & str)
+{
+	std::uint64_t hash = 0xCBF29CE484222325ull;
+
+	for(unsigned char c : str)
+		hash = (hash ^ c) * 0x100000001B3ull;
+
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+//	Checksum of the index data. It is only there to catch truncated or
+//	damaged cache files so it works a word at a time to keep loading fast.
+//-----------------------------------------------------------------------------
+std::uint64_t
+checksum(const char * p_data,size_t size)
+{
+	std::uint64_t hash = 0xCBF29CE484222325ull ^ size;
+
+	for(;size >= 8;p_data += 8,size -= 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word,p_data,8);
+		hash = (hash ^ word) * 0x100000001B3ull;
+		hash ^= hash >> 29;
+	}
+
+	while(size--)
+		hash = (hash ^ static_cast<unsigned char>(*p_data++)) * 0x100000001B3ull;
+
+	return hash;
+}
+
+void
+set_format(char (&out_format)[8],const char * format)
+{
+	std::memset(out_format,0,sizeof(out_format));
+	std::strncpy(out_format,format,sizeof(out_format));
+}
+
+//-----------------------------------------------------------------------------
+//	Check the header of a cache file against the archive that it should
+//	describe. Returns a pointer to the index data or nullptr if the file can
+//	not be used.
+//-----------------------------------------------------------------------------
+const char *
+validate(	const char *				p_file,
+			size_t						file_size,
+			const IndexCache::Key &		key,
+			const char *				format,
+			std::uint32_t				version,
+			size_t &					out_data_size )
+{
+	CacheFileHeader header;
+	char			header_format[8];
+
+	if(file_size < sizeof(header))
+		return nullptr;
+
+	std::memcpy(&header,p_file,sizeof(header));
+	set_format(header_format,format);
+
+	if(		std::memcmp(header.magic,CACHE_FILE_MAGIC,sizeof(header.magic))
+		||	(header.header_version != CACHE_FILE_VERSION)
+		||	(header.format_version != version)
+		||	std::memcmp(header.format,header_format,sizeof(header_format))
+		||	(header.archive_size != key.size)
+		||	(header.archive_mtime != key.mtime)
+		||	(header.archive_inode != key.inode)
+		||	(header.archive_device != key.device)
+		||	(header.path_size != key.path.size())
+		||	(header.path_size > (file_size - sizeof(header)))
+		||	(header.data_size != (file_size - sizeof(header) - header.path_size))
+		||	key.path.compare(0,std::string::npos,p_file + sizeof(header),header.path_size) )
+		return nullptr;
+
+	const char * p_data = p_file + sizeof(header) + header.path_size;
+	out_data_size = static_cast<size_t>(header.data_size);
+
+	if(checksum(p_data,out_data_size) != header.data_checksum)
+		return nullptr;
+
+	return p_data;
+}
+
+} // anonymous namespace
+
+//=============================================================================
+//
+//
+//	INDEX CACHE
+//
+//
+//=============================================================================
+
+IndexCache::IndexCache(const std::string & directory)
+	: m_directory(directory)
+{
+	std::replace(m_directory.begin(),m_directory.end(),'\\','/');
+
+	while((m_directory.size() > 1) && (m_directory.back() == '/'))
+		m_directory.pop_back();
+
+#ifdef _WIN32
+	_mkdir(m_directory.c_str());
+#else
+	::mkdir(m_directory.c_str(),0755);
+#endif
+}
+
+int
+IndexCache::make_key(const std::string & archive,Key & out_key)
+{
+#ifdef _WIN32
+	char				path[_MAX_PATH];
+	struct _stat64		st;
+
+	if(!_fullpath(path,archive.c_str(),sizeof(path)) || _stat64(path,&st))
+		return -1;
+
+	out_key.path	= path;
+	out_key.size	= static_cast<std::uint64_t>(st.st_size);
+	out_key.mtime	= static_cast<std::int64_t>(st.st_mtime) * 1000000000;
+	out_key.inode	= 0;
+	out_key.device	= static_cast<std::uint64_t>(st.st_dev);
+
+	std::replace(out_key.path.begin(),out_key.path.end(),'\\','/');
+#else
+	char				path[PATH_MAX];
+	struct stat			st;
+
+	if(!::realpath(archive.c_str(),path) || ::stat(path,&st))
+		return -1;
+
+	out_key.path	= path;
+	out_key.size	= static_cast<std::uint64_t>(st.st_size);
+#ifdef __APPLE__
+	out_key.mtime	= static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	out_key.mtime	= static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	out_key.inode	= static_cast<std::uint64_t>(st.st_ino);
+	out_key.device	= static_cast<std::uint64_t>(st.st_dev);
+#endif
+
+	return 0;
+}
+
+std::string
+IndexCache::cache_filename(const Key & key,const char * format) const
+{
+	static const char hex[] = "0123456789abcdef";
+
+	std::string		name(16,'0');
+	std::uint64_t	hash = hash_string(key.path);
+
+	for(size_t i = name.size();i > 0;--i,hash >>= 4)
+		name[i-1] = hex[hash & 0x0F];
+
+	std::string ext(format);
+	std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+
+	return m_directory + "/" + name + "." + ext + ".idx";
+}
+
+int
+IndexCache::load(	const Key &			key,
+					const char *		format,
+					std::uint32_t		version,
+					const parse_func &	parse )
+{
+	const std::string	filename	= cache_filename(key,format);
+	int					result		= -1;
+
+#ifdef _WIN32
+	std::ifstream file(filename.c_str(),std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+	if(file.is_open())
+	{
+		std::vector<char> image(static_cast<size_t>(file.tellg()));
+		file.seekg(0,std::ios::beg);
+
+		if(!image.empty() && file.read(image.data(),image.size()))
+		{
+			size_t			data_size	= 0;
+			const char *	p_data		= validate(image.data(),image.size(),key,format,version,data_size);
+
+			if(p_data)
+			{
+				IndexReader reader(p_data,data_size);
+				result = parse(reader);
+			}
+		}
+	}
+#else
+	const int fd = ::open(filename.c_str(),O_RDONLY | O_CLOEXEC);
+	if(fd >= 0)
+	{
+		struct stat st;
+
+		if(!::fstat(fd,&st) && (st.st_size >= static_cast<off_t>(sizeof(CacheFileHeader))))
+		{
+			const size_t	file_size	= static_cast<size_t>(st.st_size);
+			void *			p_map		= ::mmap(nullptr,file_size,PROT_READ,MAP_PRIVATE,fd,0);
+
+			if(p_map != MAP_FAILED)
+			{
+				size_t			data_size	= 0;
+				const char *	p_data		= validate(static_cast<const char *>(p_map),file_size,key,format,version,data_size);
+
+				if(p_data)
+				{
+					IndexReader reader(p_data,data_size);
+					result = parse(reader);
+				}
+
+				::munmap(p_map,file_size);
+			}
+		}
+
+		::close(fd);
+	}
+#endif
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if(result)
+		++m_stats.misses;
+	else
+		++m_stats.hits;
+
+	return (result ? -1 : 0);
+}
+
+int
+IndexCache::store(	const Key &			key,
+					const char *		format,
+					std::uint32_t		version,
+					const IndexWriter &	index )
+{
+	static std::atomic<unsigned> s_serial(0);
+
+	const std::vector<char> & data = index.data();
+
+	CacheFileHeader header;
+
+	std::memcpy(header.magic,CACHE_FILE_MAGIC,sizeof(header.magic));
+	set_format(header.format,format);
+	header.header_version	= CACHE_FILE_VERSION;
+	header.format_version	= version;
+	header.archive_size		= key.size;
+	header.archive_mtime	= key.mtime;
+	header.archive_inode	= key.inode;
+	header.archive_device	= key.device;
+	header.path_size		= static_cast<std::uint32_t>(key.path.size());
+	header.reserved			= 0;
+	header.data_size		= data.size();
+	header.data_checksum	= checksum(data.data(),data.size());
+
+	//-------------------------------------------------------------------------
+	//	Write the index to a temporary file and then rename it so that a
+	//	reader never sees a partly written index.
+	//-------------------------------------------------------------------------
+	const std::string filename = cache_filename(key,format);
+
+#ifdef _WIN32
+	const int pid = _getpid();
+#else
+	const int pid = static_cast<int>(::getpid());
+#endif
+
+	const std::string temp_filename = filename + ".tmp." + std::to_string(pid) + "." + std::to_string(s_serial++);
+
+	std::FILE * p_file = std::fopen(temp_filename.c_str(),"wb");
+	if(!p_file)
+		return -1;
+
+	bool b_ok =		(std::fwrite(&header,sizeof(header),1,p_file) == 1)
+				&&	(std::fwrite(key.path.data(),1,key.path.size(),p_file) == key.path.size())
+				&&	(std::fwrite(data.data(),1,data.size(),p_file) == data.size());
+
+	b_ok = !std::fclose(p_file) && b_ok;
+
+#ifdef _WIN32
+	if(b_ok)
+		std::remove(filename.c_str());
+#endif
+
+	if(!b_ok || std::rename(temp_filename.c_str(),filename.c_str()))
+	{
+		std::remove(temp_filename.c_str());
+		return -1;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	++m_stats.stores;
+
+	return 0;
+}
+
+void
+IndexCache::erase(const Key & key,const char * format)
+{
+	std::remove(cache_filename(key,format).c_str());
+}
+
+IndexCache::Statistics
+IndexCache::statistics() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+} // namespace adefs
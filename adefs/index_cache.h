@@ -0,0 +1,236 @@
+//=============================================================================
+//	FILE:					index_cache.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Persistent on-disk cache of parsed package indexes.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_INDEX_CACHE_H
+#define GUARD_ADEFS_INDEX_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <type_traits>
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	INDEX WRITER
+//
+//	Builds the binary image of a package index. Values are written in native
+//	byte order; an index is only ever read back on the machine that wrote it.
+//
+//=============================================================================
+
+class IndexWriter
+{
+private:
+	std::vector<char>				m_data;
+
+public:
+	template<typename T>
+	void							write(const T & value)
+									{
+										static_assert(std::is_trivially_copyable<T>::value,"Index values must be trivially copyable");
+										append(&value,sizeof(T));
+									}
+
+	void							write_string(const std::string & str)
+									{
+										write(static_cast<std::uint32_t>(str.size()));
+										append(str.data(),str.size());
+									}
+
+	template<typename T>
+	void							write_array(const std::vector<T> & array)
+									{
+										static_assert(std::is_trivially_copyable<T>::value,"Index values must be trivially copyable");
+										write(static_cast<std::uint64_t>(array.size()));
+										append(array.data(),array.size() * sizeof(T));
+									}
+
+	void							append(const void * p_data,size_t size)
+									{
+										if(size)
+										{
+											const auto p_bytes = static_cast<const char *>(p_data);
+											m_data.insert(m_data.end(),p_bytes,p_bytes + size);
+										}
+									}
+
+	const std::vector<char> &		data() const		{return m_data;}
+};
+
+//=============================================================================
+//
+//
+//	INDEX READER
+//
+//	Reads values back out of an index image. Every read is bounds checked;
+//	once a read has failed all of the following reads fail too, so a parser
+//	only needs to check is_fail() at the end.
+//
+//=============================================================================
+
+class IndexReader
+{
+private:
+	const char *					m_p_data;
+	const char *					m_p_end;
+	bool							m_b_fail	= false;
+
+public:
+	IndexReader(const char * p_data,size_t size) : m_p_data(p_data), m_p_end(p_data + size) {}
+
+	template<typename T>
+	bool							read(T & out_value)
+									{
+										static_assert(std::is_trivially_copyable<T>::value,"Index values must be trivially copyable");
+										const char * p_value = take(sizeof(T));
+										if(p_value)
+											std::memcpy(&out_value,p_value,sizeof(T));
+										return !!p_value;
+									}
+
+	bool							read_string(std::string & out_str)
+									{
+										std::uint32_t size = 0;
+										const char * p_str = (read(size) ? take(size) : nullptr);
+										if(p_str)
+											out_str.assign(p_str,size);
+										return !!p_str;
+									}
+
+	template<typename T>
+	bool							read_array(std::vector<T> & out_array)
+									{
+										static_assert(std::is_trivially_copyable<T>::value,"Index values must be trivially copyable");
+										std::uint64_t count = 0;
+										if(!read(count) || (count > (remaining() / sizeof(T))))
+										{
+											m_b_fail = true;
+											return false;
+										}
+										out_array.resize(static_cast<size_t>(count));
+										if(count)
+											std::memcpy(out_array.data(),take(out_array.size() * sizeof(T)),out_array.size() * sizeof(T));
+										return true;
+									}
+
+									// Returns a pointer to the next 'size' bytes and moves past them, or
+									// nullptr if there are not enough bytes left.
+	const char *					take(size_t size)
+									{
+										if(m_b_fail || (size > remaining()))
+										{
+											m_b_fail = true;
+											return nullptr;
+										}
+										const char * p_data = m_p_data;
+										m_p_data += size;
+										return p_data;
+									}
+
+	size_t							remaining() const	{return static_cast<size_t>(m_p_end - m_p_data);}
+	bool							is_fail() const		{return m_b_fail;}
+	bool							is_end() const		{return !m_b_fail && (m_p_data == m_p_end);}
+};
+
+//=============================================================================
+//
+//
+//	INDEX CACHE
+//
+//	Keeps the parsed index of each package in a small binary file so that
+//	mounting the same archive again does not have to read and parse its
+//	directory. A cached index is only used if the archive's path, size,
+//	modification time, inode and device all still match, and if the index
+//	was written for the same package format and format version.
+//
+//	Cache files are written to a temporary name and renamed into place, so
+//	several processes can share a cache directory. On POSIX systems cached
+//	indexes are mapped rather than read.
+//
+//=============================================================================
+
+class IndexCache
+{
+public:
+	//-------------------------------------------------------------------------
+	//	Identifies a particular version of an archive.
+	//-------------------------------------------------------------------------
+	struct Key
+	{
+		std::string						path;			// The absolute path of the archive.
+		std::uint64_t					size	= 0;
+		std::int64_t					mtime	= 0;	// Modification time in nanoseconds.
+		std::uint64_t					inode	= 0;
+		std::uint64_t					device	= 0;
+	};
+
+	struct Statistics
+	{
+		std::uint64_t					hits		= 0;	// Indexes loaded from the cache.
+		std::uint64_t					misses		= 0;	// Indexes that were missing or out of date.
+		std::uint64_t					stores		= 0;	// Indexes written to the cache.
+	};
+
+	typedef std::function<int(IndexReader & reader)>	parse_func;
+
+private:
+	std::string						m_directory;
+	mutable std::mutex				m_mutex;
+	Statistics						m_stats;
+
+public:
+	IndexCache(const IndexCache &) = delete;
+	IndexCache & operator=(const IndexCache &) = delete;
+
+									// The directory is created if it does not exist.
+	explicit IndexCache(const std::string & directory);
+
+	const std::string &				directory() const		{return m_directory;}
+
+									// Fill in the key for an archive. Returns -1 if the archive can not
+									// be found.
+	static int						make_key(const std::string & archive,Key & out_key);
+
+									// Look for the index of an archive. If a valid index is found then it
+									// is passed to 'parse' and the result of parse is returned, otherwise
+									// -1 is returned.
+	int								load(	const Key &			key,
+											const char *		format,
+											std::uint32_t		version,
+											const parse_func &	parse );
+
+									// Write the index of an archive to the cache.
+	int								store(	const Key &			key,
+											const char *		format,
+											std::uint32_t		version,
+											const IndexWriter &	index );
+
+									// Remove the cached index of an archive, if there is one.
+	void							erase(const Key & key,const char * format);
+
+	Statistics						statistics() const;
+
+private:
+	std::string						cache_filename(const Key & key,const char * format) const;
+};
+
+typedef std::shared_ptr<IndexCache>	index_cache_shared_ptr;
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_INDEX_CACHE_H
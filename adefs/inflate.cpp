@@ -0,0 +1,433 @@
+//=============================================================================
+//	FILE:					inflate.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Built-in DEFLATE (RFC 1951) decompressor.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <cstring>
+#include "inflate.h"
+
+namespace adefs
+{
+
+namespace
+{
+	//-------------------------------------------------------------------------
+	//	Base values and extra bits for the length and distance codes
+	//	(RFC 1951 section 3.2.5).
+	//-------------------------------------------------------------------------
+	const std::uint16_t	LENGTH_BASE[29]		= {	3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,
+												35,43,51,59,67,83,99,115,131,163,195,227,258 };
+	const std::uint8_t	LENGTH_EXTRA[29]	= {	0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,
+												3,3,3,3,4,4,4,4,5,5,5,5,0 };
+	const std::uint16_t	DIST_BASE[30]		= {	1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
+												257,385,513,769,1025,1537,2049,3073,4097,6145,
+												8193,12289,16385,24577 };
+	const std::uint8_t	DIST_EXTRA[30]		= {	0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,
+												7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+	//-------------------------------------------------------------------------
+	//	The order that the code length code lengths are stored in.
+	//-------------------------------------------------------------------------
+	const std::uint8_t	CLEN_ORDER[19]		= {16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15};
+}
+
+int
+Inflater::inflate(	const std::uint8_t *	p_source,
+					size_t					source_size,
+					std::uint8_t *			p_target,
+					size_t					target_size,
+					size_t &				out_size )
+{
+	m_p_in			= p_source;
+	m_p_in_end		= p_source + source_size;
+	m_bitbuf		= 0;
+	m_bitcount		= 0;
+	m_overrun		= 0;
+	m_p_out_begin	= p_target;
+	m_p_out			= p_target;
+	m_p_out_end		= p_target + target_size;
+
+	int		err		= 0;
+	bool	b_last	= false;
+
+	while(!b_last && !err)
+	{
+		refill();
+		b_last = !!bits(1);
+
+		switch(bits(2))
+		{
+			case 0 :	err = stored();		break;
+			case 1 :	err = fixed();		break;
+			case 2 :	err = dynamic();	break;
+			default :	err = -1;			break;
+		}
+
+		//---------------------------------------------------------------------
+		//	Fail if any of the padding past the end of the input was used.
+		//---------------------------------------------------------------------
+		if(m_bitcount < m_overrun * 8)
+			err = -1;
+	}
+
+	out_size = static_cast<size_t>(m_p_out - m_p_out_begin);
+
+	return err;
+}
+
+//-----------------------------------------------------------------------------
+//	Top up the bit buffer to at least 57 bits. Zeros are fed in once the
+//	input has run out and are counted so that truncated input is detected.
+//-----------------------------------------------------------------------------
+void
+Inflater::refill()
+{
+	while(m_bitcount <= 56)
+	{
+		std::uint64_t byte = 0;
+
+		if(m_p_in < m_p_in_end)
+			byte = *m_p_in++;
+		else
+			++m_overrun;
+
+		m_bitbuf	|= byte << m_bitcount;
+		m_bitcount	+= 8;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	Take bits from the bit buffer. The caller must have refilled the buffer.
+//-----------------------------------------------------------------------------
+inline std::uint32_t
+Inflater::bits(unsigned count)
+{
+	const std::uint32_t value = static_cast<std::uint32_t>(m_bitbuf & ((std::uint64_t(1) << count) - 1));
+
+	m_bitbuf	>>= count;
+	m_bitcount	-= count;
+
+	return value;
+}
+
+inline int
+Inflater::decode(const Huffman & huffman)
+{
+	const unsigned entry = huffman.fast[m_bitbuf & ((1 << FAST_BITS) - 1)];
+
+	if(!entry)
+		return decode_slow(huffman);
+
+	bits(entry >> 9);
+
+	return static_cast<int>(entry & 0x1FF);
+}
+
+//-----------------------------------------------------------------------------
+//	Decode a code that is too long for the fast table by walking the
+//	canonical code one bit at a time.
+//-----------------------------------------------------------------------------
+int
+Inflater::decode_slow(const Huffman & huffman)
+{
+	int code	= 0;
+	int first	= 0;
+	int index	= 0;
+
+	for(unsigned len = 1;len <= MAX_BITS;++len)
+	{
+		code |= static_cast<int>((m_bitbuf >> (len - 1)) & 1);
+
+		const int count = huffman.count[len];
+		if(code - first < count)
+		{
+			bits(len);
+			return huffman.symbol[index + (code - first)];
+		}
+
+		index	+= count;
+		first	+= count;
+		first	<<= 1;
+		code	<<= 1;
+	}
+
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+//	Build the decoding tables from a list of code lengths. Returns a negative
+//	value if the code is over-subscribed. Incomplete codes are allowed,
+//	invalid codes will be caught when they are decoded.
+//-----------------------------------------------------------------------------
+int
+Inflater::build(Huffman & huffman,const std::uint8_t * p_lengths,unsigned count)
+{
+	std::uint16_t offsets[MAX_BITS+2];
+
+	std::memset(huffman.count,0,sizeof(huffman.count));
+	std::memset(huffman.fast,0,sizeof(huffman.fast));
+
+	for(unsigned symbol = 0;symbol < count;++symbol)
+		++huffman.count[p_lengths[symbol]];
+
+	huffman.count[0] = 0;
+
+	int left = 1;
+	for(unsigned len = 1;len <= MAX_BITS;++len)
+	{
+		left <<= 1;
+		left -= huffman.count[len];
+		if(left < 0)
+			return -1;
+	}
+
+	offsets[1] = 0;
+	for(unsigned len = 1;len <= MAX_BITS;++len)
+		offsets[len+1] = offsets[len] + huffman.count[len];
+
+	for(unsigned symbol = 0;symbol < count;++symbol)
+		if(p_lengths[symbol])
+			huffman.symbol[offsets[p_lengths[symbol]]++] = static_cast<std::uint16_t>(symbol);
+
+	//-------------------------------------------------------------------------
+	//	Fill the fast lookup table. The bits are read LSB first so each code
+	//	is bit reversed and repeated for every value of the unused high bits.
+	//-------------------------------------------------------------------------
+	unsigned code	= 0;
+	unsigned index	= 0;
+
+	for(unsigned len = 1;len <= FAST_BITS;++len)
+	{
+		for(unsigned i = 0;i < huffman.count[len];++i,++code,++index)
+		{
+			unsigned reversed = 0;
+			for(unsigned bit = 0;bit < len;++bit)
+				reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+
+			const std::uint16_t entry = static_cast<std::uint16_t>((len << 9) | huffman.symbol[index]);
+			for(unsigned fill = reversed;fill < (1u << FAST_BITS);fill += (1u << len))
+				huffman.fast[fill] = entry;
+		}
+
+		code <<= 1;
+	}
+
+	return left;
+}
+
+//-----------------------------------------------------------------------------
+//	Stored (uncompressed) block.
+//-----------------------------------------------------------------------------
+int
+Inflater::stored()
+{
+	//-------------------------------------------------------------------------
+	//	Discard the rest of the current byte and give any whole bytes still
+	//	in the bit buffer back to the input.
+	//-------------------------------------------------------------------------
+	bits(m_bitcount & 7);
+
+	const unsigned buffered = m_bitcount / 8;
+	if(buffered < m_overrun)
+		return -1;
+
+	m_p_in		-= (buffered - m_overrun);
+	m_bitbuf	= 0;
+	m_bitcount	= 0;
+	m_overrun	= 0;
+
+	if(m_p_in_end - m_p_in < 4)
+		return -1;
+
+	const unsigned len	= m_p_in[0] | (m_p_in[1] << 8);
+	const unsigned nlen	= m_p_in[2] | (m_p_in[3] << 8);
+	m_p_in += 4;
+
+	if(		(len != (~nlen & 0xFFFF))
+		||	(len > static_cast<size_t>(m_p_in_end - m_p_in))
+		||	(len > static_cast<size_t>(m_p_out_end - m_p_out)) )
+		return -1;
+
+	if(len)
+		std::memcpy(m_p_out,m_p_in,len);
+	m_p_out	+= len;
+	m_p_in	+= len;
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+//	Block compressed with the fixed Huffman codes.
+//-----------------------------------------------------------------------------
+int
+Inflater::fixed()
+{
+	std::uint8_t lengths[288+30];
+	unsigned symbol = 0;
+
+	for(;symbol < 144;++symbol)	lengths[symbol] = 8;
+	for(;symbol < 256;++symbol)	lengths[symbol] = 9;
+	for(;symbol < 280;++symbol)	lengths[symbol] = 7;
+	for(;symbol < 288;++symbol)	lengths[symbol] = 8;
+	for(;symbol < 318;++symbol)	lengths[symbol] = 5;
+
+	build(m_lencode,lengths,288);
+	build(m_distcode,lengths+288,30);
+
+	return codes();
+}
+
+//-----------------------------------------------------------------------------
+//	Block compressed with dynamic Huffman codes.
+//-----------------------------------------------------------------------------
+int
+Inflater::dynamic()
+{
+	std::uint8_t lengths[288+32];
+
+	refill();
+
+	const unsigned nlen		= bits(5) + 257;
+	const unsigned ndist	= bits(5) + 1;
+	const unsigned ncode	= bits(4) + 4;
+
+	if((nlen > 286) || (ndist > 30))
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Read the code length code lengths and build the code length code.
+	//-------------------------------------------------------------------------
+	std::memset(lengths,0,19);
+
+	for(unsigned index = 0;index < ncode;++index)
+	{
+		refill();
+		lengths[CLEN_ORDER[index]] = static_cast<std::uint8_t>(bits(3));
+	}
+
+	if(build(m_lencode,lengths,19))
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Read the literal/length and distance code lengths.
+	//-------------------------------------------------------------------------
+	unsigned index = 0;
+
+	while(index < nlen + ndist)
+	{
+		refill();
+
+		int symbol = decode(m_lencode);
+		if(symbol < 0)
+			return -1;
+
+		if(symbol < 16)
+			lengths[index++] = static_cast<std::uint8_t>(symbol);
+		else
+		{
+			std::uint8_t	len		= 0;
+			unsigned		repeat;
+
+			if(symbol == 16)
+			{
+				if(!index)
+					return -1;
+				len		= lengths[index-1];
+				repeat	= 3 + bits(2);
+			}
+			else if(symbol == 17)
+				repeat = 3 + bits(3);
+			else
+				repeat = 11 + bits(7);
+
+			if(index + repeat > nlen + ndist)
+				return -1;
+
+			while(repeat--)
+				lengths[index++] = len;
+		}
+	}
+
+	if(!lengths[256])
+		return -1;
+
+	if(		(build(m_lencode,lengths,nlen) < 0)
+		||	(build(m_distcode,lengths+nlen,ndist) < 0) )
+		return -1;
+
+	return codes();
+}
+
+//-----------------------------------------------------------------------------
+//	Decode the literals and length/distance pairs of a compressed block.
+//-----------------------------------------------------------------------------
+int
+Inflater::codes()
+{
+	for(;;)
+	{
+		//---------------------------------------------------------------------
+		//	A symbol, its length extra bits, the distance symbol and the
+		//	distance extra bits need at most 48 bits.
+		//---------------------------------------------------------------------
+		if(m_bitcount < 48)
+		{
+			refill();
+			if(m_overrun > 8)
+				return -1;
+		}
+
+		int symbol = decode(m_lencode);
+
+		if(symbol < 256)
+		{
+			if((symbol < 0) || (m_p_out == m_p_out_end))
+				return -1;
+
+			*m_p_out++ = static_cast<std::uint8_t>(symbol);
+		}
+		else if(symbol == 256)
+			return 0;
+		else
+		{
+			symbol -= 257;
+			if(symbol >= 29)
+				return -1;
+
+			const size_t len = LENGTH_BASE[symbol] + bits(LENGTH_EXTRA[symbol]);
+
+			symbol = decode(m_distcode);
+			if((symbol < 0) || (symbol >= 30))
+				return -1;
+
+			const size_t dist = DIST_BASE[symbol] + bits(DIST_EXTRA[symbol]);
+
+			if(		(dist > static_cast<size_t>(m_p_out - m_p_out_begin))
+				||	(len > static_cast<size_t>(m_p_out_end - m_p_out)) )
+				return -1;
+
+			//-----------------------------------------------------------------
+			//	Overlapping copies have to be done a byte at a time so that
+			//	repeated runs are expanded correctly.
+			//-----------------------------------------------------------------
+			const std::uint8_t * p_from = m_p_out - dist;
+
+			if(dist >= len)
+				std::memcpy(m_p_out,p_from,len);
+			else
+			{
+				for(size_t i = 0;i < len;++i)
+					m_p_out[i] = p_from[i];
+			}
+
+			m_p_out += len;
+		}
+	}
+}
+
+} // namespace adefs
@@ -0,0 +1,91 @@
+//=============================================================================
+//	FILE:					inflate.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Built-in DEFLATE (RFC 1951) decompressor.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_INFLATE_H
+#define GUARD_ADEFS_INFLATE_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	INFLATER
+//
+//	Decompresses a complete raw DEFLATE stream (no zlib or gzip wrapper)
+//	into a buffer. The whole of the compressed data must be available, there
+//	is no support for streaming. An Inflater can be reused for any number of
+//	streams.
+//
+//=============================================================================
+
+class Inflater
+{
+private:
+	enum
+	{
+		FAST_BITS	= 10,						// Codes up to this length are decoded with a single table lookup.
+		MAX_BITS	= 15
+	};
+
+	struct Huffman
+	{
+		std::uint16_t				fast[1 << FAST_BITS];	// (length << 9) | symbol. Zero if the code is longer than FAST_BITS.
+		std::uint16_t				count[MAX_BITS+1];		// Number of codes of each length.
+		std::uint16_t				symbol[288];			// Symbols ordered by code.
+	};
+
+	const std::uint8_t *			m_p_in			= nullptr;
+	const std::uint8_t *			m_p_in_end		= nullptr;
+	std::uint64_t					m_bitbuf		= 0;
+	unsigned						m_bitcount		= 0;
+	unsigned						m_overrun		= 0;		// Number of zero bytes fed in past the end of the input.
+
+	std::uint8_t *					m_p_out_begin	= nullptr;
+	std::uint8_t *					m_p_out			= nullptr;
+	std::uint8_t *					m_p_out_end		= nullptr;
+
+	Huffman							m_lencode;
+	Huffman							m_distcode;
+
+public:
+	Inflater(const Inflater &) = delete;
+	Inflater & operator=(const Inflater &) = delete;
+
+	Inflater(void) = default;
+	~Inflater(void) = default;
+
+									// Returns 0 on success. The number of bytes written to the target
+									// is returned in out_size.
+	int								inflate(const std::uint8_t *	p_source,
+											size_t					source_size,
+											std::uint8_t *			p_target,
+											size_t					target_size,
+											size_t &				out_size );
+
+private:
+	void							refill();
+	std::uint32_t					bits(unsigned count);
+	int								decode(const Huffman & huffman);
+	int								decode_slow(const Huffman & huffman);
+	int								build(Huffman & huffman,const std::uint8_t * p_lengths,unsigned count);
+
+	int								stored();
+	int								fixed();
+	int								dynamic();
+	int								codes();
+};
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_INFLATE_H
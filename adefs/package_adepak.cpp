@@ -0,0 +1,990 @@
+//=============================================================================
+//	FILE:					package_adepak.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	ADEPAK, the native package format.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include "package_adepak.h"
+#include "checksum.h"
+
+#ifdef HAVE_ZLIB
+	#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+	#include <zstd.h>
+
+	#ifndef ZSTD_CLEVEL_DEFAULT
+		#define ZSTD_CLEVEL_DEFAULT 3
+	#endif
+#endif
+
+namespace adefs { namespace package_adepak
+{
+
+namespace
+{
+
+std::uint32_t
+read_u32(const char * p_data)
+{
+	std::uint32_t value;
+	std::memcpy(&value,p_data,sizeof(value));
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+//	Put a path into the form that is stored in the package: '/' separators,
+//	no leading '/' and case folded.
+//-----------------------------------------------------------------------------
+std::string
+fold_path(const std::string & path)
+{
+	std::string folded(path);
+
+	std::replace(folded.begin(),folded.end(),'\\','/');
+	folded.erase(0,folded.find_first_not_of('/'));
+	std::transform(folded.begin(),folded.end(),folded.begin(),::tolower);
+
+	return folded;
+}
+
+} // anonymous namespace
+
+std::uint64_t
+hash_path(const char * p_path,size_t size,std::uint64_t hash)
+{
+	while(size--)
+		hash = (hash ^ static_cast<std::uint64_t>(::tolower(static_cast<unsigned char>(*p_path++)))) * 0x100000001B3ull;
+
+	return hash;
+}
+
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - DIRECTORY CLASS
+//
+//
+//=============================================================================
+
+DirectoryADEPAK::DirectoryADEPAK(PackageADEPAK * p_package,std::uint32_t index,const std::string & path)
+	: m_p_package(p_package)
+	, m_index(index)
+	, m_prefix(path)
+{
+	assert(m_p_package);
+
+	if(!m_prefix.empty())
+		m_prefix.push_back('/');
+}
+
+std::int64_t
+DirectoryADEPAK::find(const std::string & filename) const
+{
+	return m_p_package->find(m_prefix + filename);
+}
+
+size_t
+DirectoryADEPAK::file_size(const std::string & filename)
+{
+	PakEntry entry;
+	const auto index = find(filename);
+
+	if((index < 0) || m_p_package->get_entry(static_cast<std::uint32_t>(index),entry))
+		return 0;
+
+	return static_cast<size_t>(entry.size);
+}
+
+Attributes
+DirectoryADEPAK::file_attr(const std::string & filename)
+{
+	return (find(filename) >= 0 ? ATTR_READ : 0);
+}
+
+bool
+DirectoryADEPAK::file_exists(const std::string & filename)
+{
+	return (find(filename) >= 0);
+}
+
+std::vector<std::string>
+DirectoryADEPAK::file_list()
+{
+	std::vector<std::string>	files;
+	PakDirectory				directory;
+	PakEntry					entry;
+
+	if(m_p_package->get_directory(m_index,directory))
+		return files;
+
+	for(std::uint32_t i = 0;i < directory.file_count;++i)
+	{
+		if(m_p_package->get_entry(m_p_package->get_directory_file(directory.first_file + i),entry))
+			continue;
+
+		const std::string path = m_p_package->get_path(entry);
+		files.push_back(path.substr(path.find_last_of('/') + 1));
+	}
+
+	return files;
+}
+
+std::unique_ptr<IFile>
+DirectoryADEPAK::openfile(	const std::string & filename,
+							std::uint32_t		mode )
+{
+	if((mode & (MODE_WRITE | MODE_APPEND)) || !(mode & MODE_READ))
+		return nullptr;
+
+	const auto index = find(filename);
+	if(index < 0)
+		return nullptr;
+
+	return m_p_package->openfile(static_cast<std::uint32_t>(index),mode);
+}
+
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - PACKAGE CLASS
+//
+//
+//=============================================================================
+
+PackageADEPAK::PackageADEPAK(const std::string & filename)
+	: m_filename(filename)
+	, m_b_own_source(true)
+{
+	std::replace(m_filename.begin(),m_filename.end(),'\\','/');
+	std::memset(&m_header,0,sizeof(m_header));
+}
+
+PackageADEPAK::PackageADEPAK(data_source_shared_ptr p_source,const std::string & name)
+	: m_filename(name)
+	, m_p_source(std::move(p_source))
+	, m_b_own_source(false)
+{
+	std::memset(&m_header,0,sizeof(m_header));
+}
+
+int
+PackageADEPAK::scan()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_directories.clear();
+	m_index.clear();
+	std::memset(&m_header,0,sizeof(m_header));
+	m_p_entries = m_p_buckets = m_p_directories = m_p_directory_files = m_p_names = nullptr;
+	m_names_size = 0;
+
+	//-------------------------------------------------------------------------
+	//	Map the package. If it can't be mapped then it is read instead.
+	//-------------------------------------------------------------------------
+	if(m_b_own_source)
+	{
+		m_p_source.reset();
+
+		auto p_map = std::make_shared<DataSourceMap>();
+		if(!p_map->open(m_filename))
+			m_p_source = p_map;
+		else
+		{
+			auto p_file = std::make_shared<DataSourceFile>();
+			if(p_file->open(m_filename))
+				return -1;
+
+			m_p_source = p_file;
+		}
+	}
+
+	if(!m_p_source)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Read and validate the header.
+	//-------------------------------------------------------------------------
+	const std::uint64_t	filesize = m_p_source->size();
+	PakHeader			header;
+
+	if(m_p_source->read_at(0,&header,sizeof(header)) != sizeof(header))
+		return -1;
+
+	const std::uint32_t header_crc = header.header_crc;
+	header.header_crc = 0;
+
+	if(		std::memcmp(header.magic,PAK_MAGIC,sizeof(header.magic))
+		||	(header.version != PAK_VERSION)
+		||	(header.header_size != sizeof(PakHeader))
+		||	(crc32(&header,sizeof(header)) != header_crc)
+		||	(header.bucket_bits > 31)
+		||	(header.index_offset > filesize)
+		||	(header.index_size > filesize - header.index_offset) )
+	{
+		std::clog << "PACKAGEADEPAK: '" << m_filename << "' is not a valid ADEPAK file\n";
+		return -1;
+	}
+
+	header.header_crc = header_crc;
+
+	//-------------------------------------------------------------------------
+	//	Find the tables in the index.
+	//-------------------------------------------------------------------------
+	const std::uint64_t entries_size			= static_cast<std::uint64_t>(header.entry_count) * sizeof(PakEntry);
+	const std::uint64_t buckets_size			= ((1ull << header.bucket_bits) + 1) * sizeof(std::uint32_t);
+	const std::uint64_t directories_size		= static_cast<std::uint64_t>(header.directory_count) * sizeof(PakDirectory);
+	const std::uint64_t directory_files_size	= static_cast<std::uint64_t>(header.entry_count) * sizeof(std::uint32_t);
+	const std::uint64_t tables_size				= entries_size + buckets_size + directories_size + directory_files_size;
+
+	if(tables_size > header.index_size)
+		return -1;
+
+	const char * p_index = m_p_source->data();
+
+	if(p_index)
+		p_index += header.index_offset;
+	else
+	{
+		m_index.resize(static_cast<size_t>(header.index_size));
+		if(m_p_source->read_at(header.index_offset,m_index.data(),m_index.size()) != m_index.size())
+			return -1;
+
+		p_index = m_index.data();
+	}
+
+	m_header			= header;
+	m_p_entries			= p_index;
+	m_p_buckets			= m_p_entries + entries_size;
+	m_p_directories		= m_p_buckets + buckets_size;
+	m_p_directory_files	= m_p_directories + directories_size;
+	m_p_names			= m_p_directory_files + directory_files_size;
+	m_names_size		= header.index_size - tables_size;
+
+	return 0;
+}
+
+int
+PackageADEPAK::mount(MountPoint * p_mountpoint)
+{
+	if(!p_mountpoint)
+		return -1;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//-------------------------------------------------------------------------
+	//	The directories are created the first time that the package is
+	//	mounted. The mountpoints only hold weak pointers so the package keeps
+	//	them.
+	//-------------------------------------------------------------------------
+	if(m_directories.empty())
+	{
+		PakDirectory directory;
+
+		for(std::uint32_t index = 0;index < m_header.directory_count;++index)
+		{
+			if(get_directory(index,directory))
+				return -1;
+
+			const std::string path(m_p_names + directory.name_offset,directory.name_size);
+			m_directories.push_back(std::make_shared<DirectoryADEPAK>(this,index,path));
+		}
+	}
+
+	bool err = false;
+
+	for(auto & p_dir : m_directories)
+	{
+		const DirectoryADEPAK & dir = *static_cast<DirectoryADEPAK *>(p_dir.get());
+		err |= !!p_mountpoint->mount(dir.get_path(),p_dir);
+	}
+
+	return (int)err;
+}
+
+std::int64_t
+PackageADEPAK::find(const std::string & path) const
+{
+	const std::string folded = fold_path(path);
+	return find(folded.data(),folded.size(),hash_path(folded.data(),folded.size()));
+}
+
+std::int64_t
+PackageADEPAK::find(const char * p_path,size_t size,std::uint64_t hash) const
+{
+	if(!m_p_entries)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	The entries are sorted by hash so the entries in a bucket are all
+	//	together, and within the bucket the search can stop as soon as it
+	//	passes the hash.
+	//-------------------------------------------------------------------------
+	const std::uint64_t	bucket	= (m_header.bucket_bits ? (hash >> (64 - m_header.bucket_bits)) : 0);
+	const std::uint32_t	first	= read_u32(m_p_buckets + (bucket * sizeof(std::uint32_t)));
+	const std::uint32_t	last	= read_u32(m_p_buckets + ((bucket + 1) * sizeof(std::uint32_t)));
+
+	if((first > last) || (last > m_header.entry_count))
+		return -1;
+
+	for(std::uint32_t index = first;index < last;++index)
+	{
+		std::uint64_t entry_hash;
+		std::memcpy(&entry_hash,m_p_entries + (static_cast<std::uint64_t>(index) * sizeof(PakEntry)),sizeof(entry_hash));
+
+		if(entry_hash > hash)
+			break;
+
+		if(entry_hash < hash)
+			continue;
+
+		PakEntry entry;
+		get_entry(index,entry);
+
+		if(		(entry.name_size == size)
+			&&	(static_cast<std::uint64_t>(entry.name_offset) + size <= m_names_size)
+			&&	!std::memcmp(m_p_names + entry.name_offset,p_path,size) )
+			return index;
+	}
+
+	return -1;
+}
+
+int
+PackageADEPAK::get_entry(std::uint32_t index,PakEntry & out_entry) const
+{
+	if(!m_p_entries || (index >= m_header.entry_count))
+		return -1;
+
+	std::memcpy(&out_entry,m_p_entries + (static_cast<std::uint64_t>(index) * sizeof(PakEntry)),sizeof(PakEntry));
+	return 0;
+}
+
+std::string
+PackageADEPAK::get_path(const PakEntry & entry) const
+{
+	if(static_cast<std::uint64_t>(entry.name_offset) + entry.name_size > m_names_size)
+		return std::string();
+
+	return std::string(m_p_names + entry.name_offset,entry.name_size);
+}
+
+int
+PackageADEPAK::get_directory(std::uint32_t index,PakDirectory & out_directory) const
+{
+	if(!m_p_directories || (index >= m_header.directory_count))
+		return -1;
+
+	std::memcpy(&out_directory,m_p_directories + (static_cast<std::uint64_t>(index) * sizeof(PakDirectory)),sizeof(PakDirectory));
+
+	if(		(static_cast<std::uint64_t>(out_directory.name_offset) + out_directory.name_size > m_names_size)
+		||	(static_cast<std::uint64_t>(out_directory.first_file) + out_directory.file_count > m_header.entry_count) )
+		return -1;
+
+	return 0;
+}
+
+std::uint32_t
+PackageADEPAK::get_directory_file(std::uint32_t index) const
+{
+	if(!m_p_directory_files || (index >= m_header.entry_count))
+		return UINT32_MAX;
+
+	return read_u32(m_p_directory_files + (static_cast<std::uint64_t>(index) * sizeof(std::uint32_t)));
+}
+
+int
+PackageADEPAK::read_data(const PakEntry & entry,std::vector<char> & out_data)
+{
+	out_data.resize(static_cast<size_t>(entry.stored_size));
+	return (m_p_source->read_at(entry.offset,out_data.data(),out_data.size()) == out_data.size() ? 0 : -1);
+}
+
+std::unique_ptr<IFile>
+PackageADEPAK::openfile(std::uint32_t index,std::uint32_t mode)
+{
+	std::unique_ptr<IFile>	p_file;
+	PakEntry				entry;
+
+	if(get_entry(index,entry))
+		return p_file;
+
+	auto p_source = m_p_source;
+	if(		!p_source
+		||	(entry.offset > p_source->size())
+		||	(entry.stored_size > p_source->size() - entry.offset) )
+		return p_file;
+
+	try
+	{
+		//---------------------------------------------------------------------
+		//	Stored files are used straight from the mapping.
+		//---------------------------------------------------------------------
+		if(entry.compression == COMPRESSION_STORE)
+		{
+			if(entry.stored_size != entry.size)
+				return p_file;
+
+			if(p_source->data())
+				p_file = std::make_unique<FileMemoryView>(p_source,p_source->data() + entry.offset,static_cast<size_t>(entry.size));
+			else
+			{
+				std::vector<char> data;
+				if(read_data(entry,data))
+					return p_file;
+
+				auto p_new_file = std::make_unique<FileInMemory>(MODE_READ);
+				p_new_file->swap(data);
+				p_file = std::move(p_new_file);
+			}
+		}
+		else
+		{
+			auto p_decompressor = DecompressorRegistry::instance().create(entry.compression);
+			if(!p_decompressor)
+				return p_file;
+
+			std::vector<char>	data;
+			const char *		p_data = p_source->data();
+
+			if(p_data)
+				p_data += entry.offset;
+			else
+			{
+				if(read_data(entry,data))
+					return p_file;
+
+				p_data = data.data();
+			}
+
+			std::vector<char> output(static_cast<size_t>(entry.size));
+
+			if(!output.empty() && p_decompressor->decompress(	reinterpret_cast<const std::uint8_t *>(p_data),static_cast<size_t>(entry.stored_size),
+																reinterpret_cast<std::uint8_t *>(output.data()),output.size() ))
+			{
+				std::clog << "PACKAGEADEPAK: Failed to decompress entry " << index << " of '" << m_filename << "'\n";
+				return p_file;
+			}
+
+			auto p_new_file = std::make_unique<FileInMemory>(MODE_READ);
+			p_new_file->swap(output);
+			p_file = std::move(p_new_file);
+		}
+
+		if(mode & MODE_AT_END)
+			p_file->seek(static_cast<filepos>(entry.size));
+	}
+	catch(...){}
+
+	return p_file;
+}
+
+int
+PackageADEPAK::for_each_entry(const package_entry_func & func)
+{
+	std::vector<std::uint32_t>	order(m_header.entry_count);
+	std::vector<std::uint64_t>	offsets(m_header.entry_count);
+	PakEntry					entry;
+
+	std::iota(order.begin(),order.end(),0);
+
+	for(std::uint32_t index = 0;index < m_header.entry_count;++index)
+		offsets[index] = (get_entry(index,entry) ? 0 : entry.offset);
+
+	std::sort(order.begin(),order.end(),[&](std::uint32_t a,std::uint32_t b) {return offsets[a] < offsets[b];});
+
+	int result = 0;
+
+	for(auto index : order)
+	{
+		auto p_file = openfile(index);
+		if(!p_file || get_entry(index,entry))
+		{
+			result = -1;
+			continue;
+		}
+
+		PackageEntry info;
+		info.path			= get_path(entry);
+		info.size			= entry.size;
+		info.stored_size	= entry.stored_size;
+		info.offset			= entry.offset;
+		info.compression	= entry.compression;
+		info.crc			= entry.crc;
+
+		const int func_result = func(info,*p_file);
+		if(func_result)
+			return func_result;
+	}
+
+	return result;
+}
+
+int
+PackageADEPAK::verify()
+{
+	if(!m_p_entries || (crc32(m_p_entries,static_cast<size_t>(m_header.index_size)) != m_header.index_crc))
+		return -1;
+
+	int					result = 0;
+	std::vector<char>	buffer(64 * 1024);
+
+	const int walk_result = for_each_entry([&](const PackageEntry & info,IFile & file)
+	{
+		std::uint32_t	crc		= 0;
+		std::uint64_t	total	= 0;
+		size_t			readsize;
+
+		while((readsize = file.read(buffer.data(),buffer.size())) != 0)
+		{
+			crc		= crc32(buffer.data(),readsize,crc);
+			total	+= readsize;
+		}
+
+		if((crc != info.crc) || (total != info.size))
+		{
+			std::clog << "PACKAGEADEPAK: '" << info.path << "' in '" << m_filename << "' is damaged\n";
+			result = -1;
+		}
+
+		return 0;
+	});
+
+	return (walk_result ? -1 : result);
+}
+
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - WRITER CLASS
+//
+//
+//=============================================================================
+
+WriterADEPAK::~WriterADEPAK(void)
+{
+	abort();
+}
+
+bool
+WriterADEPAK::can_compress(std::uint16_t method)
+{
+	switch(method)
+	{
+		case COMPRESSION_STORE:		return true;
+#ifdef HAVE_ZLIB
+		case COMPRESSION_DEFLATE:	return true;
+#endif
+#ifdef HAVE_ZSTD
+		case COMPRESSION_ZSTD:		return true;
+#endif
+		default:					return false;
+	}
+}
+
+int
+WriterADEPAK::open(const std::string & filename)
+{
+	return open(filename,Options());
+}
+
+int
+WriterADEPAK::open(const std::string & filename,const Options & options)
+{
+	if(m_p_file)
+		return -1;
+
+	m_options = options;
+	if(!m_options.page_size)
+		m_options.page_size = PAK_PAGE_SIZE;
+
+	m_p_file = std::fopen(filename.c_str(),"wb");
+	if(!m_p_file)
+		return -1;
+
+	m_filename	= filename;
+	m_offset	= 0;
+	m_entries.clear();
+	m_entry_index.clear();
+
+	//-------------------------------------------------------------------------
+	//	The header is written by close(). Its page is reserved now.
+	//-------------------------------------------------------------------------
+	PakHeader header;
+	std::memset(&header,0,sizeof(header));
+
+	if(write(&header,sizeof(header)) || pad(m_options.page_size))
+	{
+		abort();
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+WriterADEPAK::add(const std::string & path,const char * p_data,size_t size)
+{
+	if(!m_p_file)
+		return -1;
+
+	const std::string folded = fold_path(path);
+	if(folded.empty() || (folded.back() == '/'))
+		return -1;
+
+	PakEntry record;
+	std::memset(&record,0,sizeof(record));
+
+	record.hash			= hash_path(folded.data(),folded.size());
+	record.size			= size;
+	record.crc			= crc32(p_data,size);
+	record.compression	= COMPRESSION_STORE;
+
+	//-------------------------------------------------------------------------
+	//	Files are only kept compressed if compression makes them smaller.
+	//-------------------------------------------------------------------------
+	const char *	p_stored	= p_data;
+	size_t			stored_size	= size;
+
+	if(		(m_options.compression != COMPRESSION_STORE)
+		&&	(size >= m_options.min_compress)
+		&&	!compress(p_data,size,m_options.compression)
+		&&	(m_compressed.size() < size) )
+	{
+		p_stored			= m_compressed.data();
+		stored_size			= m_compressed.size();
+		record.compression	= m_options.compression;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Stored files of a page or more start on a page boundary. Smaller ones
+	//	are packed but never cross a page boundary, so each one is read with
+	//	a single page.
+	//-------------------------------------------------------------------------
+	bool b_pad_error = !!pad(PAK_PACK_ALIGNMENT);
+
+	if(		(record.compression == COMPRESSION_STORE)
+		&&	((stored_size >= m_options.page_size) || ((m_offset % m_options.page_size) + stored_size > m_options.page_size)) )
+		b_pad_error |= !!pad(m_options.page_size);
+
+	if(b_pad_error)
+	{
+		abort();
+		return -1;
+	}
+
+	record.offset		= m_offset;
+	record.stored_size	= stored_size;
+
+	if(write(p_stored,stored_size))
+	{
+		abort();
+		return -1;
+	}
+
+	auto ifind = m_entry_index.find(folded);
+	if(ifind != m_entry_index.end())
+		m_entries[ifind->second].record = record;
+	else
+	{
+		m_entry_index[folded] = m_entries.size();
+		m_entries.push_back(Entry{folded,record});
+	}
+
+	return 0;
+}
+
+int
+WriterADEPAK::add(const std::string & path,IFile & file)
+{
+	std::vector<char>	data(file.size());
+	size_t				total = 0;
+
+	while(total < data.size())
+	{
+		const size_t readsize = file.read(data.data() + total,data.size() - total);
+		if(!readsize)
+			return -1;
+
+		total += readsize;
+	}
+
+	return add(path,data.data(),data.size());
+}
+
+int
+WriterADEPAK::add_package(IPackage & package,const std::string & prefix)
+{
+	std::string base = fold_path(prefix);
+	if(!base.empty() && (base.back() != '/'))
+		base.push_back('/');
+
+	return package.for_each_entry([&](const PackageEntry & entry,IFile & file)
+	{
+		return add(base + entry.path,file);
+	});
+}
+
+int
+WriterADEPAK::close()
+{
+	if(!m_p_file)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Sort the entries by hash and group them by directory.
+	//-------------------------------------------------------------------------
+	std::sort(m_entries.begin(),m_entries.end(),[](const Entry & a,const Entry & b)
+	{
+		return (a.record.hash != b.record.hash ? a.record.hash < b.record.hash : a.path < b.path);
+	});
+
+	std::map<std::string,std::vector<std::uint32_t>> directories;
+	directories[std::string()];
+
+	for(std::uint32_t index = 0;index < m_entries.size();++index)
+	{
+		const auto & path	= m_entries[index].path;
+		const auto pos		= path.find_last_of('/');
+
+		directories[pos == std::string::npos ? std::string() : path.substr(0,pos)].push_back(index);
+	}
+
+	//-------------------------------------------------------------------------
+	//	Build the names and the tables.
+	//-------------------------------------------------------------------------
+	std::string					names;
+	std::vector<PakDirectory>	directory_table;
+	std::vector<std::uint32_t>	directory_files;
+
+	for(auto & entry : m_entries)
+	{
+		entry.record.name_offset	= static_cast<std::uint32_t>(names.size());
+		entry.record.name_size		= static_cast<std::uint32_t>(entry.path.size());
+		names += entry.path;
+	}
+
+	for(auto & dir_pair : directories)
+	{
+		PakDirectory directory;
+		directory.name_offset	= static_cast<std::uint32_t>(names.size());
+		directory.name_size		= static_cast<std::uint32_t>(dir_pair.first.size());
+		directory.first_file	= static_cast<std::uint32_t>(directory_files.size());
+		directory.file_count	= static_cast<std::uint32_t>(dir_pair.second.size());
+
+		names += dir_pair.first;
+		directory_files.insert(directory_files.end(),dir_pair.second.begin(),dir_pair.second.end());
+		directory_table.push_back(directory);
+	}
+
+	if(names.size() > UINT32_MAX)
+	{
+		abort();
+		return -1;
+	}
+
+	std::uint32_t bucket_bits = 0;
+	while((bucket_bits < 31) && ((1ull << bucket_bits) < m_entries.size()))
+		++bucket_bits;
+
+	const std::uint64_t			bucket_count = 1ull << bucket_bits;
+	std::vector<std::uint32_t>	buckets(static_cast<size_t>(bucket_count + 1));
+	std::uint32_t				index = 0;
+
+	for(std::uint64_t bucket = 0;bucket <= bucket_count;++bucket)
+	{
+		while(		(index < m_entries.size())
+				&&	((bucket_bits ? (m_entries[index].record.hash >> (64 - bucket_bits)) : 0) < bucket) )
+			++index;
+
+		buckets[static_cast<size_t>(bucket)] = index;
+	}
+
+	buckets.back() = static_cast<std::uint32_t>(m_entries.size());
+
+	std::vector<char> index_data;
+	auto append = [&](const void * p_data,size_t size)
+	{
+		index_data.insert(index_data.end(),static_cast<const char *>(p_data),static_cast<const char *>(p_data) + size);
+	};
+
+	for(auto & entry : m_entries)
+		append(&entry.record,sizeof(PakEntry));
+
+	append(buckets.data(),buckets.size() * sizeof(std::uint32_t));
+	append(directory_table.data(),directory_table.size() * sizeof(PakDirectory));
+	append(directory_files.data(),directory_files.size() * sizeof(std::uint32_t));
+	append(names.data(),names.size());
+
+	//-------------------------------------------------------------------------
+	//	Write the index and then go back and fill in the header.
+	//-------------------------------------------------------------------------
+	PakHeader header;
+	std::memset(&header,0,sizeof(header));
+	std::memcpy(header.magic,PAK_MAGIC,sizeof(header.magic));
+
+	if(pad(8))
+	{
+		abort();
+		return -1;
+	}
+
+	header.version			= PAK_VERSION;
+	header.header_size		= sizeof(PakHeader);
+	header.page_size		= m_options.page_size;
+	header.entry_count		= static_cast<std::uint32_t>(m_entries.size());
+	header.directory_count	= static_cast<std::uint32_t>(directory_table.size());
+	header.bucket_bits		= bucket_bits;
+	header.index_offset		= m_offset;
+	header.index_size		= index_data.size();
+	header.index_crc		= crc32(index_data.data(),index_data.size());
+	header.header_crc		= crc32(&header,sizeof(header));
+
+	bool b_ok =		!write(index_data.data(),index_data.size())
+				&&	!std::fseek(m_p_file,0,SEEK_SET)
+				&&	(std::fwrite(&header,sizeof(header),1,m_p_file) == 1);
+
+	b_ok = !std::fclose(m_p_file) && b_ok;
+	m_p_file = nullptr;
+
+	if(!b_ok)
+	{
+		std::remove(m_filename.c_str());
+		return -1;
+	}
+
+	m_entries.clear();
+	m_entry_index.clear();
+
+	return 0;
+}
+
+int
+WriterADEPAK::write(const void * p_data,size_t size)
+{
+	if(size && (std::fwrite(p_data,1,size,m_p_file) != size))
+		return -1;
+
+	m_offset += size;
+	return 0;
+}
+
+int
+WriterADEPAK::pad(std::uint32_t alignment)
+{
+	static const char zeros[256] = {};
+
+	std::uint64_t padding = (alignment - (m_offset % alignment)) % alignment;
+
+	while(padding)
+	{
+		const size_t size = static_cast<size_t>(std::min<std::uint64_t>(padding,sizeof(zeros)));
+		if(write(zeros,size))
+			return -1;
+
+		padding -= size;
+	}
+
+	return 0;
+}
+
+int
+WriterADEPAK::compress(const char * p_data,size_t size,std::uint16_t method)
+{
+#ifdef HAVE_ZLIB
+	if((method == COMPRESSION_DEFLATE) && (size <= UINT_MAX))
+	{
+		z_stream stream;
+		std::memset(&stream,0,sizeof(stream));
+
+		if(deflateInit2(&stream,(m_options.level ? m_options.level : Z_DEFAULT_COMPRESSION),Z_DEFLATED,-MAX_WBITS,8,Z_DEFAULT_STRATEGY) != Z_OK)
+			return -1;
+
+		m_compressed.resize(deflateBound(&stream,static_cast<uLong>(size)));
+
+		stream.next_in		= reinterpret_cast<Bytef *>(const_cast<char *>(p_data));
+		stream.avail_in		= static_cast<uInt>(size);
+		stream.next_out		= reinterpret_cast<Bytef *>(m_compressed.data());
+		stream.avail_out	= static_cast<uInt>(m_compressed.size());
+
+		const int result = deflate(&stream,Z_FINISH);
+		m_compressed.resize(stream.total_out);
+		deflateEnd(&stream);
+
+		return (result == Z_STREAM_END ? 0 : -1);
+	}
+#endif
+
+#ifdef HAVE_ZSTD
+	if(method == COMPRESSION_ZSTD)
+	{
+		m_compressed.resize(ZSTD_compressBound(size));
+
+		const size_t result = ZSTD_compress(m_compressed.data(),m_compressed.size(),p_data,size,(m_options.level ? m_options.level : ZSTD_CLEVEL_DEFAULT));
+		if(ZSTD_isError(result))
+			return -1;
+
+		m_compressed.resize(result);
+		return 0;
+	}
+#endif
+
+	(void)p_data;
+	(void)size;
+	(void)method;
+
+	return -1;
+}
+
+void
+WriterADEPAK::abort()
+{
+	if(m_p_file)
+	{
+		std::fclose(m_p_file);
+		std::remove(m_filename.c_str());
+	}
+
+	m_p_file = nullptr;
+	m_entries.clear();
+	m_entry_index.clear();
+}
+
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - FACTORY CLASS
+//
+//
+//=============================================================================
+
+bool
+PackageFactoryADEPAK::is_supported(const std::string & path)
+{
+	auto pos = path.find_last_of(".");
+
+	if(pos == std::string::npos)
+		return false;
+
+	std::string ext(path.substr(pos+1));
+	std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+	return !!(ext == "adepak");
+}
+
+package_shared_ptr
+PackageFactoryADEPAK::create_package(const std::string & path)
+{
+	return std::make_shared<PackageADEPAK>(path);
+}
+
+}} // namespace package_adepak, adefs
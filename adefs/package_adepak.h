@@ -0,0 +1,321 @@
+//=============================================================================
+//	FILE:					package_adepak.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	ADEPAK, the native package format.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+//
+//	An ADEPAK file is laid out so that it can be mapped and used in place
+//	without building any tables when it is opened.
+//
+//		Header				One page. See PakHeader.
+//		Data				The file data. Stored files are used straight from
+//							the mapping; those of a page or more start on a
+//							page boundary and smaller ones never cross one.
+//							Compressed files are packed on 16 byte boundaries.
+//		Index
+//			Entries			PakEntry[entry_count] sorted by path hash.
+//			Buckets			uint32[bucket_count + 1]. Bucket 'b' holds the
+//							entries whose hashes have 'b' in their top
+//							bucket_bits bits. They are entries[buckets[b]]
+//							to entries[buckets[b+1]-1].
+//			Directories		PakDirectory[directory_count].
+//			Directory Files	uint32[entry_count]. The entries in each
+//							directory.
+//			Names			The paths of the files and directories.
+//
+//	Paths are stored case folded (lower case) with '/' separators and no
+//	leading '/'. The hash of a path is the 64 bit FNV-1a hash of its bytes.
+//	Values are written in native byte order and the tables are used in
+//	place, so a package is only readable on a little endian machine.
+//
+//=============================================================================
+#ifndef GUARD_ADEFS_PACKAGE_ADEPAK_H
+#define GUARD_ADEFS_PACKAGE_ADEPAK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include "adefs.h"
+#include "data_source.h"
+#include "decompressor.h"
+
+namespace adefs { namespace package_adepak
+{
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - STRUCTURES
+//
+//
+//=============================================================================
+#pragma pack(push,1)
+
+	//-----------------------------------------------------------------------------
+	//	ADEPAK file header.
+	//-----------------------------------------------------------------------------
+	struct PakHeader
+	{
+		char			magic[8];						//	"ADEPAK" followed by 0x1A and 0x00.
+		std::uint32_t	version;						//	PAK_VERSION.
+		std::uint32_t	header_size;					//	sizeof(PakHeader).
+		std::uint32_t	page_size;						//	The page size that stored files were aligned to.
+		std::uint32_t	entry_count;					//	The number of files.
+		std::uint32_t	directory_count;				//	The number of directories.
+		std::uint32_t	bucket_bits;					//	The index has (1 << bucket_bits) buckets.
+		std::uint64_t	index_offset;					//	The offset of the index.
+		std::uint64_t	index_size;						//	The size of the index.
+		std::uint32_t	index_crc;						//	CRC-32 of the index.
+		std::uint32_t	header_crc;						//	CRC-32 of the header with this field set to zero.
+	};
+
+	//-----------------------------------------------------------------------------
+	//	ADEPAK index entry.
+	//-----------------------------------------------------------------------------
+	struct PakEntry
+	{
+		std::uint64_t	hash;							//	The hash of the path.
+		std::uint64_t	offset;							//	The offset of the file's data.
+		std::uint64_t	size;							//	The size of the file.
+		std::uint64_t	stored_size;					//	The size of the file's data in the package.
+		std::uint32_t	name_offset;					//	The offset of the path in the names.
+		std::uint32_t	name_size;						//	The length of the path.
+		std::uint32_t	crc;							//	CRC-32 of the file.
+		std::uint16_t	compression;					//	COMPRESSION_STORE, COMPRESSION_DEFLATE or COMPRESSION_ZSTD.
+		std::uint16_t	flags;							//	Zero.
+	};
+
+	//-----------------------------------------------------------------------------
+	//	ADEPAK directory.
+	//-----------------------------------------------------------------------------
+	struct PakDirectory
+	{
+		std::uint32_t	name_offset;					//	The offset of the path in the names.
+		std::uint32_t	name_size;						//	The length of the path. Zero for the root.
+		std::uint32_t	first_file;						//	The first of the directory's files in the directory files.
+		std::uint32_t	file_count;						//	The number of files in the directory.
+	};
+
+#pragma pack(pop)
+
+	static const char			PAK_MAGIC[8]		= {'A','D','E','P','A','K',0x1A,0x00};
+	static const std::uint32_t	PAK_VERSION			= 1;
+	static const std::uint32_t	PAK_PAGE_SIZE		= 4096;		//	The default page size.
+	static const std::uint32_t	PAK_PACK_ALIGNMENT	= 16;		//	The alignment of files that are not page aligned.
+
+	//-----------------------------------------------------------------------------
+	//	Hash a path. The path is case folded as it is hashed. Pass the result of
+	//	the previous call as 'hash' to continue a hash.
+	//-----------------------------------------------------------------------------
+	std::uint64_t				hash_path(const char * p_path,size_t size,std::uint64_t hash = 0xCBF29CE484222325ull);
+
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - DIRECTORY CLASS
+//
+//	A directory only holds its path. Files are found by hashing the full
+//	path and looking it up in the package's index.
+//
+//=============================================================================
+class DirectoryADEPAK : public IDirectory
+{
+private:
+	class PackageADEPAK *			m_p_package;		// The package that owns this directory.
+	std::uint32_t					m_index;			// The index of the directory in the package.
+	std::string						m_prefix;			// The path of the directory followed by '/', or empty for the root.
+
+	DirectoryADEPAK(void);
+	DirectoryADEPAK(const DirectoryADEPAK & x);
+	DirectoryADEPAK & operator=(const DirectoryADEPAK & x);
+
+	std::int64_t					find(const std::string & filename) const;
+
+public:
+	DirectoryADEPAK(class PackageADEPAK * p_package,std::uint32_t index,const std::string & path);
+	~DirectoryADEPAK() = default;
+
+									// The path of the directory within the package.
+	std::string						get_path() const	{return m_prefix.substr(0,m_prefix.empty() ? 0 : m_prefix.size() - 1);}
+
+	//-------------------------------------------------------------------------
+	//	INTERFACE FUNCTIONS
+	//-------------------------------------------------------------------------
+	size_t							file_size(const std::string & filename);
+	Attributes						file_attr(const std::string & filename);
+	Attributes						dir_attr() {return ATTR_READ;}
+	bool							file_exists(const std::string & filename);
+	std::vector<std::string>		file_list();
+	std::unique_ptr<IFile>			openfile(	const std::string & filename,
+												std::uint32_t		mode = MODE_READ );
+};
+
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - PACKAGE CLASS
+//
+//	Opening a package maps the file and checks the header, so it takes the
+//	same time however many files the package holds. Where mapping is not
+//	available the index is read into memory instead.
+//
+//=============================================================================
+
+class PackageADEPAK : public IPackage
+{
+private:
+	std::string									m_filename;
+	std::mutex									m_mutex;			// Mutex for exclusive access.
+	data_source_shared_ptr						m_p_source;			// The package data.
+	bool										m_b_own_source;		// True if m_p_source is opened from m_filename.
+	std::vector<char>							m_index;			// A copy of the index if the source is not in memory.
+	PakHeader									m_header;
+	const char *								m_p_entries			= nullptr;
+	const char *								m_p_buckets			= nullptr;
+	const char *								m_p_directories		= nullptr;
+	const char *								m_p_directory_files	= nullptr;
+	const char *								m_p_names			= nullptr;
+	std::uint64_t								m_names_size		= 0;
+	std::vector<directory_shared_ptr>			m_directories;		// The mounted directories.
+
+	PackageADEPAK(void);
+	PackageADEPAK(const PackageADEPAK &);
+	PackageADEPAK & operator=(const PackageADEPAK &);
+
+public:
+	PackageADEPAK(const std::string & filename);
+
+									// Create a package that reads from a data source rather than a file.
+									// The name is only used in messages.
+	PackageADEPAK(data_source_shared_ptr p_source,const std::string & name);
+	~PackageADEPAK(void) = default;
+
+	const std::string &				get_filename() const				{return m_filename;}
+	std::uint32_t					get_entry_count() const				{return m_header.entry_count;}
+
+									// Find a file by its path. The path does not have to be case folded.
+									// Returns -1 if the file is not in the package.
+	std::int64_t					find(const std::string & path) const;
+	int								get_entry(std::uint32_t index,PakEntry & out_entry) const;
+	std::string						get_path(const PakEntry & entry) const;
+	std::unique_ptr<IFile>			openfile(std::uint32_t index,std::uint32_t mode = MODE_READ);
+
+									// Check the index and the CRC of every file. Returns -1 if anything is
+									// damaged.
+	int								verify();
+
+	//-------------------------------------------------------------------------
+	//	PACKAGE INTERFACE FUNCTIONS
+	//-------------------------------------------------------------------------
+	int								mount(MountPoint * p_mountpoint);
+	int								scan();
+	Attributes						attributes() const	{return ATTR_READ;}
+	int								for_each_entry(const package_entry_func & func);
+
+private:
+	friend class DirectoryADEPAK;
+
+	std::int64_t					find(const char * p_path,size_t size,std::uint64_t hash) const;
+	int								get_directory(std::uint32_t index,PakDirectory & out_directory) const;
+	std::uint32_t					get_directory_file(std::uint32_t index) const;
+	int								read_data(const PakEntry & entry,std::vector<char> & out_data);
+};
+
+//=============================================================================
+//
+//
+//	PACKAGE ADEPAK - WRITER CLASS
+//
+//	Builds an ADEPAK file. Files are compressed and written as they are added
+//	and the index is written by close(). Adding a path a second time replaces
+//	the earlier file.
+//
+//=============================================================================
+
+class WriterADEPAK
+{
+public:
+	struct Options
+	{
+		std::uint16_t				compression		= COMPRESSION_DEFLATE;	// Used for files that get smaller when compressed.
+		int							level			= 0;					// Compression level. Zero selects the default.
+		std::uint32_t				page_size		= PAK_PAGE_SIZE;		// The page size that stored files are aligned to.
+		size_t						min_compress	= 64;					// Smaller files are always stored.
+	};
+
+private:
+	struct Entry
+	{
+		std::string					path;
+		PakEntry					record;
+	};
+
+	std::FILE *						m_p_file		= nullptr;
+	std::string						m_filename;
+	Options							m_options;
+	std::uint64_t					m_offset		= 0;		// Where the next file will be written.
+	std::vector<Entry>				m_entries;
+	std::map<std::string,size_t>	m_entry_index;				// The index of each path in m_entries.
+	std::vector<char>				m_compressed;				// Scratch buffer for compressed data.
+
+	WriterADEPAK(const WriterADEPAK &) = delete;
+	WriterADEPAK & operator=(const WriterADEPAK &) = delete;
+
+public:
+	WriterADEPAK(void) = default;
+	~WriterADEPAK(void);
+
+									// True if the writer can compress with a method. Storing is always
+									// possible, DEFLATE needs zlib and zstd needs libzstd.
+	static bool						can_compress(std::uint16_t method);
+
+	int								open(const std::string & filename);
+	int								open(const std::string & filename,const Options & options);
+
+									// Add a file. Paths are case folded and any leading '/' is removed.
+	int								add(const std::string & path,const char * p_data,size_t size);
+	int								add(const std::string & path,IFile & file);
+
+									// Add every file in a package, with 'prefix' in front of their paths.
+	int								add_package(IPackage & package,const std::string & prefix = std::string());
+
+									// Write the index and close the file.
+	int								close();
+
+private:
+	int								write(const void * p_data,size_t size);
+	int								pad(std::uint32_t alignment);				// Write zeros up to the next multiple of 'alignment'.
+	int								compress(const char * p_data,size_t size,std::uint16_t method);
+	void							abort();
+};
+
+//=============================================================================
+//
+//
+//	PACKAGE FACTORY CLASS
+//
+//
+//=============================================================================
+
+class PackageFactoryADEPAK : public IPackageFactory
+{
+public:
+	std::string						name() const override			{return "ADEPAK";}
+	std::string						description() const	override	{return "Ade's Package";}
+	std::vector<std::string>		file_types() const override		{std::vector<std::string> v;v.push_back("adepak");return v;}
+
+	bool							is_supported(const std::string & path) override;
+	package_shared_ptr				create_package(const std::string & path) override;
+};
+
+}} // namespace package_adepak, adefs
+
+#endif // ! defined GUARD_ADEFS_PACKAGE_ADEPAK_H
@@ -245,7 +245,7 @@ DirectoryFS::openfile(	const std::string & filename,std::uint32_t mode)
 	std::unique_ptr<IFile> p_file;
 	try
 	{
-		std::unique_ptr<FileOnDisk> p_newfile(new FileOnDisk(m_path + filename,mode));
+		std::unique_ptr<FileOnDisk> p_newfile(new FileOnDisk(m_path + info.filename,mode));
 		if(!p_newfile->is_fail())
 			p_file = std::move(p_newfile);
 	}
@@ -430,6 +430,36 @@ PackageFS::mount(MountPoint * p_mountpoint)
 	return (int)err;
 }
 
+int
+PackageFS::for_each_entry(const package_entry_func & func)
+{
+	const size_t base_size = m_path.size();
+
+	for(auto & p_dir : m_directories)
+	{
+		DirectoryFS &		dir		= *static_cast<DirectoryFS *>(p_dir.get());
+		const std::string	path	= dir.get_path().substr(base_size);
+
+		for(auto & filename : dir.file_list())
+		{
+			auto p_file = dir.openfile(filename);
+			if(!p_file)
+				return -1;
+
+			PackageEntry entry;
+			entry.path			= (path.empty() || (path.back() == '/') ? path : path + "/") + filename;
+			entry.size			= p_file->size();
+			entry.stored_size	= entry.size;
+
+			const int result = func(entry,*p_file);
+			if(result)
+				return result;
+		}
+	}
+
+	return 0;
+}
+
 int								
 PackageFS::scan(const std::string & path)
 {
@@ -374,6 +374,7 @@ public:
 	int								mount(MountPoint * p_mountpoint);
 	int								scan()				{m_directories.clear();return scan(m_path);}
 	Attributes						attributes() const	{return m_attributes;}
+	int								for_each_entry(const package_entry_func & func);
 
 private:
 	int								scan(const std::string & path);
@@ -8,7 +8,11 @@
 //	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
 //	CREATED:			28-AUG-2013 Adrian Purser <ade@adrianpurser.co.uk>
 //=============================================================================
+#include <atomic>
+#include <cstring>
 #include "package_gcf.h"
+#include "checksum.h"
+#include "decompressor.h"
 
 namespace adefs { namespace package_gcf
 {
@@ -21,8 +25,25 @@ namespace adefs { namespace package_gcf
 //
 //=============================================================================
 
-DirectoryGCF::DirectoryGCF(PackageGCF * p_package)
+namespace
+{
+
+//-----------------------------------------------------------------------------
+//	Compare a name in the name pool with another name.
+//-----------------------------------------------------------------------------
+int
+compare_name(const char * p_name,size_t name_size,const char * p_other,size_t other_size)
+{
+	const int result = std::memcmp(p_name,p_other,std::min(name_size,other_size));
+	return (result ? result : (name_size < other_size ? -1 : (name_size > other_size ? 1 : 0)));
+}
+
+} // anonymous namespace
+
+DirectoryGCF::DirectoryGCF(PackageGCF * p_package,std::uint32_t first_file,std::uint32_t file_count)
 	: m_p_package(p_package)
+	, m_first_file(first_file)
+	, m_file_count(file_count)
 {
 	assert(m_p_package);
 }
@@ -39,8 +60,8 @@ DirectoryGCF::~DirectoryGCF()
 //
 //-----------------------------------------------------------------------------
 
-int	
-DirectoryGCF::get_fileinfo(const std::string & filename,FileInfo & out_fileinfo)
+std::int64_t
+DirectoryGCF::find(const std::string & filename) const
 {
 	//-------------------------------------------------------------------------
 	//	Create a lower-case version of the filename.
@@ -49,19 +70,42 @@ DirectoryGCF::get_fileinfo(const std::string & filename,FileInfo & out_fileinfo)
 	std::transform(filename.begin(),filename.end(),name.begin(),::tolower);
 	
 	//-------------------------------------------------------------------------
-	//	Search for the file in the file list. If the file is found then 
-	//	rescan the file to update the status.
+	//	The directory's files have consecutive ids in name order so search the
+	//	range of ids for the file.
 	//-------------------------------------------------------------------------
-	int result = FILE_NOT_FOUND;
+	std::uint32_t	low		= m_first_file;
+	std::uint32_t	high	= m_first_file + m_file_count;
+	std::uint32_t	size;
 
-	auto ifind = m_files.find(name);
-	if(ifind != m_files.end())
+	while(low < high)
 	{
-		out_fileinfo = ifind->second;
-		result = 0;
+		std::uint32_t	mid		= low + (high - low) / 2;
+		const char *	p_name	= m_p_package->get_file_name(mid,size);
+
+		if(compare_name(p_name,size,name.data(),name.size()) < 0)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
-	return result;
+	if(low == m_first_file + m_file_count)
+		return -1;
+
+	const char * p_name = m_p_package->get_file_name(low,size);
+
+	return compare_name(p_name,size,name.data(),name.size()) ? -1 : static_cast<std::int64_t>(low);
+}
+
+void
+DirectoryGCF::for_each_file(const std::function<void(const std::string & name,std::uint32_t id)> & func) const
+{
+	std::uint32_t size;
+
+	for(std::uint32_t id = m_first_file;id < m_first_file + m_file_count;++id)
+	{
+		const char * p_name = m_p_package->get_file_name(id,size);
+		func(std::string(p_name,size),id);
+	}
 }
 
 //-------------------------------------------------------------------------
@@ -72,15 +116,11 @@ DirectoryGCF::get_fileinfo(const std::string & filename,FileInfo & out_fileinfo)
 size_t							
 DirectoryGCF::file_size(const std::string & filename)
 {
-	FileInfo fileinfo;
-	size_t size = 0;
-	{
-		std::unique_lock<std::mutex> lock(m_mutex);
-		if(!get_fileinfo(filename,fileinfo))
-			size = fileinfo.size;
-	}
+	std::uint32_t	block_index;
+	std::uint32_t	size;
+	auto			file_id = find(filename);
 
-	return size;
+	return (file_id >= 0 && m_p_package->get_file_info(static_cast<std::uint32_t>(file_id),block_index,size) ? size : 0);
 }
 
 // Get the attributes of the specified file.
@@ -94,17 +134,7 @@ DirectoryGCF::file_attr(const std::string & filename)
 bool							
 DirectoryGCF::file_exists(const std::string & filename)
 {
-	//-------------------------------------------------------------------------
-	//	Create a lower-case version of the filename.
-	//-------------------------------------------------------------------------
-	std::string name(filename.size(),0);
-	std::transform(filename.begin(),filename.end(),name.begin(),::tolower);
-
-	//-------------------------------------------------------------------------
-	//	Test whether the file exists.
-	//-------------------------------------------------------------------------
-	std::unique_lock<std::mutex> lock(m_mutex);
-	return !!m_files.count(name);
+	return find(filename) >= 0;
 }
 
 std::vector<std::string>		
@@ -112,8 +142,8 @@ DirectoryGCF::file_list()
 {
 	std::vector<std::string> files;
 
-	for(auto & info_pair : m_files)
-		files.push_back(info_pair.first);
+	files.reserve(m_file_count);
+	for_each_file([&](const std::string & name,std::uint32_t) {files.push_back(name);});
 
 	return files;
 }
@@ -130,47 +160,24 @@ DirectoryGCF::openfile(	const std::string & filename,
 		return nullptr;
 
 	//-------------------------------------------------------------------------
-	//	Get the files info.
+	//	Find the file.
 	//-------------------------------------------------------------------------
-	FileInfo info;
-
-	{
-		std::unique_lock<std::mutex> lock(m_mutex);
-		if(get_fileinfo(filename,info))
-			return nullptr;
-	}
+	auto file_id = find(filename);
+	if(file_id < 0)
+		return nullptr;
 
 	//-------------------------------------------------------------------------
 	//	Create the file object.
 	//-------------------------------------------------------------------------
 	std::unique_ptr<IFile> p_file;
 
-	std::unique_ptr<FileGCF> p_new_file(new FileGCF(info.file_id,mode,m_p_package));
+	std::unique_ptr<FileGCF> p_new_file(new FileGCF(static_cast<std::uint32_t>(file_id),mode,m_p_package));
 	if(!p_new_file->is_fail())
 		p_file = std::move(p_new_file);
 
 	return p_file;
 }
 
-void							
-DirectoryGCF::add_file(	const std::string & filename,
-						std::uint32_t		index,
-						std::uint32_t		size,
-						std::uint32_t		id)
-{
-	FileInfo	info;
-
-	info.filename		= filename;
-	info.index			= index;
-	info.size			= size;
-	info.file_id		= id;
-
-	std::string namelower(filename);
-	std::transform(namelower.begin(),namelower.end(),namelower.begin(),::tolower);
-
-	m_files[namelower] = info;
-}
-
 //=============================================================================
 //
 //
@@ -181,6 +188,12 @@ DirectoryGCF::add_file(	const std::string & filename,
 
 PackageGCF::PackageGCF(	const std::string & filename )
 	: m_filename(filename)
+	, m_b_own_source(true)
+	, m_block_cache_owner(BlockCache::new_owner())
+	, m_prefetch_blocks(GCF_DEFAULT_PREFETCH_BLOCKS)
+	, m_checksum_map_offset(0)
+	, m_b_verify_reads(false)
+	, m_checksum_status(CHECKSUMS_UNLOADED)
 {
 	//-------------------------------------------------------------------------
 	// Fix the path.
@@ -188,91 +201,152 @@ PackageGCF::PackageGCF(	const std::string & filename )
 	std::replace(m_filename.begin(),m_filename.end(),'\\','/');
 }
 
+PackageGCF::PackageGCF(data_source_shared_ptr p_source,const std::string & name)
+	: m_filename(name)
+	, m_p_source(std::move(p_source))
+	, m_b_own_source(false)
+	, m_block_cache_owner(BlockCache::new_owner())
+	, m_prefetch_blocks(GCF_DEFAULT_PREFETCH_BLOCKS)
+	, m_checksum_map_offset(0)
+	, m_b_verify_reads(false)
+	, m_checksum_status(CHECKSUMS_UNLOADED)
+{
+}
+
+data_source_shared_ptr
+PackageGCF::get_source()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//-------------------------------------------------------------------------
+	//	The package file is opened the first time it is needed and then kept
+	//	open for the life of the package.
+	//-------------------------------------------------------------------------
+	if(!m_p_source && m_b_own_source)
+	{
+		auto p_source = std::make_shared<DataSourceFile>();
+		if(p_source->open(m_filename))
+			return nullptr;
+
+		m_p_source = std::move(p_source);
+	}
+
+	return m_p_source;
+}
+
 PackageGCF::~PackageGCF(void)
 {
+	if(m_p_block_cache)
+		m_p_block_cache->erase_owner(m_block_cache_owner);
 }
 
-int
-PackageGCF::mount(MountPoint * p_mountpoint)
+void
+PackageGCF::set_block_cache(block_cache_shared_ptr p_cache)
 {
-	if(!p_mountpoint)
-		return -1;
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if(m_p_block_cache && (m_p_block_cache != p_cache))
+		m_p_block_cache->erase_owner(m_block_cache_owner);
 
-	return mount_directory(p_mountpoint,"",m_root_directory);
+	m_p_block_cache = std::move(p_cache);
 }
 
-int
-PackageGCF::mount_directory(MountPoint *			p_mountpoint,
-							const std::string &		path,
-							DirectoryNode &			dir_node )
+block_cache_shared_ptr
+PackageGCF::get_block_cache()
 {
-	//-------------------------------------------------------------------------
-	//	Mount the directory.
-	//-------------------------------------------------------------------------
-	if(!dir_node.p_directory)
-		return 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_p_block_cache;
+}
 
-	if(p_mountpoint->mount(path,dir_node.p_directory))
+int
+PackageGCF::mount(MountPoint * p_mountpoint)
+{
+	if(!p_mountpoint)
 		return -1;
 
 	//-------------------------------------------------------------------------
-	//	Fix the path.
-	//-------------------------------------------------------------------------
-	std::string basepath(path);
-	if(!basepath.empty())
-		basepath.push_back('/');
-
-	//-------------------------------------------------------------------------
-	//	Mount the sub-directories.
+	//	Parents come before their children so each directory is mounted after
+	//	the directory that holds it.
 	//-------------------------------------------------------------------------
-	bool err = false;
+	const auto paths = directory_paths();
 
-	for(auto & dir_pair : dir_node.sub_directories)
+	for(size_t index = 0;index < m_directories.size();++index)
 	{
-		if(mount_directory(p_mountpoint,basepath+dir_pair.first,dir_pair.second))
-		{
-			err = true;
-			break;
-		}
+		if(		m_directories[index].p_directory
+			&&	p_mountpoint->mount(paths[index],m_directories[index].p_directory) )
+			return -1;
 	}
 
-	return (int)err;
+	return 0;
 }
 
 int
 PackageGCF::scan()
 {
-	std::ifstream	gcf_file;
+	//-------------------------------------------------------------------------
+	//	If the index cache has an up to date copy of the directory then there
+	//	is no need to read the package file at all.
+	//-------------------------------------------------------------------------
+	IndexCache::Key	index_key;
+	const bool		b_use_index = (m_p_index_cache && m_b_own_source && !IndexCache::make_key(m_filename,index_key));
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_extents.clear();
+
+		if(m_p_block_cache)
+			m_p_block_cache->erase_owner(m_block_cache_owner);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_checksum_mutex);
+		m_checksum_map_offset	= 0;
+		m_checksum_status		= CHECKSUMS_UNLOADED;
+		m_checksum_map.clear();
+		m_checksums.clear();
+		m_chunk_state.clear();
+	}
+
+	if(b_use_index && !load_index(index_key))
+		return 0;
 
 	//-------------------------------------------------------------------------
-	//	Open the package file.
+	//	Open the package file. It is reopened in case it has changed since it
+	//	was last scanned.
 	//-------------------------------------------------------------------------
-	gcf_file.open(m_filename.c_str(),std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
-	if(gcf_file.fail())
+	if(m_b_own_source)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_p_source.reset();
+	}
+
+	auto p_source = get_source();
+	if(!p_source)
 	{
 		//std::clog << "PACKAGEGCF: Package file '" << m_filename << "' not found!\n";
 		return 0;
 	}
 
+	auto read = [&](std::uint64_t offset,void * p_buffer,size_t size) -> bool
+	{
+		return (p_source->read_at(offset,p_buffer,size) == size);
+	};
+
 	//-------------------------------------------------------------------------
 	//	Get the length of the file. Make sure that it's at least as big as the 
 	//	file header.
 	//-------------------------------------------------------------------------
-	gcf_file.seekg(0, std::ios::end);
-	size_t filesize = (size_t)gcf_file.tellg();
+	const std::uint64_t filesize = p_source->size();
 	if(filesize < sizeof(GCFHeader))
 	{
 		//std::clog << "PACKAGEGCF: Package file '" << m_filename << "' is too small!\n";
 		return 0;
 	}
-	gcf_file.seekg(0, std::ios::beg);
 
 	//-------------------------------------------------------------------------
 	//	Read and validate the file header.
 	//-------------------------------------------------------------------------
-	
-	gcf_file.read((char *)&m_gcf_header,sizeof(GCFHeader));
-	if(m_gcf_header.FileSize != filesize)
+	if(!read(0,&m_gcf_header,sizeof(GCFHeader)) || (m_gcf_header.FileSize != filesize))
 	{
 		//std::clog << "PACKAGEGCF: Header Filesize for GCF file '" << m_filename << "' is incorrect!\n";
 		return 0;
@@ -282,25 +356,29 @@ PackageGCF::scan()
 	//	Read the block entry header.
 	//-------------------------------------------------------------------------
 	GCFBlockEntryHeader block_entry_header;
-	gcf_file.read((char *)&block_entry_header,sizeof(GCFBlockEntryHeader));
+	std::uint64_t		pos = sizeof(GCFHeader);
 
-	size_t pos = (size_t)gcf_file.tellg();
-	gcf_file.seekg(pos+(sizeof(GCFBlockEntry)*block_entry_header.BlockCount), std::ios::beg);
-
-	if(gcf_file.fail())
+	if(!read(pos,&block_entry_header,sizeof(GCFBlockEntryHeader)))
 		return 0;
 
+	pos += sizeof(GCFBlockEntryHeader) + (sizeof(GCFBlockEntry) * static_cast<std::uint64_t>(block_entry_header.BlockCount));
+
 	//-------------------------------------------------------------------------
 	//	Read the Frag Map 
 	//-------------------------------------------------------------------------
 	GCFFragMapHeader frag_map_header;
-	gcf_file.read((char *)&frag_map_header,sizeof(GCFFragMapHeader));
 
-	pos = (size_t)gcf_file.tellg();
+	if(!read(pos,&frag_map_header,sizeof(GCFFragMapHeader)))
+		return 0;
+
+	pos += sizeof(GCFFragMapHeader);
 	m_fragmap_file_offset	= (std::uint32_t)pos;
 	m_frag_map.resize(frag_map_header.BlockCount);
 
-	gcf_file.read((char *)&m_frag_map[0],sizeof(std::uint32_t)*frag_map_header.BlockCount);
+	if(!read(pos,m_frag_map.data(),sizeof(std::uint32_t)*m_frag_map.size()))
+		return 0;
+
+	pos += sizeof(std::uint32_t) * m_frag_map.size();
 
 	//-------------------------------------------------------------------------
 	//	Read the Block Entry Map Header
@@ -308,38 +386,35 @@ PackageGCF::scan()
 	if(m_gcf_header.FormatVersion <= 5)
 	{
 		GCFBlockEntryMapHeader block_entry_map_header;
-		gcf_file.read((char *)&block_entry_map_header,sizeof(GCFBlockEntryMapHeader));
-	
-		pos = (size_t)gcf_file.tellg();
-		gcf_file.seekg(pos+(std::int32_t)(sizeof(GCFBlockEntryMap)*block_entry_map_header.BlockCount), std::ios::beg);
 
-		if(gcf_file.fail())
+		if(!read(pos,&block_entry_map_header,sizeof(GCFBlockEntryMapHeader)))
 			return 0;
+	
+		pos += sizeof(GCFBlockEntryMapHeader) + (sizeof(GCFBlockEntryMap) * static_cast<std::uint64_t>(block_entry_map_header.BlockCount));
 	}
 
 	//-------------------------------------------------------------------------
 	//	Read the Directory Header
 	//-------------------------------------------------------------------------
 	GCFDirectoryHeader	dir_header;
-	size_t				dirpos = (size_t)gcf_file.tellg();
+	const std::uint64_t	dirpos = pos;
 
-	gcf_file.read((char *)&dir_header,sizeof(GCFDirectoryHeader));
+	if(		!read(dirpos,&dir_header,sizeof(GCFDirectoryHeader))
+		||	!dir_header.ItemCount
+		||	(dir_header.DirectorySize < sizeof(GCFDirectoryHeader) + (sizeof(GCFDirectoryEntry) * static_cast<std::uint64_t>(dir_header.ItemCount))) )
+		return 0;
 	
 	//-------------------------------------------------------------------------
 	//	Read the directory info.
 	//-------------------------------------------------------------------------
-	gcf_file.seekg(dirpos+dir_header.DirectorySize,std::ios::beg);
-	GCFDirectoryMapHeader dir_map_header;
-	gcf_file.read((char *)&dir_map_header,sizeof(GCFDirectoryMapHeader));
-
 	DirectoryInfo	dirinfo;
 
 	dirinfo.dir_map.resize(dir_header.ItemCount);
 	dirinfo.raw_dir_block.resize(dir_header.DirectorySize);
 
-	gcf_file.read((char *)&dirinfo.dir_map[0],dir_header.ItemCount*sizeof(std::uint32_t));
-	gcf_file.seekg(dirpos,std::ios::beg);
-	gcf_file.read(&dirinfo.raw_dir_block[0],dir_header.DirectorySize);
+	if(		!read(dirpos + dir_header.DirectorySize + sizeof(GCFDirectoryMapHeader),dirinfo.dir_map.data(),dir_header.ItemCount*sizeof(std::uint32_t))
+		||	!read(dirpos,dirinfo.raw_dir_block.data(),dir_header.DirectorySize) )
+		return 0;
 
 	dirinfo.p_header			=	(GCFDirectoryHeader *)&dirinfo.raw_dir_block[0];
 	dirinfo.p_entries			=	(GCFDirectoryEntry *)&dirinfo.p_header[1];
@@ -352,30 +427,34 @@ PackageGCF::scan()
 	//	Find the data blocks.
 	//-------------------------------------------------------------------------
 	GCFChecksumHeader		chksum_header;
-	GCFChecksumMapHeader	chksum_map_header;
-	size_t					chksum_pos = dirpos + (dir_header.DirectorySize+sizeof(GCFDirectoryMapHeader)+(dir_header.ItemCount*sizeof(std::uint32_t)));	// Offset of the checksum data.
+	const std::uint64_t		chksum_pos = dirpos + (dir_header.DirectorySize+sizeof(GCFDirectoryMapHeader)+(dir_header.ItemCount*sizeof(std::uint32_t)));	// Offset of the checksum data.
+
+	if(!read(chksum_pos,&chksum_header,sizeof(GCFChecksumHeader)))
+		return 0;
 
-	gcf_file.seekg(chksum_pos,std::ios::beg);
-	gcf_file.read((char *)&chksum_header,sizeof(GCFChecksumHeader));
-	gcf_file.read((char *)&chksum_map_header,sizeof(GCFChecksumMapHeader));
+	const std::uint64_t data_pos = chksum_pos+(chksum_header.ChecksumSize + sizeof(GCFChecksumHeader));
 
-	size_t data_pos = chksum_pos+(chksum_header.ChecksumSize + sizeof(GCFChecksumHeader));
+	//-------------------------------------------------------------------------
+	//	Note where the checksums are. They are only read and checked if they 
+	//	are needed.
+	//-------------------------------------------------------------------------
+	if(chksum_header.ChecksumSize)
+		m_checksum_map_offset = chksum_pos + sizeof(GCFChecksumHeader);
 
 	//-------------------------------------------------------------------------
 	//	Read the data block header.
 	//-------------------------------------------------------------------------
-	gcf_file.seekg(data_pos,std::ios::beg);
-	gcf_file.read((char *)&m_gcf_data_block_header,sizeof(GCFDataBlockHeader));
+	if(!read(data_pos,&m_gcf_data_block_header,sizeof(GCFDataBlockHeader)))
+		return 0;
 
 	//-------------------------------------------------------------------------
 	//	Scan the directory info and add the files to the package directory.
 	//-------------------------------------------------------------------------
-	std::uint32_t entry_index = 0;
-
-	if(!dirinfo.p_entries->DirectoryType)
-		entry_index = dirinfo.p_entries->FirstIndex;
+	if(scan_directory(dirinfo))
+		return -1;
 
-	scan_directory(dirinfo,entry_index,m_root_directory);
+	if(b_use_index)
+		store_index(index_key);
 
 	//-------------------------------------------------------------------------
 	//	Diagnostic Messages.
@@ -388,214 +467,1044 @@ PackageGCF::scan()
 }
 
 std::uint32_t					
-PackageGCF::add_file(std::uint32_t size,std::uint32_t block_index)
+PackageGCF::add_file(const FileName & name,std::uint32_t size,std::uint32_t block_index,std::uint32_t checksum_index)
 {
-	std::uint32_t	id = static_cast<std::uint32_t>(m_file_info.size());
+	std::uint32_t	id = static_cast<std::uint32_t>(m_file_sizes.size());
 
-	FileInfo info;
-	info.file_size			= size;
-	info.data_block_index	= block_index;
-	m_file_info.push_back(info);
+	m_file_names.push_back(name);
+	m_file_sizes.push_back(size);
+	m_file_blocks.push_back(block_index);
+	m_file_checksums.push_back(checksum_index);
 
 	return id;
 }
 
-void
-PackageGCF::scan_directory(	DirectoryInfo &			dirinfo,
-							std::uint32_t			entry_index,
-							DirectoryNode &			dir_node )
+//-----------------------------------------------------------------------------
+//	Build the directories from the GCF's directory entries. The tree is walked
+//	with an explicit stack so that each entry is visited once, however deep
+//	the tree is, and entries that are out of range or visited a second time
+//	(a damaged GCF can link the entries into a loop) are ignored.
+//-----------------------------------------------------------------------------
+int
+PackageGCF::scan_directory(DirectoryInfo & dirinfo)
 {
-	auto p_dir = std::make_shared<DirectoryGCF>(this);
-	bool err = false;
+	struct PendingFile
+	{
+		FileName		name;
+		std::uint32_t	size;
+		std::uint32_t	block_index;
+		std::uint32_t	checksum_index;
+	};
 
-	dir_node.p_directory.reset();
-	dir_node.sub_directories.clear();
+	const std::uint32_t item_count	= dirinfo.p_header->ItemCount;
+	const std::uint64_t names_end	= sizeof(GCFDirectoryHeader) + (sizeof(GCFDirectoryEntry) * static_cast<std::uint64_t>(item_count)) + dirinfo.p_header->NameSize;
 
-	while(entry_index) 
-	{
-		GCFDirectoryEntry & entry = dirinfo.p_entries[entry_index];
+	if(names_end > dirinfo.raw_dir_block.size())
+		return -1;
 
-		std::string filename(dirinfo.p_names+entry.NameOffset);
-	
-		if(entry.DirectoryType)
-		{
-			const std::uint32_t block_index = dirinfo.dir_map.at(entry_index);
-			auto id = add_file(entry.ItemSize,block_index);
-			p_dir->add_file(filename,block_index,entry.ItemSize,id);
-		}
-		else
-		{
-			DirectoryNode sub_dir;
-			
-			std::transform(filename.begin(),filename.end(),filename.begin(),::tolower);
+	//-------------------------------------------------------------------------
+	//	Keep a lower case copy of the names. The files and directories refer 
+	//	to their names by their offset in it.
+	//-------------------------------------------------------------------------
+	m_names.assign(dirinfo.p_names,dirinfo.p_names + dirinfo.p_header->NameSize);
+	std::transform(m_names.begin(),m_names.end(),m_names.begin(),::tolower);
 
-			scan_directory(dirinfo,entry.FirstIndex,sub_dir);
-			dir_node.sub_directories[filename] = sub_dir;
-		}
+	m_directories.clear();
 
-		entry_index = entry.NextIndex;
-	}
+	std::vector<PendingFile>			files;
+	std::vector<char>					visited(item_count,0);
+	std::vector<std::pair<std::uint32_t,std::uint32_t>>	stack;				//	The first entry of a directory and the index of the directory.
 
-	if(!err)
-		dir_node.p_directory = p_dir;
-}
+	files.reserve(dirinfo.p_header->FileCount);
 
-bool							
-PackageGCF::get_file_info(	std::uint32_t		file_id,
-							std::uint32_t &		out_block_index,
-							std::uint32_t &		out_file_size )
-{
-	if(file_id >= m_file_info.size())
-		return false;
+	DirectoryNode root = {nullptr,0,0,0,0,0};
+	m_directories.push_back(root);
 
-	auto & info = m_file_info[file_id];
+	visited[0] = 1;
+	if(!dirinfo.p_entries->DirectoryType)
+		stack.emplace_back(dirinfo.p_entries->FirstIndex,0);
 
-	out_block_index	= info.data_block_index;
-	out_file_size	= info.file_size;
+	//-------------------------------------------------------------------------
+	//	Each directory's files are collected together when the directory is
+	//	taken from the stack, so each directory has one range of files.
+	//-------------------------------------------------------------------------
+	while(!stack.empty())
+	{
+		const std::uint32_t dir_index	= stack.back().second;
+		std::uint32_t		entry_index	= stack.back().first;
 
-	return true;
-}
+		stack.pop_back();
 
-std::uint32_t
-PackageGCF::get_block_index(std::uint32_t first_block,fileoffset offset)
-{
-	std::uint32_t block_offset = offset/m_gcf_header.BlockSize;
+		m_directories[dir_index].first_file = static_cast<std::uint32_t>(files.size());
 
-	while(block_offset--)
-		first_block = m_frag_map[first_block];
+		while(entry_index && (entry_index < item_count) && !visited[entry_index])
+		{
+			const GCFDirectoryEntry & entry = dirinfo.p_entries[entry_index];
 
-	return first_block;
-}
+			visited[entry_index] = 1;
+			entry_index = entry.NextIndex;
 
-//=============================================================================
-//
-//
-//	PACKAGE GCF - FILE CLASS
-//
-//
-//=============================================================================
+			if(entry.NameOffset >= m_names.size())
+				continue;
 
-FileGCF::FileGCF(	std::uint32_t	id,
-					std::uint32_t	mode,
-					PackageGCF *	p_package )
-	: m_mode(mode)
-	, m_p_package(p_package)
-	, m_id(id)
-	, m_first_data_block_offset(0)
-	, m_file_pointer(0)
-	, m_block_num(0)
-	, m_block_offset(0)
-	, m_block_data_avail(0)
-	, m_gcount(0)
-	, m_b_failbit(false)
-	, m_block_size(0)
-{
-	assert(m_p_package);
-	if(m_p_package->get_file_info(m_id,m_block_index,m_size))
-	{	
-		m_file_pointer	= (mode & MODE_AT_END ? m_size : 0);
-		m_block_size	= m_p_package->get_blocksize();
+			const std::uint32_t name_size = static_cast<std::uint32_t>(strnlen(m_names.data() + entry.NameOffset,m_names.size() - entry.NameOffset));
 
-		//---------------------------------------------------------------------
-		//	Open the GCF package file. 
-		//---------------------------------------------------------------------
-		std::string package_name(m_p_package->get_filename());
-		m_stream.open(package_name.c_str(),std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
-		if(m_stream.fail())
-		{
-			//std::clog << "PACKAGEGCF:FILEGCF: Package file '" << package_name << "' not found!\n";
-			m_b_failbit = true;
+			if(entry.DirectoryType)
+			{
+				PendingFile file = {{entry.NameOffset,name_size},entry.ItemSize,dirinfo.dir_map[&entry - dirinfo.p_entries],entry.ChecksumIndex};
+				files.push_back(file);
+			}
+			else
+			{
+				DirectoryNode node = {nullptr,dir_index,entry.NameOffset,name_size,0,0};
+
+				stack.emplace_back(entry.FirstIndex,static_cast<std::uint32_t>(m_directories.size()));
+				m_directories.push_back(node);
+			}
 		}
-		else
+
+		m_directories[dir_index].file_count = static_cast<std::uint32_t>(files.size()) - m_directories[dir_index].first_file;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Number the files of each directory in name order. If a name appears 
+	//	more than once in a directory then the last one is kept.
+	//-------------------------------------------------------------------------
+	auto less = [this](const PendingFile & a,const PendingFile & b)
+	{
+		return compare_name(get_name(a.name.offset),a.name.size,get_name(b.name.offset),b.name.size) < 0;
+	};
+
+	m_file_names.clear();
+	m_file_sizes.clear();
+	m_file_blocks.clear();
+	m_file_checksums.clear();
+	m_file_names.reserve(files.size());
+	m_file_sizes.reserve(files.size());
+	m_file_blocks.reserve(files.size());
+	m_file_checksums.reserve(files.size());
+
+	for(auto & node : m_directories)
+	{
+		auto ibegin	= files.begin() + node.first_file;
+		auto iend	= ibegin + node.file_count;
+
+		std::stable_sort(ibegin,iend,less);
+
+		node.first_file = static_cast<std::uint32_t>(m_file_sizes.size());
+
+		for(auto ifile = ibegin;ifile != iend;++ifile)
 		{
-			//-----------------------------------------------------------------
-			//	Read the Block Entry
-			//-----------------------------------------------------------------
-			GCFBlockEntry block_entry;
-			m_stream.seekg(sizeof(GCFHeader)+sizeof(GCFBlockEntryHeader)+(sizeof(GCFBlockEntry)*m_block_index), std::ios::beg);
-			m_stream.read((char *)&block_entry,sizeof(GCFBlockEntry));
-			m_first_data_block_index	= block_entry.FirstDataBlockIndex;
-			m_first_data_block_offset	= m_p_package->get_first_block_offset();
-			update_block_info();
+			if((ifile + 1 == iend) || less(*ifile,*(ifile + 1)))
+				add_file(ifile->name,ifile->size,ifile->block_index,ifile->checksum_index);
 		}
+
+		node.file_count = static_cast<std::uint32_t>(m_file_sizes.size()) - node.first_file;
+		node.p_directory = std::make_shared<DirectoryGCF>(this,node.first_file,node.file_count);
 	}
-	else
-		m_b_failbit = true;
-}
 
-FileGCF::~FileGCF(void)
-{
+	return 0;
 }
 
 int
-FileGCF::get()
+PackageGCF::load_index(const IndexCache::Key & key)
 {
-	if(is_eof())
-		return EOF;
+	GCFHeader					gcf_header;
+	GCFDataBlockHeader			data_block_header;
+	std::uint32_t				fragmap_file_offset;
+	std::uint64_t				checksum_map_offset;
+	std::vector<std::uint32_t>	frag_map;
+	std::vector<FileName>		file_names;
+	std::vector<std::uint32_t>	file_sizes;
+	std::vector<std::uint32_t>	file_blocks;
+	std::vector<std::uint32_t>	file_checksums;
+	std::vector<char>			names;
+	std::vector<DirectoryNode>	directories;
+
+	auto parse = [&](IndexReader & reader) -> int
+	{
+		std::uint32_t count = 0;
+
+		if(		!reader.read(gcf_header)
+			||	!reader.read(data_block_header)
+			||	!reader.read(fragmap_file_offset)
+			||	!reader.read(checksum_map_offset)
+			||	!reader.read_array(frag_map)
+			||	!reader.read_array(file_names)
+			||	!reader.read_array(file_sizes)
+			||	!reader.read_array(file_blocks)
+			||	!reader.read_array(file_checksums)
+			||	!reader.read_array(names)
+			||	!reader.read(count)
+			||	!count
+			||	(count > reader.remaining() / (sizeof(std::uint32_t) * 5))
+			||	(file_names.size() != file_sizes.size())
+			||	(file_blocks.size() != file_sizes.size())
+			||	(file_checksums.size() != file_sizes.size()) )
+			return -1;
+
+		for(auto & name : file_names)
+		{
+			if(static_cast<std::uint64_t>(name.offset) + name.size > names.size())
+				return -1;
+		}
 
-	const fileoffset fileofs	= m_first_data_block_offset + (m_block_num * m_block_size) + m_block_offset;	// The offset of the data in the package file.
+		directories.resize(count);
 
-	m_stream.seekg(fileofs,std::ios::beg);
+		for(std::uint32_t index = 0;index < count;++index)
+		{
+			DirectoryNode & node = directories[index];
+
+			if(		!reader.read(node.parent)
+				||	!reader.read(node.name_offset)
+				||	!reader.read(node.name_size)
+				||	!reader.read(node.first_file)
+				||	!reader.read(node.file_count)
+				||	(index ? (node.parent >= index) : (node.parent != 0))
+				||	(static_cast<std::uint64_t>(node.name_offset) + node.name_size > names.size())
+				||	(static_cast<std::uint64_t>(node.first_file) + node.file_count > file_sizes.size()) )
+				return -1;
+		}
 
-	++m_file_pointer;
-	
-	if(m_block_data_avail > 1)
-	{
-		--m_block_data_avail;
-		++m_block_offset;
-	}
-	else
+		return (reader.is_end() ? 0 : -1);
+	};
+
+	if(m_p_index_cache->load(key,"GCF",INDEX_VERSION,parse))
+		return -1;
+
+	m_gcf_header			= gcf_header;
+	m_gcf_data_block_header	= data_block_header;
+	m_fragmap_file_offset	= fragmap_file_offset;
+	m_checksum_map_offset	= checksum_map_offset;
+	m_frag_map.swap(frag_map);
+	m_file_names.swap(file_names);
+	m_file_sizes.swap(file_sizes);
+	m_file_blocks.swap(file_blocks);
+	m_file_checksums.swap(file_checksums);
+	m_names.swap(names);
+	m_directories.swap(directories);
+
+	for(auto & node : m_directories)
+		node.p_directory = std::make_shared<DirectoryGCF>(this,node.first_file,node.file_count);
+
+	return 0;
+}
+
+void
+PackageGCF::store_index(const IndexCache::Key & key)
+{
+	IndexWriter writer;
+
+	writer.write(m_gcf_header);
+	writer.write(m_gcf_data_block_header);
+	writer.write(m_fragmap_file_offset);
+	writer.write(m_checksum_map_offset);
+	writer.write_array(m_frag_map);
+	writer.write_array(m_file_names);
+	writer.write_array(m_file_sizes);
+	writer.write_array(m_file_blocks);
+	writer.write_array(m_file_checksums);
+	writer.write_array(m_names);
+	writer.write(static_cast<std::uint32_t>(m_directories.size()));
+
+	for(auto & node : m_directories)
 	{
-		m_block_num			= m_p_package->get_next_block(m_block_num);
-		m_block_data_avail	= (m_block_num >= m_p_package->get_blockcount() ? 0 : m_block_size);
-		m_block_offset		= 0;
+		writer.write(node.parent);
+		writer.write(node.name_offset);
+		writer.write(node.name_size);
+		writer.write(node.first_file);
+		writer.write(node.file_count);
 	}
 
-	return m_stream.get();
+	m_p_index_cache->store(key,"GCF",INDEX_VERSION,writer);
 }
 
-size_t
-FileGCF::read(char * p_buffer,size_t size)
+int
+PackageGCF::for_each_entry(const package_entry_func & func)
 {
-	if(is_eof() || is_fail())
-		return 0;
+	auto p_source = get_source();
+	if(!p_source)
+		return -1;
 
-	size_t				totalread = 0;
-	const std::uint32_t	available = m_size - m_file_pointer;
+	std::vector<std::string>	paths;
+	std::vector<std::uint32_t>	ids;
 
-	if(size > available)
-		size = available;
+	list_files(paths);
 
-	while(size)
+	for(std::uint32_t id = 0;id < paths.size();++id)
+		if(!paths[id].empty())
+			ids.push_back(id);
+
+	//-------------------------------------------------------------------------
+	//	Everything is read through a read ahead buffer so that the package is
+	//	read in large sequential blocks. Packages in memory are used directly.
+	//-------------------------------------------------------------------------
+	data_source_shared_ptr p_read = p_source;
+	if(!p_source->data())
+		p_read = std::make_shared<DataSourceReadAhead>(p_source);
+
+	//-------------------------------------------------------------------------
+	//	Find the first data block of each file. The block entries are read in
+	//	order so they come from the read ahead buffer. Files with no data go 
+	//	at the end.
+	//-------------------------------------------------------------------------
+	std::vector<std::uint32_t> first_blocks(m_file_sizes.size(),UINT32_MAX);
+
+	std::sort(ids.begin(),ids.end(),[&](std::uint32_t a,std::uint32_t b) {return m_file_blocks[a] < m_file_blocks[b];});
+
+	for(auto id : ids)
 	{
-		size_t				readsize	= std::min(m_block_data_avail,size);											// The amount of data to read from the block.
-		const fileoffset	fileofs		= m_first_data_block_offset + (m_block_num * m_block_size) + m_block_offset;	// The offset of the data in the package file.
+		GCFBlockEntry		block_entry;
+		const std::uint64_t	entry_offset = sizeof(GCFHeader)+sizeof(GCFBlockEntryHeader)+(sizeof(GCFBlockEntry)*static_cast<std::uint64_t>(m_file_blocks[id]));
 
-		if(!readsize)
-			break;
+		if(		(m_file_blocks[id] < m_gcf_header.BlockCount)
+			&&	(p_read->read_at(entry_offset,&block_entry,sizeof(GCFBlockEntry)) == sizeof(GCFBlockEntry)) )
+			first_blocks[id] = block_entry.FirstDataBlockIndex;
+	}
 
-		m_stream.seekg(fileofs,std::ios::beg);
-		readsize = (size_t)m_stream.read(p_buffer,readsize).gcount();
+	std::stable_sort(ids.begin(),ids.end(),[&](std::uint32_t a,std::uint32_t b) {return first_blocks[a] < first_blocks[b];});
 
-		p_buffer			+= readsize;
-		totalread			+= readsize;
+	//-------------------------------------------------------------------------
+	//	Visit the files.
+	//-------------------------------------------------------------------------
+	int result = 0;
+
+	for(auto id : ids)
+	{
+		FileGCF file(id,MODE_READ,this,p_read);
+		if(file.is_fail())
+		{
+			result = -1;
+			continue;
+		}
+
+		PackageEntry entry;
+		entry.path			= std::move(paths[id]);
+		entry.size			= m_file_sizes[id];
+		entry.stored_size	= m_file_sizes[id];
+		entry.offset		= get_first_block_offset() + (static_cast<std::uint64_t>(first_blocks[id]) * get_blocksize());
+		entry.compression	= COMPRESSION_STORE;
+
+		const int func_result = func(entry,file);
+		if(func_result)
+			return func_result;
+	}
+
+	return result;
+}
+
+std::vector<std::string>
+PackageGCF::directory_paths() const
+{
+	std::vector<std::string> paths(m_directories.size());
+
+	for(size_t index = 1;index < m_directories.size();++index)
+	{
+		const DirectoryNode &	node = m_directories[index];
+		const std::string &		parent_path = paths[node.parent];
+
+		paths[index].reserve(parent_path.size() + node.name_size + 1);
+		paths[index] = parent_path;
+		if(!parent_path.empty())
+			paths[index].push_back('/');
+		paths[index].append(get_name(node.name_offset),node.name_size);
+	}
+
+	return paths;
+}
+
+void
+PackageGCF::list_files(std::vector<std::string> & out_paths) const
+{
+	const auto paths = directory_paths();
+
+	out_paths.assign(m_file_sizes.size(),std::string());
+
+	for(size_t index = 0;index < m_directories.size();++index)
+	{
+		const std::string prefix(paths[index].empty() ? paths[index] : paths[index] + "/");
+
+		static_cast<const DirectoryGCF *>(m_directories[index].p_directory.get())->for_each_file([&](const std::string & name,std::uint32_t id)
+		{
+			if(id < out_paths.size())
+				out_paths[id] = prefix + name;
+		});
+	}
+}
+
+bool							
+PackageGCF::get_file_info(	std::uint32_t		file_id,
+							std::uint32_t &		out_block_index,
+							std::uint32_t &		out_file_size )
+{
+	if(file_id >= m_file_sizes.size())
+		return false;
+
+	out_block_index	= m_file_blocks[file_id];
+	out_file_size	= m_file_sizes[file_id];
+
+	return true;
+}
+
+extent_list_shared_ptr
+PackageGCF::get_extents(std::uint32_t file_id,std::uint32_t first_block)
+{
+	if(file_id >= m_file_sizes.size())
+		return nullptr;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto ifind = m_extents.find(file_id);
+	if(ifind != m_extents.end())
+		return ifind->second;
+
+	//-------------------------------------------------------------------------
+	//	Walk the chain once, starting a new extent wherever the next block is
+	//	not the one that follows it in the file. The walk stops at the end of
+	//	the file so a damaged chain can't loop forever.
+	//-------------------------------------------------------------------------
+	const std::uint32_t	block_size	= std::max<std::uint32_t>(m_gcf_header.BlockSize,1);
+	const std::uint32_t	block_count	= static_cast<std::uint32_t>((static_cast<std::uint64_t>(m_file_sizes[file_id]) + block_size - 1) / block_size);
+	auto				p_extents	= std::make_shared<extent_list>();
+	std::uint32_t		block		= first_block;
+
+	for(std::uint32_t file_block = 0;(file_block < block_count) && (block < m_frag_map.size());++file_block)
+	{
+		if(p_extents->empty() || (block != p_extents->back().data_block + p_extents->back().block_count))
+			p_extents->push_back(Extent{file_block,block,0});
+
+		++p_extents->back().block_count;
+		block = m_frag_map[block];
+	}
+
+	p_extents->shrink_to_fit();
+	m_extents[file_id] = p_extents;
+
+	return p_extents;
+}
+
+//-----------------------------------------------------------------------------
+//	Read the checksum map and the checksums. The map is checked against the 
+//	size of the checksum section, the checksums and the files, so that a 
+//	damaged map is reported rather than leaving files unchecked.
+//-----------------------------------------------------------------------------
+PackageGCF::ChecksumStatus
+PackageGCF::load_checksums()
+{
+	if(m_checksum_status != CHECKSUMS_UNLOADED)
+		return m_checksum_status;
+
+	if(!m_checksum_map_offset)
+		return (m_checksum_status = CHECKSUMS_NONE);
+
+	m_checksum_status = CHECKSUMS_INVALID;
+
+	auto p_source = get_source();
+	if(!p_source)
+		return m_checksum_status;
+
+	GCFChecksumHeader		section_header;
+	GCFChecksumMapHeader	header;
+	std::uint64_t			pos = m_checksum_map_offset;
+
+	if(		(p_source->read_at(pos - sizeof(section_header),&section_header,sizeof(section_header)) != sizeof(section_header))
+		||	(p_source->read_at(pos,&header,sizeof(header)) != sizeof(header))
+		||	(header.Dummy0 != GCF_CHECKSUM_MAP_SIGNATURE)
+		||	(section_header.ChecksumSize < sizeof(GCFChecksumMapHeader)	+ (sizeof(GCFChecksumMapEntry) * static_cast<std::uint64_t>(header.ItemCount))
+																		+ (sizeof(GCFchecksumEntry) * static_cast<std::uint64_t>(header.ChecksumCount)))
+		||	(pos + section_header.ChecksumSize > p_source->size()) )
+		return m_checksum_status;
+
+	pos += sizeof(header);
+
+	std::vector<GCFChecksumMapEntry>	checksum_map(header.ItemCount);
+	std::vector<std::uint32_t>			checksums(header.ChecksumCount);
+	const size_t						map_size		= checksum_map.size() * sizeof(GCFChecksumMapEntry);
+	const size_t						checksums_size	= checksums.size() * sizeof(std::uint32_t);
+
+	if(		(p_source->read_at(pos,checksum_map.data(),map_size) != map_size)
+		||	(p_source->read_at(pos + map_size,checksums.data(),checksums_size) != checksums_size) )
+		return m_checksum_status;
+
+	for(auto & entry : checksum_map)
+	{
+		if(static_cast<std::uint64_t>(entry.FirstChecksumIndex) + entry.ChecksumCount > checksums.size())
+			return m_checksum_status;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Every file with checksums must have one for each of its chunks.
+	//-------------------------------------------------------------------------
+	for(std::uint32_t id = 0;id < m_file_checksums.size();++id)
+	{
+		const std::uint32_t checksum_index = m_file_checksums[id];
+
+		if(		(checksum_index != GCF_NO_CHECKSUM)
+			&&	(		(checksum_index >= checksum_map.size())
+					||	(checksum_map[checksum_index].ChecksumCount < (static_cast<std::uint64_t>(m_file_sizes[id]) + GCF_CHECKSUM_CHUNK_SIZE - 1) / GCF_CHECKSUM_CHUNK_SIZE) ) )
+			return m_checksum_status;
+	}
+
+	m_checksum_map.swap(checksum_map);
+	m_checksums.swap(checksums);
+	m_chunk_state.assign(m_checksums.size(),CHUNK_UNCHECKED);
+
+	return (m_checksum_status = CHECKSUMS_LOADED);
+}
+
+std::uint32_t
+PackageGCF::get_checksum_slot(std::uint32_t file_id,std::uint32_t chunk) const
+{
+	if(file_id >= m_file_checksums.size())
+		return GCF_NO_CHECKSUM;
+
+	const std::uint32_t checksum_index = m_file_checksums[file_id];
+	if(checksum_index >= m_checksum_map.size())
+		return GCF_NO_CHECKSUM;
+
+	const GCFChecksumMapEntry & entry = m_checksum_map[checksum_index];
+	if((chunk >= entry.ChecksumCount) || (static_cast<std::uint64_t>(entry.FirstChecksumIndex) + chunk >= m_checksums.size()))
+		return GCF_NO_CHECKSUM;
+
+	return entry.FirstChecksumIndex + chunk;
+}
+
+PackageGCF::ChunkState
+PackageGCF::get_chunk_state(std::uint32_t file_id,std::uint32_t chunk)
+{
+	std::unique_lock<std::mutex> lock(m_checksum_mutex);
+
+	switch(load_checksums())
+	{
+		case CHECKSUMS_LOADED :		break;
+		case CHECKSUMS_INVALID :	return CHUNK_DAMAGED;
+		default :					return CHUNK_GOOD;
+	}
+
+	const std::uint32_t slot = get_checksum_slot(file_id,chunk);
+	return (slot == GCF_NO_CHECKSUM ? CHUNK_GOOD : m_chunk_state[slot]);
+}
+
+int
+PackageGCF::check_chunk(std::uint32_t file_id,std::uint32_t chunk,const char * p_data,size_t size)
+{
+	std::uint32_t slot;
+	std::uint32_t expected;
+
+	{
+		std::unique_lock<std::mutex> lock(m_checksum_mutex);
+
+		switch(load_checksums())
+		{
+			case CHECKSUMS_LOADED :		break;
+			case CHECKSUMS_INVALID :	return -1;
+			default :					return 0;
+		}
+
+		slot = get_checksum_slot(file_id,chunk);
+		if(slot == GCF_NO_CHECKSUM)
+			return 0;
+
+		if(m_chunk_state[slot] != CHUNK_UNCHECKED)
+			return (m_chunk_state[slot] == CHUNK_GOOD ? 0 : -1);
+
+		expected = m_checksums[slot];
+	}
+
+	//-------------------------------------------------------------------------
+	//	The GCF checksum is the Adler-32 of the chunk, started from zero
+	//	rather than one, XORed with its CRC-32.
+	//-------------------------------------------------------------------------
+	const bool b_good = ((adler32(p_data,size,0) ^ crc32(p_data,size)) == expected);
+
+	std::unique_lock<std::mutex> lock(m_checksum_mutex);
+	m_chunk_state[slot] = (b_good ? CHUNK_GOOD : CHUNK_DAMAGED);
+
+	return (b_good ? 0 : -1);
+}
+
+int
+PackageGCF::verify(unsigned thread_count,std::vector<std::string> * p_out_damaged)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_checksum_mutex);
+
+		switch(load_checksums())
+		{
+			case CHECKSUMS_LOADED :		break;
+			case CHECKSUMS_INVALID :	return -1;
+			default :					return 0;
+		}
+	}
+
+	//-------------------------------------------------------------------------
+	//	Split the files into pieces of up to a megabyte so that large files
+	//	are spread over the threads too.
+	//-------------------------------------------------------------------------
+	struct Piece
+	{
+		std::uint32_t	file_id;
+		std::uint32_t	offset;
+		std::uint32_t	size;
+	};
+
+	const std::uint32_t	PIECE_SIZE = GCF_CHECKSUM_CHUNK_SIZE * 32;
+	std::vector<Piece>	pieces;
+
+	for(std::uint32_t id = 0;id < m_file_sizes.size();++id)
+	{
+		if(m_file_checksums[id] == GCF_NO_CHECKSUM)
+			continue;
+
+		const std::uint32_t file_size = m_file_sizes[id];
+
+		for(std::uint32_t offset = 0;offset < file_size;offset += std::min(PIECE_SIZE,file_size - offset))
+			pieces.push_back(Piece{id,offset,std::min(PIECE_SIZE,file_size - offset)});
+	}
+
+	//-------------------------------------------------------------------------
+	//	Each worker takes the next piece from the list until there are none 
+	//	left. Consecutive pieces of a file reuse the same open file.
+	//-------------------------------------------------------------------------
+	std::vector<char>	damaged(pieces.size(),0);
+	std::atomic<size_t>	next(0);
+
+	auto worker = [&]()
+	{
+		std::unique_ptr<FileGCF>	p_file;
+		std::uint32_t				file_id = 0;
+
+		for(size_t i = next++;i < pieces.size();i = next++)
+		{
+			try
+			{
+				if(!p_file || (file_id != pieces[i].file_id))
+				{
+					file_id = pieces[i].file_id;
+					p_file.reset(new FileGCF(file_id,MODE_READ,this));
+				}
+
+				damaged[i] = (p_file->is_fail() || p_file->verify(pieces[i].offset,pieces[i].size) ? 1 : 0);
+			}
+			catch(...)
+			{
+				damaged[i] = 1;
+			}
+		}
+	};
+
+	if(!thread_count)
+		thread_count = std::max(1u,std::thread::hardware_concurrency());
+
+	thread_count = static_cast<unsigned>(std::max<size_t>(1,std::min<size_t>(thread_count,pieces.size())));
+
+	std::vector<std::thread> threads;
+
+	try
+	{
+		for(unsigned i = 1;i < thread_count;++i)
+			threads.emplace_back(worker);
+	}
+	catch(...){}
+
+	worker();
+
+	for(auto & thread : threads)
+		thread.join();
+
+	//-------------------------------------------------------------------------
+	//	Collect the damaged files.
+	//-------------------------------------------------------------------------
+	std::vector<char> damaged_files(m_file_sizes.size(),0);
+	bool err = false;
+
+	for(size_t i = 0;i < pieces.size();++i)
+	{
+		if(damaged[i])
+		{
+			damaged_files[pieces[i].file_id] = 1;
+			err = true;
+		}
+	}
+
+	if(err && p_out_damaged)
+	{
+		std::vector<std::string> paths;
+		list_files(paths);
+
+		for(size_t id = 0;id < damaged_files.size();++id)
+			if(damaged_files[id])
+				p_out_damaged->push_back(paths[id]);
+	}
+
+	return (err ? -1 : 0);
+}
+
+//=============================================================================
+//
+//
+//	PACKAGE GCF - FILE CLASS
+//
+//
+//=============================================================================
+
+FileGCF::FileGCF(	std::uint32_t			id,
+					std::uint32_t			mode,
+					PackageGCF *			p_package,
+					data_source_shared_ptr	p_source )
+	: m_mode(mode)
+	, m_p_package(p_package)
+	, m_id(id)
+	, m_first_data_block_offset(0)
+	, m_file_pointer(0)
+	, m_block_num(0)
+	, m_block_offset(0)
+	, m_block_data_avail(0)
+	, m_gcount(0)
+	, m_b_failbit(false)
+	, m_block_size(0)
+	, m_extent(0)
+	, m_block_cache_owner(p_package->get_block_cache_owner())
+	, m_block_pointer(0)
+	, m_p_get(nullptr)
+	, m_p_get_end(nullptr)
+	, m_b_prefetch(false)
+	, m_read_end(0)
+	, m_prefetch_end(0)
+{
+	assert(m_p_package);
+	if(m_p_package->get_file_info(m_id,m_block_index,m_size))
+	{	
+		m_file_pointer	= (mode & MODE_AT_END ? m_size : 0);
+		m_block_size	= m_p_package->get_blocksize();
+
+		//---------------------------------------------------------------------
+		//	Get the GCF package data. 
+		//---------------------------------------------------------------------
+		auto p_package_source = m_p_package->get_source();
+		m_p_source = (p_source ? std::move(p_source) : p_package_source);
+
+		//---------------------------------------------------------------------
+		//	Read through the block cache unless the file has its own source or 
+		//	the package is already in memory.
+		//---------------------------------------------------------------------
+		if(!p_source && m_p_source && !m_p_source->data())
+			m_p_block_cache = m_p_package->get_block_cache();
+
+		//---------------------------------------------------------------------
+		//	A source given to the file is already read in order so it isn't
+		//	prefetched.
+		//---------------------------------------------------------------------
+		m_b_prefetch	= !p_source;
+		m_read_end		= m_file_pointer;
+
+		//---------------------------------------------------------------------
+		//	Read the Block Entry. It always comes from the package's own source
+		//	so that a read ahead source is only used for the file's data.
+		//---------------------------------------------------------------------
+		GCFBlockEntry		block_entry;
+		const std::uint64_t	entry_offset = sizeof(GCFHeader)+sizeof(GCFBlockEntryHeader)+(sizeof(GCFBlockEntry)*static_cast<std::uint64_t>(m_block_index));
+
+		if(		!p_package_source
+			||	!m_p_source
+			||	(p_package_source->read_at(entry_offset,&block_entry,sizeof(GCFBlockEntry)) != sizeof(GCFBlockEntry)))
+		{
+			//std::clog << "PACKAGEGCF:FILEGCF: Package file '" << m_p_package->get_filename() << "' could not be read!\n";
+			m_b_failbit = true;
+		}
+		else
+		{
+			m_first_data_block_index	= block_entry.FirstDataBlockIndex;
+			m_first_data_block_offset	= m_p_package->get_first_block_offset();
+			m_p_extents					= m_p_package->get_extents(m_id,m_first_data_block_index);
+
+			if(m_p_extents)
+				update_block_info();
+			else
+				m_b_failbit = true;
+		}
+	}
+	else
+		m_b_failbit = true;
+}
+
+FileGCF::~FileGCF(void)
+{
+}
+
+//-----------------------------------------------------------------------------
+//	Called by get() when the get buffer is empty.
+//-----------------------------------------------------------------------------
+int
+FileGCF::get_buffered()
+{
+	if(!fill_get_buffer())
+		return EOF;
+
+	++m_file_pointer;
+	return static_cast<unsigned char>(*m_p_get++);
+}
+
+//-----------------------------------------------------------------------------
+//	Read the rest of the current block into the get buffer. The file pointer
+//	is left where it was and moves on as the buffer is used.
+//-----------------------------------------------------------------------------
+bool
+FileGCF::fill_get_buffer()
+{
+	m_p_get = m_p_get_end = nullptr;
+
+	if(is_eof() || is_fail())
+		return false;
+
+	const std::uint32_t	position	= m_file_pointer;
+	const size_t		fill_size	= std::min<size_t>(m_block_size - (position % m_block_size),m_size - position);
+
+	m_get_buffer.resize(m_block_size);
+
+	const size_t readsize = read(m_get_buffer.data(),fill_size);
+	if(!readsize)
+		return false;
+
+	m_file_pointer	= position;
+	m_p_get			= m_get_buffer.data();
+	m_p_get_end		= m_p_get + readsize;
+
+	return true;
+}
+
+size_t
+FileGCF::read(char * p_buffer,size_t size)
+{
+	if(is_eof() || is_fail())
+		return 0;
+
+	//-------------------------------------------------------------------------
+	//	Use up anything left in the get buffer first.
+	//-------------------------------------------------------------------------
+	size_t buffered = 0;
+
+	if(m_p_get < m_p_get_end)
+	{
+		buffered = std::min(size,static_cast<size_t>(m_p_get_end - m_p_get));
+		std::memcpy(p_buffer,m_p_get,buffered);
+
+		m_p_get			+= buffered;
+		m_file_pointer	+= static_cast<std::uint32_t>(buffered);
+		p_buffer		+= buffered;
+		size			-= buffered;
+
+		if(!size || is_eof())
+			return buffered;
+	}
+
+	if(m_p_package->get_verify_reads() && verify(m_file_pointer,static_cast<std::uint32_t>(std::min<size_t>(size,m_size - m_file_pointer))))
+	{
+		m_b_failbit = true;
+		return buffered;
+	}
+
+	return buffered + read_data(p_buffer,size);
+}
+
+int
+FileGCF::verify(std::uint32_t offset,std::uint32_t size)
+{
+	if(is_fail() || !size || (offset >= m_size))
+		return (is_fail() ? -1 : 0);
+
+	size = std::min(size,m_size - offset);
+
+	//-------------------------------------------------------------------------
+	//	Read and check each chunk in the range that hasn't already been
+	//	checked. The file position is put back afterwards.
+	//-------------------------------------------------------------------------
+	const std::uint32_t	first_chunk		= offset / GCF_CHECKSUM_CHUNK_SIZE;
+	const std::uint32_t	last_chunk		= (offset + size - 1) / GCF_CHECKSUM_CHUNK_SIZE;
+	const std::uint32_t	file_pointer	= m_file_pointer;
+	int					result			= 0;
+	bool				b_moved			= false;
+
+	for(std::uint32_t chunk = first_chunk;chunk <= last_chunk;++chunk)
+	{
+		const auto state = m_p_package->get_chunk_state(m_id,chunk);
+
+		if(state == PackageGCF::CHUNK_DAMAGED)
+			result = -1;
+
+		if(state != PackageGCF::CHUNK_UNCHECKED)
+			continue;
+
+		const std::uint32_t chunk_offset	= chunk * GCF_CHECKSUM_CHUNK_SIZE;
+		const std::uint32_t chunk_size		= std::min(GCF_CHECKSUM_CHUNK_SIZE,m_size - chunk_offset);
+
+		m_chunk_buffer.resize(GCF_CHECKSUM_CHUNK_SIZE);
+		seek(chunk_offset);
+		b_moved = true;
+
+		if(		(read_data(m_chunk_buffer.data(),chunk_size) != chunk_size)
+			||	m_p_package->check_chunk(m_id,chunk,m_chunk_buffer.data(),chunk_size) )
+			result = -1;
+	}
+
+	if(b_moved)
+		seek(file_pointer);
+
+	return result;
+}
+
+size_t
+FileGCF::read_data(char * p_buffer,size_t size)
+{
+	if(is_eof() || is_fail())
+		return 0;
+
+	if(m_block_pointer != m_file_pointer)
+		update_block_info();
+
+	//-------------------------------------------------------------------------
+	//	A read that carries on from where the last one ended is streaming
+	//	through the file, so the blocks ahead of it are prefetched.
+	//-------------------------------------------------------------------------
+	const bool b_sequential = m_b_prefetch && (m_file_pointer == m_read_end);
+
+	if(!b_sequential)
+		m_prefetch_end = 0;
+
+	size_t				totalread = 0;
+	const std::uint32_t	available = m_size - m_file_pointer;
+
+	if(size > available)
+		size = available;
+
+	while(size)
+	{
+		size_t				readsize	= std::min(m_block_data_avail,size);											// The amount of data to read from the extent.
+		const std::uint64_t	fileofs		= m_first_data_block_offset + (static_cast<std::uint64_t>(m_block_num) * m_block_size) + m_block_offset;	// The offset of the data in the package file.
+
+		if(!readsize)
+			break;
+
+		if(b_sequential)
+			prefetch();
+
+		readsize = (m_p_block_cache ? read_cached(p_buffer,readsize) : m_p_source->read_at(fileofs,p_buffer,readsize));
+		if(!readsize)
+		{
+			m_b_failbit = true;
+			break;
+		}
+
+		p_buffer			+= readsize;
+		totalread			+= readsize;
 		m_file_pointer		+= static_cast<std::uint32_t>(readsize);
+		m_block_pointer		= m_file_pointer;
 		size				-= readsize;
 	
 		m_block_data_avail	-= readsize;
 		m_block_offset		+= static_cast<std::uint32_t>(readsize);
 
 		if(m_block_data_avail == 0)
-		{
-			m_block_num			= m_p_package->get_next_block(m_block_num);
-			m_block_data_avail	= (m_block_num >= m_p_package->get_blockcount() ? 0 : m_block_size);
-			m_block_offset		= 0;
-		}
+			next_extent();
 	}
 
+	m_read_end = m_file_pointer;
+
 	return totalread;
 }
 
+//-----------------------------------------------------------------------------
+//	Read from the current position through the block cache. 'size' must not
+//	run past the end of the current extent. Cached blocks are copied one at a
+//	time. On a miss the blocks up to the end of the read are read together and
+//	all of them are added to the cache.
+//-----------------------------------------------------------------------------
+size_t
+FileGCF::read_cached(char * p_buffer,size_t size)
+{
+	const std::uint32_t	block	= m_block_num + (m_block_offset / m_block_size);
+	const std::uint32_t	offset	= m_block_offset % m_block_size;
+
+	auto p_block = m_p_block_cache->find(m_block_cache_owner,block);
+	if(p_block)
+	{
+		if(p_block->size() <= offset)
+			return 0;
+
+		const size_t readsize = std::min(size,p_block->size() - offset);
+		std::memcpy(p_buffer,p_block->data() + offset,readsize);
+
+		return readsize;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Large reads are split so that the buffer stays a reasonable size.
+	//-------------------------------------------------------------------------
+	const size_t max_blocks		= std::max<size_t>(1,(1024 * 1024) / m_block_size);
+	const size_t block_count	= std::min<size_t>(max_blocks,(offset + size + m_block_size - 1) / m_block_size);
+	const size_t run_size		= block_count * m_block_size;
+
+	m_block_buffer.resize(run_size);
+
+	const size_t readsize = m_p_source->read_at(m_first_data_block_offset + (static_cast<std::uint64_t>(block) * m_block_size),m_block_buffer.data(),run_size);
+	if(readsize <= offset)
+		return 0;
+
+	for(size_t index = 0;index * m_block_size < readsize;++index)
+		m_p_block_cache->insert(m_block_cache_owner,block + static_cast<std::uint32_t>(index),m_block_buffer.data() + (index * m_block_size),std::min<size_t>(m_block_size,readsize - (index * m_block_size)));
+
+	const size_t copysize = std::min(size,readsize - offset);
+	std::memcpy(p_buffer,m_block_buffer.data() + offset,copysize);
+
+	return copysize;
+}
+
+//-----------------------------------------------------------------------------
+//	Ask the source to start reading the blocks that come next in the file.
+//	The window is topped up when less than half of it is left, so there is
+//	one request for each run of blocks rather than one for each read.
+//-----------------------------------------------------------------------------
+void
+FileGCF::prefetch()
+{
+	const extent_list &	extents		= *m_p_extents;
+	const std::uint32_t	lookahead	= m_p_package->get_prefetch_blocks();
+
+	//-------------------------------------------------------------------------
+	//	The system's own read ahead already handles files that are in one 
+	//	piece.
+	//-------------------------------------------------------------------------
+	if(!lookahead || (extents.size() < 2) || (m_extent >= extents.size()))
+		return;
+
+	const std::uint32_t file_block = m_file_pointer / m_block_size;
+
+	if(static_cast<std::uint64_t>(m_prefetch_end) >= static_cast<std::uint64_t>(file_block) + (lookahead / 2))
+		return;
+
+	const std::uint64_t	end		= static_cast<std::uint64_t>(file_block) + lookahead;
+	std::uint32_t		block	= std::max(m_prefetch_end,file_block);
+
+	for(size_t index = m_extent;(index < extents.size()) && (block < end);++index)
+	{
+		const Extent &		extent		= extents[index];
+		const std::uint32_t	extent_end	= extent.file_block + extent.block_count;
+
+		if(block >= extent_end)
+			continue;
+
+		block = std::max(block,extent.file_block);
+
+		const std::uint32_t count = static_cast<std::uint32_t>(std::min<std::uint64_t>(extent_end,end) - block);
+
+		m_p_source->prefetch(	m_first_data_block_offset + (static_cast<std::uint64_t>(extent.data_block + (block - extent.file_block)) * m_block_size),
+								static_cast<size_t>(count) * m_block_size );
+		block += count;
+	}
+
+	m_prefetch_end = block;
+}
+
 void
 FileGCF::write(const char * /*p_data*/,size_t /*size*/)
 {
@@ -605,15 +1514,38 @@ FileGCF::write(const char * /*p_data*/,size_t /*size*/)
 void
 FileGCF::ignore(size_t count,int delimeter)
 {
-	// TODO : Improve this function for performance.
+	//-------------------------------------------------------------------------
+	//	Without a delimiter this is a seek, unless it stays in the get buffer.
+	//	A delimiter that get() can never return is the same.
+	//-------------------------------------------------------------------------
+	if((delimeter < 0) || (delimeter > 0xFF))
+	{
+		if(count <= static_cast<size_t>(m_p_get_end - m_p_get))
+		{
+			m_p_get			+= count;
+			m_file_pointer	+= static_cast<std::uint32_t>(count);
+		}
+		else
+			seek(static_cast<adefs::fileoffset>(std::min<size_t>(count,m_size)),adefs::Seek::CURRENT);
 
-	if(delimeter < 0)
-		seek(static_cast<adefs::fileoffset>(count),adefs::Seek::CURRENT);
-	else
+		return;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Search for the delimiter a block at a time.
+	//-------------------------------------------------------------------------
+	while(count && ((m_p_get < m_p_get_end) || fill_get_buffer()))
 	{
-		while(count-- && !is_eof() && !is_fail())
-			if(get() == delimeter)
-				break;
+		const size_t	avail	= std::min(count,static_cast<size_t>(m_p_get_end - m_p_get));
+		auto			p_found	= static_cast<const char *>(std::memchr(m_p_get,delimeter,avail));
+		const size_t	used	= (p_found ? static_cast<size_t>(p_found - m_p_get) + 1 : avail);
+
+		m_p_get			+= used;
+		m_file_pointer	+= static_cast<std::uint32_t>(used);
+		count			-= used;
+
+		if(p_found)
+			break;
 	}
 }
 
@@ -625,37 +1557,89 @@ FileGCF::seek(fileoffset offset,adefs::Seek dir)
 		//---------------------------------------------------------------------
 		case adefs::Seek::BEGINNING :		
 		//---------------------------------------------------------------------
-			m_file_pointer = std::min<std::uint32_t>(offset,m_size); 
+			m_file_pointer = static_cast<std::uint32_t>(offset < 0 ? 0 : std::min<fileoffset>(offset,m_size)); 
 			break;
 
 		//---------------------------------------------------------------------
 		case adefs::Seek::CURRENT :	
 		//---------------------------------------------------------------------
 			{
-				std::int32_t ofs = ((std::int32_t)m_file_pointer)+offset;
-				m_file_pointer = (ofs < 0 ? 0 : ((std::uint32_t)ofs > m_size ? m_size : ofs));
+				fileoffset ofs = static_cast<fileoffset>(m_file_pointer)+offset;
+				m_file_pointer = static_cast<std::uint32_t>(ofs < 0 ? 0 : (ofs > m_size ? m_size : ofs));
 			}
 			break;
 
 		//---------------------------------------------------------------------
 		case adefs::Seek::END :
 		//---------------------------------------------------------------------
-			m_file_pointer = m_size;
+			{
+				fileoffset ofs = static_cast<fileoffset>(m_size)+offset;
+				m_file_pointer = static_cast<std::uint32_t>(ofs < 0 ? 0 : (ofs > m_size ? m_size : ofs));
+			}
 			break;
 
 		default :
 			break;
 	}
 
+	m_p_get = m_p_get_end = nullptr;
 	update_block_info();
 }
 
 void 
 FileGCF::update_block_info()
 {
-	m_block_num			= m_p_package->get_block_index(m_first_data_block_index,m_file_pointer);
+	//-------------------------------------------------------------------------
+	//	Find the extent that holds the file pointer. Most files are a single
+	//	extent so that is checked before searching.
+	//-------------------------------------------------------------------------
+	const extent_list &	extents		= *m_p_extents;
+	const std::uint32_t	file_block	= m_file_pointer / m_block_size;
+
+	m_block_pointer		= m_file_pointer;
 	m_block_offset		= m_file_pointer % m_block_size;
-	m_block_data_avail	= m_block_size - m_block_offset;
+	m_block_data_avail	= 0;
+	m_extent			= extents.size();
+
+	if((extents.size() == 1) && (file_block < extents[0].block_count))
+		m_extent = 0;
+	else if(!extents.empty())
+	{
+		auto iextent = std::upper_bound(extents.begin(),extents.end(),file_block,[](std::uint32_t block,const Extent & extent) {return block < extent.file_block;});
+		if(iextent != extents.begin())
+		{
+			--iextent;
+			if(file_block - iextent->file_block < iextent->block_count)
+				m_extent = static_cast<size_t>(iextent - extents.begin());
+		}
+	}
+
+	//-------------------------------------------------------------------------
+	//	Reads run on to the end of the extent so that the blocks in it are
+	//	read together.
+	//-------------------------------------------------------------------------
+	if(m_extent < extents.size())
+	{
+		const std::uint32_t blocks_left = extents[m_extent].block_count - (file_block - extents[m_extent].file_block);
+
+		m_block_num			= extents[m_extent].data_block + (file_block - extents[m_extent].file_block);
+		m_block_data_avail	= (static_cast<size_t>(blocks_left) * m_block_size) - m_block_offset;
+	}
+}
+
+void
+FileGCF::next_extent()
+{
+	const extent_list & extents = *m_p_extents;
+
+	m_block_offset		= 0;
+	m_block_data_avail	= 0;
+
+	if((m_extent < extents.size()) && (++m_extent < extents.size()))
+	{
+		m_block_num			= extents[m_extent].data_block;
+		m_block_data_avail	= static_cast<size_t>(extents[m_extent].block_count) * m_block_size;
+	}
 }
 
 
@@ -675,7 +1659,7 @@ PackageFactoryGCF::is_supported(const std::string & path)
 	if(pos == std::string::npos)
 		return false;
 
-	std::string ext(path.substr(pos));
+	std::string ext(path.substr(pos+1));
 	std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
 	return !!(ext == "gcf");
 }
@@ -683,7 +1667,10 @@ PackageFactoryGCF::is_supported(const std::string & path)
 package_shared_ptr				
 PackageFactoryGCF::create_package(const std::string & path)
 {
-	return std::make_shared<PackageGCF>(path);
+	auto p_package = std::make_shared<PackageGCF>(path);
+	p_package->set_index_cache(m_p_index_cache);
+	p_package->set_block_cache(m_p_block_cache);
+	return p_package;
 }
 
 
@@ -12,12 +12,12 @@
 #define GUARD_ADEFS_PACKAGE_GCF_H
 
 #include <iostream>
-#include <fstream>
 #include <cstdint>
 #include <memory>
 #include <algorithm>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -25,6 +25,9 @@
 #include <sys/stat.h>
 #include <stdio.h>
 #include "adefs.h"
+#include "index_cache.h"
+#include "block_cache.h"
+#include "data_source.h"
 
 namespace adefs { namespace package_gcf
 {
@@ -254,6 +257,26 @@ struct GCFDataBlockHeader
 
 #pragma pack(pop)
 
+static const std::uint32_t	GCF_CHECKSUM_MAP_SIGNATURE	= 0x14893721;	// GCFChecksumMapHeader::Dummy0
+static const std::uint32_t	GCF_CHECKSUM_CHUNK_SIZE		= 0x8000;		// Each checksum covers this much of a file.
+static const std::uint32_t	GCF_NO_CHECKSUM				= 0xFFFFFFFF;	// GCFDirectoryEntry::ChecksumIndex for a file without checksums.
+static const std::uint32_t	GCF_DEFAULT_PREFETCH_BLOCKS	= 128;			// How far ahead of sequential reads blocks are prefetched.
+
+//-----------------------------------------------------------------------------
+//	A run of data blocks that follow each other in the package file. A file's
+//	block chain is flattened into a list of these, in file order, so that a
+//	position in the file can be found without walking the chain.
+//-----------------------------------------------------------------------------
+struct Extent
+{
+	std::uint32_t					file_block;			// The block number within the file of the first block in the run.
+	std::uint32_t					data_block;			// The index of the first data block in the run.
+	std::uint32_t					block_count;		// The number of blocks in the run.
+};
+
+typedef std::vector<Extent>					extent_list;
+typedef std::shared_ptr<const extent_list>	extent_list_shared_ptr;
+
 //=============================================================================
 //
 //
@@ -268,7 +291,7 @@ class FileGCF : public IFile
 private:
 	std::uint32_t					m_mode;
 	class PackageGCF *				m_p_package;		
-	std::ifstream					m_stream;
+	data_source_shared_ptr			m_p_source;			// The package data.
 	std::uint32_t					m_block_index;
 	std::uint32_t					m_size;
 	std::uint32_t					m_id;
@@ -276,13 +299,28 @@ private:
 
 	std::uint32_t					m_file_pointer;		// The current position in the file.
 	std::uint32_t					m_block_num;		// The current block number (that relates to m_file_pointer).
-	std::uint32_t					m_block_offset;		// The offset from the start of the current block to the current file pointer.
-	size_t							m_block_data_avail;	// The amount of data available in the current block.
+	std::uint32_t					m_block_offset;		// The offset from the start of the current block to the current file pointer. It
+														// runs on past the end of the block while the following blocks are contiguous.
+	size_t							m_block_data_avail;	// The amount of data available before the end of the current extent.
 
 	size_t							m_gcount;			// The amount of data read by the last read operation.
 	bool							m_b_failbit;
 	std::uint32_t					m_block_size;
 	std::uint32_t					m_first_data_block_index;	
+	extent_list_shared_ptr			m_p_extents;		// The file's block chain.
+	size_t							m_extent;			// The extent that holds the current block.
+	block_cache_shared_ptr			m_p_block_cache;	// The package's block cache, if the file reads through it.
+	std::uint32_t					m_block_cache_owner;
+	std::vector<char>				m_block_buffer;		// Blocks read on a cache miss.
+	std::vector<char>				m_chunk_buffer;		// Used to read chunks for checking.
+	std::uint32_t					m_block_pointer;	// The file position that the block information is for. It falls
+														// behind m_file_pointer while data is taken from the get buffer.
+	std::vector<char>				m_get_buffer;		// The rest of the current block, read for get() and ignore().
+	const char *					m_p_get;			// The next byte in the get buffer, which is at m_file_pointer.
+	const char *					m_p_get_end;		// The end of the data in the get buffer.
+	bool							m_b_prefetch;		// True if upcoming blocks are prefetched during sequential reads.
+	std::uint32_t					m_read_end;			// The file position where the last read ended.
+	std::uint32_t					m_prefetch_end;		// The file block that blocks have been prefetched up to.
 
 
 public:
@@ -290,16 +328,19 @@ public:
 	FileGCF(const FileGCF &) = delete;
 	FileGCF & operator=(const FileGCF &) = delete;
 
+									// The file's data is read from 'p_source' if it is given, otherwise 
+									// from the package's own source.
 	FileGCF(std::uint32_t			id,
 			std::uint32_t			mode,
-			class PackageGCF *		p_package);
+			class PackageGCF *		p_package,
+			data_source_shared_ptr	p_source = nullptr);
 	~FileGCF(void);
 
-	int								get();
+	int								get()										{return (m_p_get < m_p_get_end ? (++m_file_pointer,static_cast<unsigned char>(*m_p_get++)) : get_buffered());}
 	size_t							read(char * p_buffer,size_t size);
 	void							write(const char * p_data,size_t size);
 	void							ignore(size_t count,int delimeter = -1);
-	void							seek(filepos pos)							{m_file_pointer = std::min<std::uint32_t>(pos,m_size);	update_block_info();}
+	void							seek(filepos pos)							{m_file_pointer = static_cast<std::uint32_t>(std::min<filepos>(pos,m_size));	m_p_get = m_p_get_end = nullptr;	update_block_info();}
 	void							seek(fileoffset offset,adefs::Seek dir);
 	size_t							tell()										{return m_file_pointer;}
 
@@ -308,8 +349,19 @@ public:
 	size_t							count()										{return m_gcount;}
 	size_t							size()										{return m_size;}
 
+									// Check the checksums of the chunks that hold part of the file. Chunks that
+									// have already been checked are not read again. Returns -1 if any of them
+									// is damaged.
+	int								verify(std::uint32_t offset,std::uint32_t size);
+
 private:
+	size_t							read_data(char * p_buffer,size_t size);
+	size_t							read_cached(char * p_buffer,size_t size);
+	int								get_buffered();
+	bool							fill_get_buffer();
+	void							prefetch();
 	void							update_block_info();
+	void							next_extent();
 };
 
 //=============================================================================
@@ -322,24 +374,13 @@ private:
 class DirectoryGCF : public IDirectory
 {
 private:
-	struct FileInfo
-	{
-		std::string					filename;
-		std::uint32_t				index;				// The block index of the start of the file.
-		std::uint32_t				size;				// Size of the file in bytes.
-		std::uint32_t				file_id;			// The index of the first data block for this file.
-	};
-
 	//=========================================================================
 	//	ATTRIBUTES
 	//=========================================================================
 	class PackageGCF *				m_p_package;		// A pointer to the package that owns this directory. This is used
 														// to get access to the GCF file data.
-	std::mutex						m_mutex;			// Mutex for exclusive access to the directory.
-	std::map<std::string,FileInfo>	m_files;			// An array of structures that contain information about the files 
-														// in this directory. The key for this map holds the filename 
-														// converted to lower case so that files can be looked up in a 
-														// non case sensitive way.
+	std::uint32_t					m_first_file;		// The id of the directory's first file. The package numbers the files
+	std::uint32_t					m_file_count;		// of each directory consecutively in name order.
 
 	//=========================================================================
 	//	PRIVATE FUNCTIONS
@@ -350,24 +391,21 @@ private:
 	DirectoryGCF(const DirectoryGCF & x);
 	DirectoryGCF & operator=(const DirectoryGCF & x);
 
-	int								get_fileinfo(	const std::string & filename,
-													FileInfo & out_fileinfo );
+	std::int64_t					find(const std::string & filename) const;
 
 
 	//=========================================================================
 	//	PUBLIC FUNCTIONS
 	//=========================================================================
 public:
-	DirectoryGCF(class PackageGCF * p_package);
+	DirectoryGCF(class PackageGCF * p_package,std::uint32_t first_file,std::uint32_t file_count);
 	~DirectoryGCF();
 
 	//-------------------------------------------------------------------------
 	//	NON-INTERFACE FUNCTIONS
 	//-------------------------------------------------------------------------
-	void							add_file(	const std::string & filename,
-												std::uint32_t		index,
-												std::uint32_t		size,
-												std::uint32_t		id);
+									// Call 'func' with the name and id of each file in the directory.
+	void							for_each_file(const std::function<void(const std::string & name,std::uint32_t id)> & func) const;
 
 	//-------------------------------------------------------------------------
 	//	INTERFACE FUNCTIONS
@@ -403,6 +441,14 @@ public:
 
 class PackageGCF : public IPackage
 {
+public:
+	enum ChunkState : std::uint8_t
+	{
+		CHUNK_UNCHECKED,
+		CHUNK_GOOD,											// The chunk matches its checksum or has no checksum.
+		CHUNK_DAMAGED
+	};
+
 private:
 	struct DirectoryInfo
 	{
@@ -414,27 +460,65 @@ private:
 		std::uint32_t							dir_entries_offset;
 	};
 
-	struct FileInfo
+	struct DirectoryNode
+	{
+		directory_shared_ptr					p_directory;
+		std::uint32_t							parent;						// The index of the parent directory. The root is its own parent.
+		std::uint32_t							name_offset;				// The offset of the directory's name in the name pool.
+		std::uint32_t							name_size;
+		std::uint32_t							first_file;					// The id of the directory's first file.
+		std::uint32_t							file_count;
+	};
+
+	struct FileName
 	{
-		std::uint32_t							file_size;					// Size of the item.  (If file, file size.  If folder, num items.)
-		std::uint32_t							data_block_index;			// The index of the first data block for this file.
+		std::uint32_t							offset;						// The offset of the file's name in the name pool.
+		std::uint32_t							size;
 	};
 
-	struct DirectoryNode
+	enum {INDEX_VERSION = 5};												// The layout of the cached index. Change it if the headers, the file tables or the directory tables change.
+
+	enum ChecksumStatus
 	{
-		directory_shared_ptr					p_directory;
-		std::map<std::string,DirectoryNode>		sub_directories;
+		CHECKSUMS_UNLOADED,
+		CHECKSUMS_NONE,														// The GCF has no checksum section.
+		CHECKSUMS_LOADED,
+		CHECKSUMS_INVALID													// The GCF has a checksum section but it is damaged.
 	};
 
 	std::string									m_filename;
 	std::mutex									m_mutex;					// Mutex for exclusive access.
-	DirectoryNode								m_root_directory;			// The root node of the directory tree.
-	std::vector<FileInfo>						m_file_info;
+	std::vector<DirectoryNode>					m_directories;				// The directories. The root is first and every directory comes after its parent.
+	std::vector<char>							m_names;					// The GCF's name block in lower case. Directory and file names point into it.
+
+	//-------------------------------------------------------------------------
+	//	The files are held as a table for each field, indexed by file id. The
+	//	files of each directory have consecutive ids in name order.
+	//-------------------------------------------------------------------------
+	std::vector<FileName>						m_file_names;
+	std::vector<std::uint32_t>					m_file_sizes;
+	std::vector<std::uint32_t>					m_file_blocks;				// The index of the first block entry of each file.
+	std::vector<std::uint32_t>					m_file_checksums;			// Each file's entry in the checksum map or GCF_NO_CHECKSUM.
 
 	GCFHeader									m_gcf_header;
 	GCFDataBlockHeader							m_gcf_data_block_header;
 	std::uint32_t								m_fragmap_file_offset;			
 	std::vector<std::uint32_t>					m_frag_map;
+	std::unordered_map<std::uint32_t,extent_list_shared_ptr>	m_extents;	// The block chain of each file that has been opened.
+	index_cache_shared_ptr						m_p_index_cache;			// Optional on-disk cache of the parsed directory.
+	data_source_shared_ptr						m_p_source;					// The package data. A file is opened on first use.
+	bool										m_b_own_source;				// True if m_p_source is opened from m_filename.
+	block_cache_shared_ptr						m_p_block_cache;			// Optional cache of data blocks shared by the open files.
+	std::uint32_t								m_block_cache_owner;		// The package's owner id in the block cache.
+	std::uint32_t								m_prefetch_blocks;			// How many blocks sequential reads look ahead by.
+
+	std::uint64_t								m_checksum_map_offset;		// The offset of the GCFChecksumMapHeader, or zero if there isn't a checksum section.
+	bool										m_b_verify_reads;			// True if files check their checksums as they are read.
+	std::mutex									m_checksum_mutex;			// Mutex for the checksum tables.
+	ChecksumStatus								m_checksum_status;
+	std::vector<GCFChecksumMapEntry>			m_checksum_map;				// Read the first time a checksum is needed.
+	std::vector<std::uint32_t>					m_checksums;
+	std::vector<ChunkState>						m_chunk_state;				// The result of checking each checksum.
 
 
 	//-------------------------------------------------------------------------
@@ -446,36 +530,90 @@ private:
 
 public:
 	PackageGCF(const std::string & filename);
+
+									// Create a package that reads the GCF from a data source rather than a
+									// file, for example a memory buffer. The name is only used in messages.
+									// The index cache is not used.
+	PackageGCF(data_source_shared_ptr p_source,const std::string & name);
 	~PackageGCF(void);
 
 	const std::string &				get_filename() const				{return m_filename;}
 	std::uint32_t					get_blocksize() const				{return m_gcf_header.BlockSize;}
 	std::uint32_t					get_blockcount() const				{return m_gcf_header.BlockCount;}
 	std::uint32_t					get_first_block_offset() const		{return m_gcf_data_block_header.FirstBlockOffset;}
+	const char *					get_name(std::uint32_t offset) const{return m_names.data() + offset;}
+	const char *					get_file_name(std::uint32_t file_id,std::uint32_t & out_size) const	{out_size = m_file_names[file_id].size; return m_names.data() + m_file_names[file_id].offset;}
 	std::uint32_t					get_next_block(std::uint32_t index)	{return m_frag_map[index];}
-	std::uint32_t					get_block_index(std::uint32_t first_block,fileoffset offset);
+
+									// Get the block chain of a file as a list of extents. The list is built
+									// the first time it is asked for and then shared by every open file.
+	extent_list_shared_ptr			get_extents(std::uint32_t file_id,std::uint32_t first_block);
+	data_source_shared_ptr			get_source();
 
 	bool							get_file_info(	std::uint32_t		file_id,
 													std::uint32_t &		out_block_index,
 													std::uint32_t &		out_file_size );
 
+									// Get the path of each file, indexed by file id. Files are numbered by
+									// directory and by name within each directory.
+	void							list_files(std::vector<std::string> & out_paths) const;
+	std::uint32_t					get_file_count() const				{return static_cast<std::uint32_t>(m_file_sizes.size());}
+
+									// When this is set, each chunk of a file is checked against the GCF's
+									// checksums the first time that it is read and a damaged chunk makes
+									// the read fail.
+	void							set_verify_reads(bool b_verify)		{m_b_verify_reads = b_verify;}
+	bool							get_verify_reads() const			{return m_b_verify_reads;}
+
+									// Check every file against the GCF's checksums, spreading the work over
+									// 'thread_count' threads (0 means one per core). The paths of damaged
+									// files are added to 'p_out_damaged'. Returns -1 if any file is damaged
+									// or the checksums themselves are damaged. A GCF without checksums
+									// passes.
+	int								verify(	unsigned					thread_count = 0,
+											std::vector<std::string> *	p_out_damaged = nullptr );
+
+									// Check one chunk of a file against its checksum. Returns 0 if it is
+									// good or the GCF has no checksums.
+	int								check_chunk(std::uint32_t file_id,std::uint32_t chunk,const char * p_data,size_t size);
+	ChunkState						get_chunk_state(std::uint32_t file_id,std::uint32_t chunk);
+
+									// Set the cache that holds the parsed directory between runs. It must
+									// be set before the package is scanned. Passing nullptr disables it.
+	void							set_index_cache(index_cache_shared_ptr p_cache)	{m_p_index_cache = std::move(p_cache);}
+	index_cache_shared_ptr			get_index_cache() const				{return m_p_index_cache;}
+
+									// Set the cache that files read the package's data blocks through. The
+									// cache can be shared with other packages. Passing nullptr disables it.
+	void							set_block_cache(block_cache_shared_ptr p_cache);
+	block_cache_shared_ptr			get_block_cache();
+	std::uint32_t					get_block_cache_owner() const		{return m_block_cache_owner;}
+
+									// Files that are read sequentially ask the system to start reading the
+									// next 'block_count' blocks of their chain in the background, so that a
+									// fragmented file streams at close to the speed of a contiguous one.
+									// Zero turns prefetching off.
+	void							set_prefetch_blocks(std::uint32_t block_count)	{m_prefetch_blocks = block_count;}
+	std::uint32_t					get_prefetch_blocks() const			{return m_prefetch_blocks;}
+
 	//-------------------------------------------------------------------------
 	//	PACKAGE INTERFACE FUNCTIONS
 	//-------------------------------------------------------------------------
 	int								mount(MountPoint * p_mountpoint);
 	int								scan();
 	Attributes						attributes() const	{return ATTR_READ;}
+	int								for_each_entry(const package_entry_func & func);
 
 private:
-	void							scan_directory(	DirectoryInfo &			dirinfo,
-													std::uint32_t			entry_index,
-													DirectoryNode &			p_node );
+	int								scan_directory(DirectoryInfo & dirinfo);
 
-	int								mount_directory(MountPoint *			p_mountpoint,
-													const std::string &		path,
-													DirectoryNode &			dir_node );
+	std::uint32_t					add_file(const FileName & name,std::uint32_t size,std::uint32_t block_offset,std::uint32_t checksum_index);
+	ChecksumStatus					load_checksums();
+	std::uint32_t					get_checksum_slot(std::uint32_t file_id,std::uint32_t chunk) const;
+	std::vector<std::string>		directory_paths() const;
 
-	std::uint32_t					add_file(std::uint32_t size,std::uint32_t block_offset);
+	int								load_index(const IndexCache::Key & key);
+	void							store_index(const IndexCache::Key & key);
 
 };
 
@@ -489,7 +627,14 @@ private:
 
 class PackageFactoryGCF : public IPackageFactory
 {
+private:
+	index_cache_shared_ptr			m_p_index_cache;	// Index cache shared by all of the packages created by this factory.
+	block_cache_shared_ptr			m_p_block_cache;	// Block cache shared by all of the packages created by this factory.
+
 public:
+	void							set_index_cache(index_cache_shared_ptr p_cache)	{m_p_index_cache = std::move(p_cache);}
+	void							set_block_cache(block_cache_shared_ptr p_cache)	{m_p_block_cache = std::move(p_cache);}
+
 	std::string						name() const override			{return "GCF";}
 	std::string						description() const	override	{return "Valve GCF (Game Cache File)";}
 	std::vector<std::string>		file_types() const override		{std::vector<std::string> v;v.push_back("gcf");return v;}
@@ -0,0 +1,686 @@
+//=============================================================================
+//	FILE:					package_vpk.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Valve VPK packages.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+#include "package_vpk.h"
+#include "decompressor.h"
+
+namespace adefs { namespace package_vpk
+{
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+//	Put a path into the form that is held in the index: '/' separators, no
+//	leading '/' and case folded.
+//-----------------------------------------------------------------------------
+std::string
+fold_path(const std::string & path)
+{
+	std::string folded(path);
+
+	std::replace(folded.begin(),folded.end(),'\\','/');
+	folded.erase(0,folded.find_first_not_of('/'));
+	std::transform(folded.begin(),folded.end(),folded.begin(),::tolower);
+
+	return folded;
+}
+
+std::uint64_t
+hash_path(const char * p_path,size_t size)
+{
+	std::uint64_t hash = 0xCBF29CE484222325ull;
+
+	while(size--)
+		hash = (hash ^ static_cast<unsigned char>(*p_path++)) * 0x100000001B3ull;
+
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+//	Read a string from the tree. Returns nullptr if the string runs past the
+//	end of the tree.
+//-----------------------------------------------------------------------------
+const char *
+read_string(const char *& p_tree,const char * p_end,size_t & out_size)
+{
+	const char * p_string	= p_tree;
+	auto p_nul				= static_cast<const char *>(std::memchr(p_tree,0,static_cast<size_t>(p_end - p_tree)));
+
+	if(!p_nul)
+		return nullptr;
+
+	out_size	= static_cast<size_t>(p_nul - p_string);
+	p_tree		= p_nul + 1;
+
+	return p_string;
+}
+
+//-----------------------------------------------------------------------------
+//	Open a file for reading. It is mapped if possible.
+//-----------------------------------------------------------------------------
+data_source_shared_ptr
+open_source(const std::string & filename)
+{
+	auto p_map = std::make_shared<DataSourceMap>();
+	if(!p_map->open(filename))
+		return p_map;
+
+	auto p_file = std::make_shared<DataSourceFile>();
+	if(!p_file->open(filename))
+		return p_file;
+
+	return nullptr;
+}
+
+} // anonymous namespace
+
+//=============================================================================
+//
+//
+//	PACKAGE VPK - DIRECTORY CLASS
+//
+//
+//=============================================================================
+
+DirectoryVPK::DirectoryVPK(PackageVPK * p_package,std::uint32_t index,const std::string & path)
+	: m_p_package(p_package)
+	, m_index(index)
+	, m_prefix(path)
+{
+	assert(m_p_package);
+
+	if(!m_prefix.empty())
+		m_prefix.push_back('/');
+}
+
+std::int64_t
+DirectoryVPK::find(const std::string & filename) const
+{
+	return m_p_package->find(m_prefix + filename);
+}
+
+size_t
+DirectoryVPK::file_size(const std::string & filename)
+{
+	const auto index = find(filename);
+	if(index < 0)
+		return 0;
+
+	const FileInfo & info = m_p_package->m_files[static_cast<size_t>(index)];
+	return static_cast<size_t>(info.preload_size) + info.size;
+}
+
+Attributes
+DirectoryVPK::file_attr(const std::string & filename)
+{
+	return (find(filename) >= 0 ? ATTR_READ : 0);
+}
+
+bool
+DirectoryVPK::file_exists(const std::string & filename)
+{
+	return (find(filename) >= 0);
+}
+
+std::vector<std::string>
+DirectoryVPK::file_list()
+{
+	std::vector<std::string> files;
+
+	if(m_index >= m_p_package->m_directory_info.size())
+		return files;
+
+	const auto & directory = m_p_package->m_directory_info[m_index];
+
+	for(std::uint32_t i = 0;i < directory.file_count;++i)
+	{
+		const std::string path = m_p_package->get_path(m_p_package->m_files[m_p_package->m_directory_files[directory.first_file + i]]);
+		files.push_back(path.substr(path.find_last_of('/') + 1));
+	}
+
+	return files;
+}
+
+std::unique_ptr<IFile>
+DirectoryVPK::openfile(	const std::string & filename,
+						std::uint32_t		mode )
+{
+	if((mode & (MODE_WRITE | MODE_APPEND)) || !(mode & MODE_READ))
+		return nullptr;
+
+	const auto index = find(filename);
+	if(index < 0)
+		return nullptr;
+
+	return m_p_package->openfile(static_cast<std::uint32_t>(index),mode);
+}
+
+//=============================================================================
+//
+//
+//	PACKAGE VPK - PACKAGE CLASS
+//
+//
+//=============================================================================
+
+PackageVPK::PackageVPK(const std::string & filename)
+	: m_filename(filename)
+	, m_b_own_source(true)
+{
+	std::replace(m_filename.begin(),m_filename.end(),'\\','/');
+
+	//-------------------------------------------------------------------------
+	//	The archives of 'name_dir.vpk' are 'name_000.vpk' and so on. Other
+	//	packages only have the data in the directory file.
+	//-------------------------------------------------------------------------
+	static const std::string suffix("_dir.vpk");
+
+	std::string lower(m_filename);
+	std::transform(lower.begin(),lower.end(),lower.begin(),::tolower);
+
+	if((lower.size() > suffix.size()) && !lower.compare(lower.size() - suffix.size(),suffix.size(),suffix))
+		m_archive_prefix = m_filename.substr(0,m_filename.size() - suffix.size() + 1);
+}
+
+PackageVPK::PackageVPK(data_source_shared_ptr p_source,const std::string & name)
+	: PackageVPK(name)
+{
+	m_p_source		= std::move(p_source);
+	m_b_own_source	= false;
+}
+
+int
+PackageVPK::scan()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_directories.clear();
+	m_files.clear();
+	m_hash_table.clear();
+	m_directory_info.clear();
+	m_directory_files.clear();
+	m_names.clear();
+	m_p_tree.reset();
+	m_p_tree_data	= nullptr;
+	m_data_offset	= 0;
+
+	{
+		std::unique_lock<std::mutex> archive_lock(m_archive_mutex);
+		m_archives.clear();
+	}
+
+	if(m_b_own_source)
+		m_p_source = open_source(m_filename);
+
+	if(!m_p_source)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Read and validate the header.
+	//-------------------------------------------------------------------------
+	const std::uint64_t	filesize = m_p_source->size();
+	VPKHeader			header;
+
+	std::memset(&header,0,sizeof(header));
+
+	if(		(m_p_source->read_at(0,&header,VPK_HEADER_SIZE_V1) != VPK_HEADER_SIZE_V1)
+		||	(header.Signature != VPK_SIGNATURE)
+		||	((header.Version != 1) && (header.Version != 2)) )
+	{
+		std::clog << "PACKAGEVPK: '" << m_filename << "' is not a valid VPK file\n";
+		return -1;
+	}
+
+	const size_t header_size = (header.Version == 1 ? VPK_HEADER_SIZE_V1 : sizeof(VPKHeader));
+
+	if(		(m_p_source->read_at(0,&header,header_size) != header_size)
+		||	(header.TreeSize > filesize - header_size) )
+	{
+		std::clog << "PACKAGEVPK: '" << m_filename << "' is not a valid VPK file\n";
+		return -1;
+	}
+
+	//-------------------------------------------------------------------------
+	//	The tree is used in place if the directory file is in memory. The
+	//	preload bytes are given out as views of it.
+	//-------------------------------------------------------------------------
+	const char * p_tree = m_p_source->data();
+
+	if(p_tree)
+		p_tree += header_size;
+	else
+	{
+		m_p_tree = std::make_shared<std::vector<char>>(header.TreeSize);
+		if(m_p_source->read_at(header_size,m_p_tree->data(),m_p_tree->size()) != m_p_tree->size())
+			return -1;
+
+		p_tree = m_p_tree->data();
+	}
+
+	if(read_tree(p_tree,header.TreeSize))
+	{
+		std::clog << "PACKAGEVPK: The directory of '" << m_filename << "' is damaged\n";
+
+		m_files.clear();
+		m_directory_info.clear();
+		m_directory_files.clear();
+		m_names.clear();
+		m_p_tree.reset();
+		return -1;
+	}
+
+	m_p_tree_data	= p_tree;
+	m_data_offset	= header_size + header.TreeSize;
+
+	build_hash_table();
+
+	return 0;
+}
+
+int
+PackageVPK::read_tree(const char * p_tree,size_t tree_size)
+{
+	const char *							p_pos	= p_tree;
+	const char *							p_end	= p_tree + tree_size;
+	std::unordered_map<std::string,std::uint32_t>	directory_lookup;
+	std::vector<std::uint32_t>				file_directories;		// The directory of each file.
+	std::string								path;
+	size_t									size;
+
+	//-------------------------------------------------------------------------
+	//	The root always exists so that an empty package can be mounted.
+	//-------------------------------------------------------------------------
+	directory_lookup[std::string()] = 0;
+	m_directory_info.push_back(DirectoryInfo{0,0,0,0});
+
+	for(;;)
+	{
+		const char * p_extension = read_string(p_pos,p_end,size);
+		if(!p_extension)
+			return -1;
+
+		if(!size)
+			break;
+
+		const std::string extension((size == 1) && (*p_extension == ' ') ? std::string() : fold_path(std::string(p_extension,size)));
+
+		for(;;)
+		{
+			const char * p_path = read_string(p_pos,p_end,size);
+			if(!p_path)
+				return -1;
+
+			if(!size)
+				break;
+
+			//-----------------------------------------------------------------
+			//	Find the directory, adding it the first time it is seen. Its
+			//	files are usually spread over several extensions.
+			//-----------------------------------------------------------------
+			std::string directory_path((size == 1) && (*p_path == ' ') ? std::string() : fold_path(std::string(p_path,size)));
+
+			while(!directory_path.empty() && (directory_path.back() == '/'))
+				directory_path.pop_back();
+
+			auto ifind = directory_lookup.find(directory_path);
+			if(ifind == directory_lookup.end())
+			{
+				ifind = directory_lookup.emplace(directory_path,static_cast<std::uint32_t>(m_directory_info.size())).first;
+				m_directory_info.push_back(DirectoryInfo{static_cast<std::uint32_t>(m_names.size()),static_cast<std::uint32_t>(directory_path.size()),0,0});
+				m_names += directory_path;
+			}
+
+			const std::uint32_t directory = ifind->second;
+
+			for(;;)
+			{
+				const char * p_name = read_string(p_pos,p_end,size);
+				if(!p_name)
+					return -1;
+
+				if(!size)
+					break;
+
+				VPKDirectoryEntry entry;
+
+				if(static_cast<size_t>(p_end - p_pos) < sizeof(entry))
+					return -1;
+
+				std::memcpy(&entry,p_pos,sizeof(entry));
+				p_pos += sizeof(entry);
+
+				if(		(entry.Terminator != VPK_TERMINATOR)
+					||	(static_cast<size_t>(p_end - p_pos) < entry.PreloadBytes) )
+					return -1;
+
+				path.assign(directory_path);
+				if(!path.empty())
+					path.push_back('/');
+
+				path += fold_path(std::string(p_name,size));
+
+				if(!extension.empty())
+				{
+					path.push_back('.');
+					path += extension;
+				}
+
+				FileInfo info;
+				info.hash			= hash_path(path.data(),path.size());
+				info.name_offset	= static_cast<std::uint32_t>(m_names.size());
+				info.name_size		= static_cast<std::uint32_t>(path.size());
+				info.preload_offset	= static_cast<std::uint32_t>(p_pos - p_tree);
+				info.crc			= entry.CRC;
+				info.offset			= entry.EntryOffset;
+				info.size			= entry.EntryLength;
+				info.preload_size	= entry.PreloadBytes;
+				info.archive		= entry.ArchiveIndex;
+
+				m_names += path;
+				m_files.push_back(info);
+				file_directories.push_back(directory);
+
+				p_pos += entry.PreloadBytes;
+			}
+		}
+	}
+
+	if(m_names.size() > UINT32_MAX)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Group the files by directory.
+	//-------------------------------------------------------------------------
+	for(auto directory : file_directories)
+		++m_directory_info[directory].file_count;
+
+	std::uint32_t first_file = 0;
+	for(auto & directory : m_directory_info)
+	{
+		directory.first_file	= first_file;
+		first_file				+= directory.file_count;
+		directory.file_count	= 0;
+	}
+
+	m_directory_files.resize(m_files.size());
+
+	for(std::uint32_t index = 0;index < file_directories.size();++index)
+	{
+		auto & directory = m_directory_info[file_directories[index]];
+		m_directory_files[directory.first_file + directory.file_count++] = index;
+	}
+
+	return 0;
+}
+
+void
+PackageVPK::build_hash_table()
+{
+	//-------------------------------------------------------------------------
+	//	The table is kept at most half full so that probes stay short. If a
+	//	path is listed twice then the later file is the one that is found.
+	//-------------------------------------------------------------------------
+	size_t table_size = 16;
+	while(table_size < m_files.size() * 2)
+		table_size *= 2;
+
+	m_hash_table.assign(table_size,0);
+
+	const size_t mask = table_size - 1;
+
+	for(std::uint32_t index = 0;index < m_files.size();++index)
+	{
+		const FileInfo &	info = m_files[index];
+		size_t				slot = static_cast<size_t>(info.hash) & mask;
+
+		while(m_hash_table[slot])
+		{
+			const FileInfo & other = m_files[m_hash_table[slot] - 1];
+
+			if(		(other.hash == info.hash)
+				&&	(other.name_size == info.name_size)
+				&&	!m_names.compare(other.name_offset,other.name_size,m_names,info.name_offset,info.name_size) )
+				break;
+
+			slot = (slot + 1) & mask;
+		}
+
+		m_hash_table[slot] = index + 1;
+	}
+}
+
+std::int64_t
+PackageVPK::find(const std::string & path) const
+{
+	if(m_hash_table.empty())
+		return -1;
+
+	const std::string	folded	= fold_path(path);
+	const std::uint64_t	hash	= hash_path(folded.data(),folded.size());
+	const size_t		mask	= m_hash_table.size() - 1;
+
+	for(size_t slot = static_cast<size_t>(hash) & mask;m_hash_table[slot];slot = (slot + 1) & mask)
+	{
+		const FileInfo & info = m_files[m_hash_table[slot] - 1];
+
+		if(		(info.hash == hash)
+			&&	(info.name_size == folded.size())
+			&&	!m_names.compare(info.name_offset,info.name_size,folded) )
+			return m_hash_table[slot] - 1;
+	}
+
+	return -1;
+}
+
+int
+PackageVPK::mount(MountPoint * p_mountpoint)
+{
+	if(!p_mountpoint)
+		return -1;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//-------------------------------------------------------------------------
+	//	The directories are created the first time that the package is
+	//	mounted. The mountpoints only hold weak pointers so the package keeps
+	//	them.
+	//-------------------------------------------------------------------------
+	if(m_directories.empty())
+	{
+		for(std::uint32_t index = 0;index < m_directory_info.size();++index)
+		{
+			const auto & directory = m_directory_info[index];
+			m_directories.push_back(std::make_shared<DirectoryVPK>(this,index,m_names.substr(directory.name_offset,directory.name_size)));
+		}
+	}
+
+	bool err = false;
+
+	for(auto & p_dir : m_directories)
+	{
+		const DirectoryVPK & dir = *static_cast<DirectoryVPK *>(p_dir.get());
+		err |= !!p_mountpoint->mount(dir.get_path(),p_dir);
+	}
+
+	return (int)err;
+}
+
+data_source_shared_ptr
+PackageVPK::get_archive(std::uint16_t archive)
+{
+	if(archive == VPK_DIR_ARCHIVE)
+		return m_p_source;
+
+	if(m_archive_prefix.empty())
+		return nullptr;
+
+	std::unique_lock<std::mutex> lock(m_archive_mutex);
+
+	if(archive >= m_archives.size())
+		m_archives.resize(archive + 1);
+
+	auto & p_archive = m_archives[archive];
+
+	if(!p_archive)
+	{
+		char number[8];
+		std::snprintf(number,sizeof(number),"%03u",static_cast<unsigned>(archive));
+
+		p_archive = open_source(m_archive_prefix + number + ".vpk");
+		if(!p_archive)
+			std::clog << "PACKAGEVPK: Failed to open archive " << number << " of '" << m_filename << "'\n";
+	}
+
+	return p_archive;
+}
+
+std::unique_ptr<IFile>
+PackageVPK::openfile(std::uint32_t index,std::uint32_t mode)
+{
+	std::unique_ptr<IFile> p_file;
+
+	const FileInfo * p_info = get_file_info(index);
+	if(!p_info || !m_p_tree_data)
+		return p_file;
+
+	const FileInfo &	info		= *p_info;
+	const char *		p_preload	= m_p_tree_data + info.preload_offset;
+	const size_t		size		= static_cast<size_t>(info.preload_size) + info.size;
+
+	try
+	{
+		//---------------------------------------------------------------------
+		//	Files that are held completely in the tree are views of it.
+		//---------------------------------------------------------------------
+		if(!info.size)
+		{
+			std::shared_ptr<const void> p_owner(m_p_tree ? std::static_pointer_cast<const void>(m_p_tree) : std::static_pointer_cast<const void>(m_p_source));
+			p_file = std::make_unique<FileMemoryView>(p_owner,p_preload,size);
+		}
+		else
+		{
+			auto				p_source	= get_archive(info.archive);
+			const std::uint64_t	offset		= info.offset + (info.archive == VPK_DIR_ARCHIVE ? m_data_offset : 0);
+
+			if(		!p_source
+				||	(offset > p_source->size())
+				||	(info.size > p_source->size() - offset) )
+				return p_file;
+
+			//-----------------------------------------------------------------
+			//	Files with no preload bytes are used straight from a mapped
+			//	archive. Otherwise the two parts are put together in memory.
+			//-----------------------------------------------------------------
+			if(!info.preload_size && p_source->data())
+				p_file = std::make_unique<FileMemoryView>(p_source,p_source->data() + offset,size);
+			else
+			{
+				std::vector<char> data(size);
+
+				std::memcpy(data.data(),p_preload,info.preload_size);
+				if(p_source->read_at(offset,data.data() + info.preload_size,info.size) != info.size)
+					return p_file;
+
+				auto p_new_file = std::make_unique<FileInMemory>(MODE_READ);
+				p_new_file->swap(data);
+				p_file = std::move(p_new_file);
+			}
+		}
+
+		if(mode & MODE_AT_END)
+			p_file->seek(static_cast<filepos>(size));
+	}
+	catch(...){}
+
+	return p_file;
+}
+
+int
+PackageVPK::for_each_entry(const package_entry_func & func)
+{
+	//-------------------------------------------------------------------------
+	//	Visit the files archive by archive in the order that their data is
+	//	stored.
+	//-------------------------------------------------------------------------
+	std::vector<std::uint32_t> order(m_files.size());
+	std::iota(order.begin(),order.end(),0);
+
+	std::sort(order.begin(),order.end(),[&](std::uint32_t a,std::uint32_t b)
+	{
+		const FileInfo & info_a = m_files[a];
+		const FileInfo & info_b = m_files[b];
+
+		return (info_a.archive != info_b.archive ? info_a.archive < info_b.archive : info_a.offset < info_b.offset);
+	});
+
+	int result = 0;
+
+	for(auto index : order)
+	{
+		const FileInfo & info = m_files[index];
+
+		auto p_file = openfile(index);
+		if(!p_file)
+		{
+			result = -1;
+			continue;
+		}
+
+		PackageEntry entry;
+		entry.path			= get_path(info);
+		entry.size			= static_cast<std::uint64_t>(info.preload_size) + info.size;
+		entry.stored_size	= entry.size;
+		entry.offset		= info.offset;
+		entry.compression	= COMPRESSION_STORE;
+		entry.crc			= info.crc;
+
+		const int func_result = func(entry,*p_file);
+		if(func_result)
+			return func_result;
+	}
+
+	return result;
+}
+
+//=============================================================================
+//
+//
+//	PACKAGE VPK - FACTORY CLASS
+//
+//
+//=============================================================================
+
+bool
+PackageFactoryVPK::is_supported(const std::string & path)
+{
+	auto pos = path.find_last_of(".");
+
+	if(pos == std::string::npos)
+		return false;
+
+	std::string ext(path.substr(pos+1));
+	std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+	return !!(ext == "vpk");
+}
+
+package_shared_ptr
+PackageFactoryVPK::create_package(const std::string & path)
+{
+	return std::make_shared<PackageVPK>(path);
+}
+
+}} // namespace package_vpk, adefs
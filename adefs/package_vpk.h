@@ -0,0 +1,260 @@
+//=============================================================================
+//	FILE:					package_vpk.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Valve VPK packages.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+//
+//	A VPK is a directory file, usually named 'name_dir.vpk', and a number of
+//	data archives named 'name_000.vpk', 'name_001.vpk' and so on.
+//
+//		Header				VPKHeader. Version 1 only has the first three
+//							fields.
+//		Tree				The files grouped by extension and then by path:
+//
+//								extension \0
+//									path \0
+//										filename \0 VPKDirectoryEntry preload
+//										...
+//										\0
+//									...
+//									\0
+//								...
+//								\0
+//
+//							A path or extension of a single space means that
+//							there isn't one. The first 'PreloadBytes' of each
+//							file are stored in the tree after its entry.
+//		Data				Files with an ArchiveIndex of VPK_DIR_ARCHIVE are
+//							stored in the directory file after the tree.
+//
+//	The rest of each file is 'EntryLength' bytes at 'EntryOffset' in its data
+//	archive. Files are not compressed.
+//
+//=============================================================================
+#ifndef GUARD_ADEFS_PACKAGE_VPK_H
+#define GUARD_ADEFS_PACKAGE_VPK_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include "adefs.h"
+#include "data_source.h"
+
+namespace adefs { namespace package_vpk
+{
+
+//=============================================================================
+//
+//
+//	PACKAGE VPK - STRUCTURES
+//
+//
+//=============================================================================
+
+#pragma pack(push,1)
+
+//-----------------------------------------------------------------------------
+//	VPK Header
+//-----------------------------------------------------------------------------
+struct VPKHeader
+{
+	std::uint32_t Signature;				// VPK_SIGNATURE
+	std::uint32_t Version;					// 1 or 2.
+	std::uint32_t TreeSize;					// The size of the directory tree in bytes.
+	std::uint32_t FileDataSectionSize;		// Version 2. The size of the file data stored in the directory file.
+	std::uint32_t ArchiveMD5SectionSize;	// Version 2. The size of the MD5 checksums of the archives.
+	std::uint32_t OtherMD5SectionSize;		// Version 2. The size of the MD5 checksums of the tree and the archive checksums.
+	std::uint32_t SignatureSectionSize;		// Version 2. The size of the public key and signature.
+};
+
+//-----------------------------------------------------------------------------
+//	VPK Directory Entry
+//-----------------------------------------------------------------------------
+struct VPKDirectoryEntry
+{
+	std::uint32_t CRC;						// CRC-32 of the whole file.
+	std::uint16_t PreloadBytes;				// The number of bytes of the file stored in the tree after this entry.
+	std::uint16_t ArchiveIndex;				// The data archive that holds the rest of the file.
+	std::uint32_t EntryOffset;				// The offset of the rest of the file in the archive.
+	std::uint32_t EntryLength;				// The size of the rest of the file.
+	std::uint16_t Terminator;				// Always VPK_TERMINATOR.
+};
+
+#pragma pack(pop)
+
+static const std::uint32_t	VPK_SIGNATURE		= 0x55AA1234;
+static const size_t			VPK_HEADER_SIZE_V1	= 12;			// Version 1 headers stop after TreeSize.
+static const std::uint16_t	VPK_DIR_ARCHIVE		= 0x7FFF;		// The file's data follows the tree in the directory file.
+static const std::uint16_t	VPK_TERMINATOR		= 0xFFFF;
+
+//-----------------------------------------------------------------------------
+//	A file in the package. The paths are held in the package's name pool.
+//-----------------------------------------------------------------------------
+struct FileInfo
+{
+	std::uint64_t					hash;				// The hash of the path.
+	std::uint32_t					name_offset;		// The offset of the path in the names.
+	std::uint32_t					name_size;			// The length of the path.
+	std::uint32_t					preload_offset;		// The offset of the preload bytes in the tree.
+	std::uint32_t					crc;				// CRC-32 of the file.
+	std::uint32_t					offset;				// The offset of the rest of the file in its archive.
+	std::uint32_t					size;				// The size of the rest of the file.
+	std::uint16_t					preload_size;		// The number of bytes stored in the tree.
+	std::uint16_t					archive;			// The archive holding the rest of the file.
+};
+
+//=============================================================================
+//
+//
+//	PACKAGE VPK - DIRECTORY CLASS
+//
+//	A directory only holds its path. Files are found by hashing the full
+//	path and looking it up in the package's index.
+//
+//=============================================================================
+class DirectoryVPK : public IDirectory
+{
+private:
+	class PackageVPK *				m_p_package;		// The package that owns this directory.
+	std::uint32_t					m_index;			// The index of the directory in the package.
+	std::string						m_prefix;			// The path of the directory followed by '/', or empty for the root.
+
+	DirectoryVPK(void);
+	DirectoryVPK(const DirectoryVPK & x);
+	DirectoryVPK & operator=(const DirectoryVPK & x);
+
+	std::int64_t					find(const std::string & filename) const;
+
+public:
+	DirectoryVPK(class PackageVPK * p_package,std::uint32_t index,const std::string & path);
+	~DirectoryVPK() = default;
+
+									// The path of the directory within the package.
+	std::string						get_path() const	{return m_prefix.substr(0,m_prefix.empty() ? 0 : m_prefix.size() - 1);}
+
+	//-------------------------------------------------------------------------
+	//	INTERFACE FUNCTIONS
+	//-------------------------------------------------------------------------
+	size_t							file_size(const std::string & filename);
+	Attributes						file_attr(const std::string & filename);
+	Attributes						dir_attr() {return ATTR_READ;}
+	bool							file_exists(const std::string & filename);
+	std::vector<std::string>		file_list();
+	std::unique_ptr<IFile>			openfile(	const std::string & filename,
+												std::uint32_t		mode = MODE_READ );
+};
+
+//=============================================================================
+//
+//
+//	PACKAGE VPK - PACKAGE CLASS
+//
+//	The tree is read in one pass into a table of files, a pool of their
+//	paths and a hash table that indexes the files by path.
+//
+//	Each data archive is opened the first time that a file in it is read and
+//	is then shared by every file read from it. Archives are mapped where
+//	possible so that files are used straight from the mapping, otherwise they
+//	are read with pread(). Files that are held completely in the tree are
+//	used in place.
+//
+//=============================================================================
+
+class PackageVPK : public IPackage
+{
+private:
+	struct DirectoryInfo
+	{
+		std::uint32_t				name_offset;		// The offset of the path in the names.
+		std::uint32_t				name_size;			// The length of the path. Zero for the root.
+		std::uint32_t				first_file;			// The first of the directory's files in m_directory_files.
+		std::uint32_t				file_count;			// The number of files in the directory.
+	};
+
+	std::string									m_filename;
+	std::string									m_archive_prefix;	// Archive 'n' is m_archive_prefix + "nnn.vpk". Empty if there are no archives.
+	std::mutex									m_mutex;			// Mutex for exclusive access.
+	data_source_shared_ptr						m_p_source;			// The directory file.
+	bool										m_b_own_source;		// True if m_p_source is opened from m_filename.
+	std::shared_ptr<std::vector<char>>			m_p_tree;			// A copy of the tree if the source is not in memory.
+	const char *								m_p_tree_data		= nullptr;
+	std::uint64_t								m_data_offset		= 0;	// The offset of the data that follows the tree.
+	std::vector<FileInfo>						m_files;
+	std::vector<std::uint32_t>					m_hash_table;		// Index + 1 of the file in each slot, 0 if empty.
+	std::vector<DirectoryInfo>					m_directory_info;
+	std::vector<std::uint32_t>					m_directory_files;	// The files in each directory.
+	std::string									m_names;			// The paths of the files and directories.
+	std::mutex									m_archive_mutex;	// Mutex for opening archives.
+	std::vector<data_source_shared_ptr>			m_archives;			// The data archives that have been opened.
+	std::vector<directory_shared_ptr>			m_directories;		// The mounted directories.
+
+	PackageVPK(void);
+	PackageVPK(const PackageVPK &);
+	PackageVPK & operator=(const PackageVPK &);
+
+public:
+	PackageVPK(const std::string & filename);
+
+									// Create a package that reads its directory from a data source rather
+									// than a file. The data archives are still opened from files named
+									// after 'name'.
+	PackageVPK(data_source_shared_ptr p_source,const std::string & name);
+	~PackageVPK(void) = default;
+
+	const std::string &				get_filename() const				{return m_filename;}
+	std::uint32_t					get_file_count() const				{return static_cast<std::uint32_t>(m_files.size());}
+
+									// Find a file by its path. The path does not have to be case folded.
+									// Returns -1 if the file is not in the package.
+	std::int64_t					find(const std::string & path) const;
+	const FileInfo *				get_file_info(std::uint32_t index) const	{return (index < m_files.size() ? &m_files[index] : nullptr);}
+	std::string						get_path(const FileInfo & info) const		{return m_names.substr(info.name_offset,info.name_size);}
+	std::unique_ptr<IFile>			openfile(std::uint32_t index,std::uint32_t mode = MODE_READ);
+
+									// Get a data archive, opening it if it has not been opened yet.
+	data_source_shared_ptr			get_archive(std::uint16_t archive);
+
+	//-------------------------------------------------------------------------
+	//	PACKAGE INTERFACE FUNCTIONS
+	//-------------------------------------------------------------------------
+	int								mount(MountPoint * p_mountpoint);
+	int								scan();
+	Attributes						attributes() const	{return ATTR_READ;}
+	int								for_each_entry(const package_entry_func & func);
+
+private:
+	friend class DirectoryVPK;
+
+	int								read_tree(const char * p_tree,size_t tree_size);
+	void							build_hash_table();
+};
+
+//=============================================================================
+//
+//
+//	PACKAGE FACTORY CLASS
+//
+//
+//=============================================================================
+
+class PackageFactoryVPK : public IPackageFactory
+{
+public:
+	std::string						name() const override			{return "VPK";}
+	std::string						description() const	override	{return "Valve VPK (Valve Pak)";}
+	std::vector<std::string>		file_types() const override		{std::vector<std::string> v;v.push_back("vpk");return v;}
+
+	bool							is_supported(const std::string & path) override;
+	package_shared_ptr				create_package(const std::string & path) override;
+};
+
+}} // namespace package_vpk, adefs
+
+#endif // ! defined GUARD_ADEFS_PACKAGE_VPK_H
@@ -13,19 +13,6 @@
 #include <cstring>
 #include "package_zip.h"
 //#include "debug.h"
-//#include "inflate.h"
-
-//#define PKGZIP_INFLATE_ZLIB
-//#define HAVE_ZLIB
-
-
-#ifdef HAVE_ZLIB
-	extern "C"
-	{
-		#include <zlib.h>
-	}
-	#pragma comment(lib, "zlib.lib")
-#endif
 
 
 namespace adefs { namespace package_zip
@@ -39,58 +26,48 @@ namespace adefs { namespace package_zip
 //
 //=============================================================================
 
-FileZIPStore::FileZIPStore(void)
-	: m_count(0)
-{
-}
-
 int
-FileZIPStore::open(	const std::string &	zip_filename,
-					const FileInfo &	fileinfo,
-					std::uint32_t		mode  )
+FileZIPStore::open(	data_source_shared_ptr	p_source,
+					const FileInfo &		fileinfo,
+					std::uint32_t			mode  )
 {
 	if(		is_open()
+		||	!p_source
 		||	(fileinfo.compression_method != ZIP_UNCOMPRESSED) )
 		return -1;
 
-	m_zip_file.open(zip_filename.c_str(),std::ios_base::in | std::ios_base::binary);
-	if(!m_zip_file.is_open())
-		return -1;
-	
-	seek(0,(mode & MODE_AT_END) ? adefs::Seek::END : adefs::Seek::BEGINNING);
-	m_fileinfo = fileinfo;
+	m_p_source	= std::move(p_source);
+	m_fileinfo	= fileinfo;
+	m_position	= (mode & MODE_AT_END ? static_cast<std::uint64_t>(fileinfo.size_uncompressed) : 0);
 
 	return 0;
 }
 
-FileZIPStore::~FileZIPStore(void)
-{
-	m_zip_file.close();
-}
-
 int
 FileZIPStore::get()
 {
-	return (is_eof() || is_fail() ? EOF : m_zip_file.get());
+	char c;
+	return (read(&c,1) ? static_cast<unsigned char>(c) : EOF);
 }
 
 size_t
 FileZIPStore::read(char * p_buffer,size_t size)
 {
-	if(is_fail() || is_eof())
-		return 0;
-
-	auto pos = (std::int32_t)m_zip_file.tellg();
+	m_count = 0;
 
-	if(pos < m_fileinfo.file_offset)
+	if(!p_buffer || is_fail() || is_eof())
 		return 0;
 
-	const size_t avail = m_fileinfo.size_uncompressed - (pos - m_fileinfo.file_offset);
+	const std::uint64_t avail = static_cast<std::uint64_t>(m_fileinfo.size_uncompressed) - m_position;
 
 	if(size > avail)
-		size = avail;
+		size = static_cast<size_t>(avail);
 
-	return static_cast<size_t>(m_zip_file.read(p_buffer,size).gcount());
+	m_count		= m_p_source->read_at(static_cast<std::uint64_t>(m_fileinfo.file_offset) + m_position,p_buffer,size);
+	m_position	+= m_count;
+	m_b_fail	= (m_count != size);
+
+	return m_count;
 }
 
 void
@@ -101,59 +78,193 @@ FileZIPStore::write(const char * /*p_data*/,size_t /*size*/)
 void
 FileZIPStore::ignore(size_t count,int delimeter)
 {
-	m_zip_file.ignore(count,delimeter);
+	if(delimeter < 0)
+		seek(static_cast<filepos>(m_position + std::min<std::uint64_t>(count,size())));
+	else
+	{
+		while(count-- && !is_eof() && !is_fail())
+			if(get() == delimeter)
+				break;
+	}
 }
 
 void
 FileZIPStore::seek(filepos pos)
 {
-	m_zip_file.seekg(m_fileinfo.file_offset + pos,m_zip_file.beg);
+	m_position = std::min<std::uint64_t>(pos,static_cast<std::uint64_t>(m_fileinfo.size_uncompressed));
 }
 
 void
 FileZIPStore::seek(fileoffset offset,adefs::Seek dir)
 {
+	fileoffset pos;
+
 	switch(dir)
 	{
-		//---------------------------------------------------------------------
-		case adefs::Seek::BEGINNING :	
-		//---------------------------------------------------------------------
-			m_zip_file.seekg(m_fileinfo.file_offset + offset,m_zip_file.beg); 
-			break;
+		case adefs::Seek::BEGINNING :	pos = offset;											break;
+		case adefs::Seek::CURRENT :		pos = static_cast<fileoffset>(m_position) + offset;	break;
+		case adefs::Seek::END :			pos = static_cast<fileoffset>(m_fileinfo.size_uncompressed) + offset;	break;
+		default :						return;
+	}
 
-		//---------------------------------------------------------------------
-		case adefs::Seek::CURRENT :	
-		//---------------------------------------------------------------------
-			{
-				fileoffset pos = static_cast<fileoffset>(tell()) + offset;
-				if(pos <0) 
-					pos = 0;
-				else if(pos > m_fileinfo.size_uncompressed)
-					pos = m_fileinfo.size_uncompressed;
+	seek(static_cast<filepos>(pos < 0 ? 0 : pos));
+}
 
-				m_zip_file.seekg(m_fileinfo.file_offset + pos,m_zip_file.beg);
-			}
-			break;
 
+//=============================================================================
+//
+//
+//	PACKAGE ZIP - FILE CLASS (STREAM)
+//
+//
+//=============================================================================
+
+int
+FileZIPStream::open(data_source_shared_ptr		p_source,
+					const FileInfo &			fileinfo,
+					decompressor_unique_ptr		p_decompressor,
+					std::uint32_t				mode )
+{
+	if(		m_p_source
+		||	!p_source
+		||	!p_decompressor
+		||	!p_decompressor->can_stream() )
+		return -1;
+
+	m_p_source			= std::move(p_source);
+	m_fileinfo			= fileinfo;
+	m_p_decompressor	= std::move(p_decompressor);
+	m_input.resize(std::min<size_t>(INPUT_SIZE,fileinfo.size_compressed));
+
+	if(restart())
+		return -1;
+
+	if(mode & MODE_AT_END)
+		seek(0,adefs::Seek::END);
+
+	return (m_b_fail ? -1 : 0);
+}
+
+int
+FileZIPStream::restart()
+{
+	m_p_in		= nullptr;
+	m_in_avail	= 0;
+	m_consumed	= 0;
+	m_position	= 0;
+	m_b_fail	= !!m_p_decompressor->begin();
+
+	return (m_b_fail ? -1 : 0);
+}
+
+size_t
+FileZIPStream::decode(char * p_buffer,size_t size)
+{
+	std::uint8_t	discard[4096];			// Used when decoding is only being done to skip forwards.
+	size_t			total = 0;
+
+	while((total < size) && !m_b_fail)
+	{
 		//---------------------------------------------------------------------
-		case adefs::Seek::END :	
+		//	Refill the input buffer from the package once it has been used up.
 		//---------------------------------------------------------------------
-			{
-				fileoffset pos = m_fileinfo.size_uncompressed - offset;
-				if(pos <0) 
-					pos = 0;
-				else if(pos > m_fileinfo.size_uncompressed)
-					pos = m_fileinfo.size_uncompressed;
+		if(!m_in_avail)
+		{
+			const size_t remaining = m_fileinfo.size_compressed - m_consumed;
+			if(!remaining)
+				break;
 
-				m_zip_file.seekg(m_fileinfo.file_offset + pos,m_zip_file.beg);
+			const size_t readsize = m_p_source->read_at(	static_cast<std::uint64_t>(m_fileinfo.file_offset) + m_consumed,
+															m_input.data(),
+															std::min(remaining,m_input.size()) );
+			if(!readsize)
+			{
+				m_b_fail = true;
+				break;
 			}
-			break;
 
-		//---------------------------------------------------------------------
-		default : 
-		//---------------------------------------------------------------------
-			break;
+			m_consumed	+= readsize;
+			m_p_in		= reinterpret_cast<const std::uint8_t *>(m_input.data());
+			m_in_avail	= readsize;
+		}
+
+		std::uint8_t *	p_out		= (p_buffer ? reinterpret_cast<std::uint8_t *>(p_buffer) + total : discard);
+		size_t			out_avail	= (p_buffer ? size - total : std::min(sizeof(discard),size - total));
+		const size_t	out_size	= out_avail;
+		const size_t	in_size		= m_in_avail;
+
+		const int result = m_p_decompressor->stream(m_p_in,m_in_avail,p_out,out_avail);
+
+		total		+= (out_size - out_avail);
+		m_position	+= (out_size - out_avail);
+
+		if(result < 0)
+			m_b_fail = true;
+		else if((out_size == out_avail) && (in_size == m_in_avail) && (m_in_avail || (result > 0)))
+			break;			// No progress can be made.
+	}
+
+	//-------------------------------------------------------------------------
+	//	Nothing asks for more than the rest of the file, so stopping short
+	//	means that the entry is truncated or damaged.
+	//-------------------------------------------------------------------------
+	if(total < size)
+		m_b_fail = true;
+
+	return total;
+}
+
+size_t
+FileZIPStream::read(char * p_buffer,size_t size)
+{
+	m_count = 0;
+
+	if(!p_buffer || is_fail() || is_eof())
+		return 0;
+
+	m_count = decode(p_buffer,std::min(size,this->size() - m_position));
+
+	return m_count;
+}
+
+void
+FileZIPStream::ignore(size_t count,int delimeter)
+{
+	if(delimeter < 0)
+		decode(nullptr,std::min(count,size() - m_position));
+	else
+	{
+		while(count-- && !is_eof() && !is_fail())
+			if(get() == delimeter)
+				break;
+	}
+}
+
+void
+FileZIPStream::seek(filepos pos)
+{
+	const size_t target = std::min<size_t>(pos,size());
+
+	if(target < m_position)
+		restart();
+
+	decode(nullptr,target - m_position);
+}
+
+void
+FileZIPStream::seek(fileoffset offset,adefs::Seek dir)
+{
+	fileoffset pos;
+
+	switch(dir)
+	{
+		case adefs::Seek::BEGINNING :	pos = offset;											break;
+		case adefs::Seek::CURRENT :		pos = static_cast<fileoffset>(m_position) + offset;	break;
+		case adefs::Seek::END :			pos = static_cast<fileoffset>(m_fileinfo.size_uncompressed) + offset;	break;
+		default :						return;
 	}
+
+	seek(static_cast<filepos>(pos < 0 ? 0 : pos));
 }
 
 
@@ -191,6 +302,57 @@ DirectoryZIP::add_file(	const std::string & filename,
 	}
 }
 
+void
+DirectoryZIP::write_index(IndexWriter & writer) const
+{
+	writer.write(static_cast<std::uint32_t>(m_files.size()));
+
+	for(auto & file : m_files)
+	{
+		writer.write_string(file.first);
+		writer.write(file.second);
+	}
+}
+
+int
+DirectoryZIP::read_index(IndexReader & reader)
+{
+	std::uint32_t	count = 0;
+	std::string		name;
+	std::int32_t	id;
+
+	if(!reader.read(count))
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	The names were written in order and are already in lower case, so each
+	//	one can be added straight onto the end of the map.
+	//-------------------------------------------------------------------------
+	while(count--)
+	{
+		if(!reader.read_string(name) || !reader.read(id))
+			return -1;
+
+		m_files.emplace_hint(m_files.end(),std::move(name),id);
+	}
+
+	return 0;
+}
+
+void
+DirectoryZIP::for_each_file(const std::function<void(const std::string & name,std::int32_t id)> & func) const
+{
+	for(auto & file : m_files)
+		func(file.first,file.second);
+}
+
+std::int32_t
+DirectoryZIP::find_file(const std::string & filename)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return get_file_id(filename);
+}
+
 int
 DirectoryZIP::get_file_id(const std::string & filename)
 {
@@ -296,11 +458,61 @@ DirectoryZIP::openfile(	const std::string & filename,
 
 PackageZIP::PackageZIP(const std::string & filename)
 	: m_filename(filename)
+	, m_cache_owner(EntryCache::new_owner())
+	, m_p_buffer_pool(BufferPool::instance())
+	, m_b_own_source(true)
+{
+}
+
+PackageZIP::PackageZIP(data_source_shared_ptr p_source,const std::string & name)
+	: m_filename(name)
+	, m_cache_owner(EntryCache::new_owner())
+	, m_p_buffer_pool(BufferPool::instance())
+	, m_p_source(std::move(p_source))
+	, m_b_own_source(false)
 {
 }
 
 PackageZIP::~PackageZIP(void)
 {
+	if(m_p_entry_cache)
+		m_p_entry_cache->erase_owner(m_cache_owner);
+}
+
+void
+PackageZIP::set_entry_cache(entry_cache_shared_ptr p_cache)
+{
+	if(m_p_entry_cache && (m_p_entry_cache != p_cache))
+		m_p_entry_cache->erase_owner(m_cache_owner);
+
+	m_p_entry_cache = std::move(p_cache);
+}
+
+void
+PackageZIP::set_buffer_pool(buffer_pool_shared_ptr p_pool)
+{
+	m_p_buffer_pool = (p_pool ? std::move(p_pool) : BufferPool::instance());
+}
+
+data_source_shared_ptr
+PackageZIP::get_source()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//-------------------------------------------------------------------------
+	//	The package file is opened the first time it is needed and then kept
+	//	open for the life of the package.
+	//-------------------------------------------------------------------------
+	if(!m_p_source && m_b_own_source)
+	{
+		auto p_source = std::make_shared<DataSourceFile>();
+		if(p_source->open(m_filename))
+			return nullptr;
+
+		m_p_source = std::move(p_source);
+	}
+
+	return m_p_source;
 }
 
 
@@ -357,28 +569,43 @@ PackageZIP::mount_directory(MountPoint *			p_mountpoint,
 int
 PackageZIP::scan()
 {
-	int count = 0;
-
 	//-------------------------------------------------------------------------
 	//	Reset the current contents.
 	//-------------------------------------------------------------------------
+	m_file_info.clear();
 	m_root_directory.sub_directories.clear();
 	m_root_directory.p_directory = std::make_shared<DirectoryZIP>(this);
 
 	//-------------------------------------------------------------------------
-	//	Open the package file.
+	//	Open the package file. It is reopened in case it has changed since it
+	//	was last scanned.
+	//-------------------------------------------------------------------------
+	if(m_b_own_source)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_p_source.reset();
+	}
+
+	//-------------------------------------------------------------------------
+	//	If the index cache has an up to date copy of the directory then there
+	//	is no need to read the package file at all.
 	//-------------------------------------------------------------------------
-	std::ifstream zip_file(m_filename,std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+	IndexCache::Key	index_key;
+	const bool		b_use_index = (m_p_index_cache && m_b_own_source && !IndexCache::make_key(m_filename,index_key));
 
-	if(zip_file.fail())
-		return count;
+	if(b_use_index && !load_index(index_key))
+		return 0;
+
+	auto p_source = get_source();
+
+	if(!p_source)
+		return 0;
 
 	//-------------------------------------------------------------------------
 	//	Get the length of the file. If it is smaller than the central directory 
 	//	then abort.
 	//-------------------------------------------------------------------------
-	zip_file.seekg(0, std::ios::end);
-	auto filesize = static_cast<size_t>(zip_file.tellg());
+	const std::uint64_t filesize = p_source->size();
 
 	if(filesize < sizeof_central_dir)
 	{
@@ -389,25 +616,27 @@ PackageZIP::scan()
 	//-------------------------------------------------------------------------
 	//	Load the central directory header.
 	//-------------------------------------------------------------------------
-	int								buffsize = std::min<int>(filesize,0x0FFFF + sizeof_central_dir + 4);
+	const size_t		buffsize = static_cast<size_t>(std::min<std::uint64_t>(filesize,0x0FFFF + sizeof_central_dir + 4));
 	std::vector<char>	buffer(buffsize+4);
 	zip_central_dir		central_dir;
 
 	std::memset(&central_dir,0,sizeof(central_dir));
 
-	zip_file.seekg(-(std::fstream::off_type)buffsize,std::ios::end);
-	zip_file.read(&buffer[0],buffsize);
+	if(p_source->read_at(filesize - buffsize,&buffer[0],buffsize) != buffsize)
+		return 0;
 
-	char *	pdata = &buffer[0] + (buffsize-sizeof_central_dir);
-	bool		found = false;
+	char *			pdata = &buffer[0] + (buffsize-sizeof_central_dir);
+	bool			found = false;
+	std::uint64_t	central_dir_offset = 0;
 
-	for(int i=buffsize-static_cast<int>(sizeof_central_dir);(i>=0) && !found;--i,--pdata)
+	for(std::int64_t i=static_cast<std::int64_t>(buffsize-sizeof_central_dir);(i>=0) && !found;--i,--pdata)
 	{
 		if(	(pdata[0]==0x50) && 
 				(pdata[1]==0x4B) && 
 				(pdata[2]==0x05) && 
 				(pdata[3]==0x06) )
 		{
+			central_dir_offset = filesize - buffsize + i;
 			pdata += 4;
 			std::memcpy(&central_dir,pdata,sizeof_central_dir);
 			found = true;
@@ -429,197 +658,368 @@ PackageZIP::scan()
 		return 0;
 	}
 
-	if(	central_dir.disk_number || central_dir.central_dir_disk_num)
-	{
-		std::clog << "PACKAGEZIP: Multi-file ZIP packages are not supported! (" << m_filename << ")\n";
-		return 0;
-	}
+	std::uint32_t	disk_number		= central_dir.disk_number;
+	std::uint32_t	dir_disk_number	= central_dir.central_dir_disk_num;
+	std::uint64_t	dir_entry_count	= central_dir.dir_entry_count;
+	std::uint64_t	dir_size		= central_dir.dir_size;
+	std::uint64_t	dir_offset		= central_dir.dir_offset;
 
 	//-------------------------------------------------------------------------
-	//	Add the entries in the zip directory to the package.
+	//	If there is a ZIP64 locator in front of the end of central directory
+	//	record then the real counts, size and offset are in the ZIP64 end of
+	//	central directory record.
 	//-------------------------------------------------------------------------
-	if(central_dir.dir_entry_count)
+	if(central_dir_offset >= (4 + sizeof(zip64_central_dir_locator)))
 	{
-		zip_dir_entry	direntry;
-		zip_file_header	fileheader;
-		std::uint32_t	offset = central_dir.dir_offset;
-		char			id[4];
-//		char			filename[256];
-		bool			finished = false;
+		char						locator_data[4 + sizeof(zip64_central_dir_locator)];
+		zip64_central_dir_locator	locator;
 
-		do
+		if(		(p_source->read_at(central_dir_offset - sizeof(locator_data),locator_data,sizeof(locator_data)) == sizeof(locator_data))
+			&&	(locator_data[0]==0x50) && (locator_data[1]==0x4B) && (locator_data[2]==0x06) && (locator_data[3]==0x07) )
 		{
-			//-----------------------------------------------------------------
-			//	Read the directory entry id (PK..)
-			//-----------------------------------------------------------------
-			zip_file.seekg(offset,std::ios::beg);
-			zip_file.read(id,4);
+			char				record_data[4 + sizeof(zip64_central_dir)];
+			zip64_central_dir	record;
 
-			if(!zip_file.fail() && id[0]=='P' && id[1]=='K' && id[2]==1 && id[3]==2)
-			{
-				//-------------------------------------------------------------
-				//	Read the directory entry.
-				//-------------------------------------------------------------
-				std::uint32_t direntry_file_offset = (std::uint32_t)zip_file.tellg();
+			std::memcpy(&locator,locator_data + 4,sizeof(locator));
 
-				zip_file.read((char *)&direntry,sizeof_dir_entry);
-				if(!zip_file.fail())
-				{
-					//---------------------------------------------------------
-					//	Read the file name.
-					//---------------------------------------------------------
-					std::string filename;
-					filename.resize(direntry.filename_size);
-					zip_file.read(&filename[0],direntry.filename_size);
-//					filename[direntry.filename_size] = 0;
-
-					zip_file.seekg(direntry.file_offset,std::ios::beg);
-					zip_file.read(id,4);
-
-					if(!zip_file.fail() && id[0]=='P' && id[1]=='K' && id[2]==0x03 && id[3]==0x04)
-					{
-						//-----------------------------------------------------
-						//	Read the file header.
-						//	If the size of the file is non-zero then process
-						//	the file.
-						//-----------------------------------------------------
-						zip_file.read((char *)&fileheader,sizeof_zipfile_header);
-
-						if(fileheader.size_uncompressed)
-						{
-							//fileinfo finfo;
-
-							////-------------------------------------------------
-							////	Add a fileinfo object to the package.
-							////-------------------------------------------------
-							//finfo.compression_method	= fileheader.compression_method;
-							//finfo.crc					= fileheader.crc;
-							//finfo.file_offset			=	direntry.file_offset +
-							//								sizeof_zipfile_header +
-							//								4 +
-							//								fileheader.filename_size +
-							//								fileheader.extra_size;
-							//finfo.dir_entry_file_offset	= direntry_file_offset;
-							//finfo.size_compressed		= fileheader.size_compressed;
-							//finfo.size_uncompressed		= fileheader.size_uncompressed;
-
-							//uint32t index = (uint32t)m_fileinfo.size();
-							//m_fileinfo.push_back(finfo);
-
-							////-------------------------------------------------
-							////	Add an entry for the file into the main directory
-							////-------------------------------------------------
-							//prootdir->create_file(std::string(filename),finfo.size_uncompressed,this,index);
-
-							FileInfo info;
-
-							info.compression_method		=	fileheader.compression_method;
-							info.crc					=	fileheader.crc;
-							info.file_offset			=	direntry.file_offset +
-															sizeof_zipfile_header +
-															4 +
-															fileheader.filename_size +
-															fileheader.extra_size;
-							info.dir_entry_file_offset	=	direntry_file_offset;
-							info.size_compressed		=	fileheader.size_compressed;
-							info.size_uncompressed		=	fileheader.size_uncompressed;
-
-							add_file(filename,info);
-
-							//std::cout << std::setw(10) << fileheader.size_compressed << std::setw(10) << fileheader.size_uncompressed << " " << filename << "\n";
-						}
-					}
-					else
-						finished = true;
-
-					offset += (sizeof_dir_entry+4+direntry.filename_size+direntry.extra_size+direntry.comment_size);
-				}
-				else
-					finished = true;
+			if(		(p_source->read_at(locator.central_dir_offset,record_data,sizeof(record_data)) != sizeof(record_data))
+				||	!((record_data[0]==0x50) && (record_data[1]==0x4B) && (record_data[2]==0x06) && (record_data[3]==0x06)) )
+			{
+				std::clog << "PACKAGEZIP: Error! Package file '" << m_filename << "' has an invalid ZIP64 directory!\n";
+				return 0;
 			}
-			else
-				finished = true;
 
-		} while(!finished);
-	}
+			std::memcpy(&record,record_data + 4,sizeof(record));
 
-	return 0;
-}
+			disk_number		= record.disk_number;
+			dir_disk_number	= record.central_dir_disk_num;
+			dir_entry_count	= record.dir_entry_count;
+			dir_size		= record.dir_size;
+			dir_offset		= record.dir_offset;
+		}
+	}
 
+	if(	disk_number || dir_disk_number)
+	{
+		std::clog << "PACKAGEZIP: Multi-file ZIP packages are not supported! (" << m_filename << ")\n";
+		return 0;
+	}
 
-std::int32_t
-PackageZIP::add_file(	const std::string & path,
-						FileInfo &			info )
-{
-	std::int32_t file_id = -1;
+	if(!dir_entry_count)
+		return 0;
 
 	//-------------------------------------------------------------------------
-	//	Get the directory that the file should be added to.
+	//	Read the whole of the central directory in one go and parse it from
+	//	memory.
 	//-------------------------------------------------------------------------
-	directory_shared_ptr p_dir;
-	std::string filename;
-
-	auto pos = path.find_last_of("/");
-	if(pos == std::string::npos)
+	if((dir_offset > filesize) || (dir_size > (filesize - dir_offset)))
 	{
-		p_dir = m_root_directory.p_directory;
-		filename = path;
+		std::clog << "PACKAGEZIP: Error! Package file '" << m_filename << "' is corrupt!\n";
+		return 0;
 	}
-	else
+
+	BufferPool::Buffer	directory;
+	const char *		p_directory = (p_source->data() ? p_source->data() + dir_offset : nullptr);
+
+	if(!p_directory)
 	{
-		auto p_node = get_directory(path.substr(0,pos),true);
-		if(p_node)
-		{
-			p_dir = p_node->p_directory;
-			filename = path.substr(pos+1);
-		}
+		directory = m_p_buffer_pool->acquire(static_cast<size_t>(dir_size));
+
+		if(p_source->read_at(dir_offset,directory.data(),directory.size()) != directory.size())
+			return 0;
+
+		p_directory = directory.data();
 	}
 
-	if(!p_dir || filename.empty())
-		return -1;
+	m_file_info.reserve(static_cast<size_t>(std::min<std::uint64_t>(dir_entry_count,dir_size / (4 + sizeof_dir_entry))));
 
-	//-------------------------------------------------------------------------
-	//	Add the file to the package.
-	//-------------------------------------------------------------------------
-	file_id = static_cast<std::int32_t>(m_file_info.size());
-	m_file_info.push_back(info);
+	const char *	p_entry		= p_directory;
+	const char *	p_end		= p_directory + dir_size;
+	zip_dir_entry	direntry;
+	std::string		filename;
 
 	//-------------------------------------------------------------------------
-	//	Add the file to the directory.
+	//	Add the entries in the zip directory to the package.
 	//-------------------------------------------------------------------------
-	static_cast<DirectoryZIP *>(p_dir.get())->add_file(filename,file_id);
-
-	return file_id;
-}
+	while(		((p_end - p_entry) >= static_cast<std::ptrdiff_t>(4 + sizeof_dir_entry))
+			&&	p_entry[0]=='P' && p_entry[1]=='K' && p_entry[2]==1 && p_entry[3]==2 )
+	{
+		std::memcpy(&direntry,p_entry + 4,sizeof_dir_entry);
 
-PackageZIP::DirectoryNode *					
-PackageZIP::get_directory(const std::string & path,bool b_create)
-{
-	std::string dirs(path.size(),0);
-	std::transform(path.begin(),path.end(),dirs.begin(),::tolower);
+		const size_t entry_size = 4 + sizeof_dir_entry + direntry.filename_size + direntry.extra_size + direntry.comment_size;
 
-	DirectoryNode * p_dir = &m_root_directory;
+		if(static_cast<size_t>(p_end - p_entry) < entry_size)
+			break;
 
-	auto pos=dirs.find_first_not_of("/");
-	bool err = false;
+		filename.assign(p_entry + 4 + sizeof_dir_entry,direntry.filename_size);
 
-	while((pos!=std::string::npos) && !err)
-	{
-		auto pos2 = dirs.find_first_of("/",pos);
-		std::string dir;
-		
-		if(pos2 == std::string::npos)
+		//---------------------------------------------------------------------
+		//	Directory entries just make sure that the directory exists. The
+		//	location of the file data is found when the file is first opened.
+		//---------------------------------------------------------------------
+		if(!filename.empty() && (filename.back() == '/'))
 		{
-			dir = dirs.substr(pos);
-			pos = pos2;
+			filename.pop_back();
+			if(!filename.empty())
+				get_directory(filename,true);
 		}
 		else
 		{
-			dir = dirs.substr(pos,pos2-pos);
-			pos = dirs.find_first_not_of("/",pos2);
-		}
+			FileInfo info;
 
-		if(dir.empty())
+			info.compression_method		=	direntry.compression_method;
+			info.crc					=	direntry.crc;
+			info.header_offset			=	direntry.file_offset;
+			info.file_offset			=	-1;
+			info.dir_entry_file_offset	=	static_cast<std::int64_t>(dir_offset + (p_entry - p_directory) + 4);
+			info.size_compressed		=	direntry.size_compressed;
+			info.size_uncompressed		=	direntry.size_uncompressed;
+
+			//-----------------------------------------------------------------
+			//	Sizes and offsets that don't fit in 32 bits are in the ZIP64
+			//	extra field.
+			//-----------------------------------------------------------------
+			if(		(direntry.size_uncompressed == ZIP64_MARKER)
+				||	(direntry.size_compressed == ZIP64_MARKER)
+				||	(direntry.file_offset == ZIP64_MARKER) )
+			{
+				if(read_zip64_extra(p_entry + 4 + sizeof_dir_entry + direntry.filename_size,direntry,info))
+				{
+					std::clog << "PACKAGEZIP: Entry '" << filename << "' of '" << m_filename << "' has an invalid ZIP64 extra field!\n";
+					p_entry += entry_size;
+					continue;
+				}
+			}
+
+			add_file(filename,info);
+		}
+
+		p_entry += entry_size;
+	}
+
+	if(b_use_index)
+		store_index(index_key);
+
+	return 0;
+}
+
+int
+PackageZIP::read_zip64_extra(	const char *			p_extra,
+								const zip_dir_entry &	direntry,
+								FileInfo &				info )
+{
+	const char * p_end = p_extra + direntry.extra_size;
+
+	//-------------------------------------------------------------------------
+	//	Find the ZIP64 field. It only holds the values that are set to 
+	//	ZIP64_MARKER in the directory entry, in this order.
+	//-------------------------------------------------------------------------
+	while((p_end - p_extra) >= 4)
+	{
+		std::uint16_t header_id;
+		std::uint16_t data_size;
+
+		std::memcpy(&header_id,p_extra,2);
+		std::memcpy(&data_size,p_extra + 2,2);
+		p_extra += 4;
+
+		if(data_size > (p_end - p_extra))
+			return -1;
+
+		if(header_id == ZIP64_EXTRA_ID)
+		{
+			const char *	p_field		= p_extra;
+			const char *	p_field_end	= p_extra + data_size;
+
+			auto read_value = [&](std::int64_t & value) -> bool
+			{
+				std::uint64_t v;
+
+				if((p_field_end - p_field) < 8)
+					return false;
+
+				std::memcpy(&v,p_field,8);
+				p_field += 8;
+
+				if(v > static_cast<std::uint64_t>(INT64_MAX))
+					return false;
+
+				value = static_cast<std::int64_t>(v);
+				return true;
+			};
+
+			if((direntry.size_uncompressed == ZIP64_MARKER) && !read_value(info.size_uncompressed))
+				return -1;
+
+			if((direntry.size_compressed == ZIP64_MARKER) && !read_value(info.size_compressed))
+				return -1;
+
+			if((direntry.file_offset == ZIP64_MARKER) && !read_value(info.header_offset))
+				return -1;
+
+			return 0;
+		}
+
+		p_extra += data_size;
+	}
+
+	return -1;
+}
+
+int
+PackageZIP::load_index(const IndexCache::Key & key)
+{
+	std::vector<FileInfo>	file_info;
+	DirectoryNode			root_directory;
+
+	auto parse = [&](IndexReader & reader) -> int
+	{
+		if(!reader.read_array(file_info) || read_directory(reader,root_directory) || !reader.is_end())
+			return -1;
+
+		return 0;
+	};
+
+	if(m_p_index_cache->load(key,"ZIP",INDEX_VERSION,parse))
+		return -1;
+
+	m_file_info.swap(file_info);
+	m_root_directory = std::move(root_directory);
+
+	return 0;
+}
+
+void
+PackageZIP::store_index(const IndexCache::Key & key)
+{
+	IndexWriter writer;
+
+	//-------------------------------------------------------------------------
+	//	This is called straight after the directory has been parsed so none of
+	//	the local headers have been resolved yet (file_offset is -1).
+	//-------------------------------------------------------------------------
+	writer.write_array(m_file_info);
+	write_directory(writer,m_root_directory);
+
+	m_p_index_cache->store(key,"ZIP",INDEX_VERSION,writer);
+}
+
+void
+PackageZIP::write_directory(IndexWriter & writer,const DirectoryNode & dir_node) const
+{
+	if(dir_node.p_directory)
+		static_cast<const DirectoryZIP *>(dir_node.p_directory.get())->write_index(writer);
+	else
+		writer.write(static_cast<std::uint32_t>(0));
+
+	writer.write(static_cast<std::uint32_t>(dir_node.sub_directories.size()));
+
+	for(auto & dir_pair : dir_node.sub_directories)
+	{
+		writer.write_string(dir_pair.first);
+		write_directory(writer,dir_pair.second);
+	}
+}
+
+int
+PackageZIP::read_directory(IndexReader & reader,DirectoryNode & dir_node)
+{
+	auto			p_dir = std::make_shared<DirectoryZIP>(this);
+	std::uint32_t	count = 0;
+	std::string		name;
+
+	if(p_dir->read_index(reader) || !reader.read(count))
+		return -1;
+
+	dir_node.p_directory = p_dir;
+
+	while(count--)
+	{
+		if(!reader.read_string(name))
+			return -1;
+
+		auto isub = dir_node.sub_directories.emplace_hint(dir_node.sub_directories.end(),std::move(name),DirectoryNode());
+
+		if(read_directory(reader,isub->second))
+			return -1;
+	}
+
+	return 0;
+}
+
+std::int32_t
+PackageZIP::add_file(	const std::string & path,
+						FileInfo &			info )
+{
+	std::int32_t file_id = -1;
+
+	//-------------------------------------------------------------------------
+	//	Get the directory that the file should be added to.
+	//-------------------------------------------------------------------------
+	directory_shared_ptr p_dir;
+	std::string filename;
+
+	auto pos = path.find_last_of("/");
+	if(pos == std::string::npos)
+	{
+		p_dir = m_root_directory.p_directory;
+		filename = path;
+	}
+	else
+	{
+		auto p_node = get_directory(path.substr(0,pos),true);
+		if(p_node)
+		{
+			p_dir = p_node->p_directory;
+			filename = path.substr(pos+1);
+		}
+	}
+
+	if(!p_dir || filename.empty())
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Add the file to the package.
+	//-------------------------------------------------------------------------
+	file_id = static_cast<std::int32_t>(m_file_info.size());
+	m_file_info.push_back(info);
+
+	//-------------------------------------------------------------------------
+	//	Add the file to the directory.
+	//-------------------------------------------------------------------------
+	static_cast<DirectoryZIP *>(p_dir.get())->add_file(filename,file_id);
+
+	return file_id;
+}
+
+PackageZIP::DirectoryNode *					
+PackageZIP::get_directory(const std::string & path,bool b_create)
+{
+	std::string dirs(path.size(),0);
+	std::transform(path.begin(),path.end(),dirs.begin(),::tolower);
+
+	DirectoryNode * p_dir = &m_root_directory;
+
+	auto pos=dirs.find_first_not_of("/");
+	bool err = false;
+
+	while((pos!=std::string::npos) && !err)
+	{
+		auto pos2 = dirs.find_first_of("/",pos);
+		std::string dir;
+		
+		if(pos2 == std::string::npos)
+		{
+			dir = dirs.substr(pos);
+			pos = pos2;
+		}
+		else
+		{
+			dir = dirs.substr(pos,pos2-pos);
+			pos = dirs.find_first_not_of("/",pos2);
+		}
+
+		if(dir.empty())
 		{
 			if(pos != std::string::npos)
 				err = true;
@@ -657,131 +1057,668 @@ PackageZIP::openfile(	std::int32_t	id,
 {
 	std::unique_ptr<IFile> p_file;
 
-	auto p_info = get_file_info(id);
+	FileInfo info;
+
+	if(resolve(id,info))
+		return p_file;
+
+	//-------------------------------------------------------------------------
+	//	Stored entries are read straight from the package file.
+	//-------------------------------------------------------------------------
+	if(info.compression_method == ZIP_UNCOMPRESSED)
+	{
+		auto p_source = get_source();
+
+		//---------------------------------------------------------------------
+		//	If the package is in memory then the file is just a view of it.
+		//---------------------------------------------------------------------
+		if(p_source && p_source->data())
+		{
+			p_file = std::make_unique<FileMemoryView>(p_source,p_source->data() + info.file_offset,info.size_uncompressed);
+			if(mode & MODE_AT_END)
+				p_file->seek(info.size_uncompressed);
+
+			return p_file;
+		}
+
+		auto p_new_file = std::make_unique<FileZIPStore>();
+		if(!p_new_file->open(p_source,info,mode))
+			p_file = std::move(p_new_file);
+
+		return p_file;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Empty entries don't need to be decompressed.
+	//-------------------------------------------------------------------------
+	if(!info.size_uncompressed)
+		return std::make_unique<FileInMemory>(MODE_READ);
+
+	//-------------------------------------------------------------------------
+	//	If the entry is already in the cache then just share the cached 
+	//	buffer.
+	//-------------------------------------------------------------------------
+	if(m_p_entry_cache)
+	{
+		auto p_buffer = m_p_entry_cache->find(m_cache_owner,id);
+		if(p_buffer)
+			return std::make_unique<FileMemoryView>(p_buffer,p_buffer->data(),p_buffer->size());
+	}
+
+	//-------------------------------------------------------------------------
+	//	Everything else goes through the decompressor that is selected for 
+	//	the compression method. Sequential opens are decoded as they are read
+	//	if the decompressor is able to, unless the entry can be cached.
+	//	Entries that will be spilled to a temporary file are never cached.
+	//-------------------------------------------------------------------------
+	auto p_decompressor = DecompressorRegistry::instance().create(info.compression_method);
+	if(!p_decompressor)
+		return p_file;
 
-	if(p_info)
+	const bool b_cacheable =	m_p_entry_cache
+							&&	(static_cast<size_t>(info.size_uncompressed) <= m_p_entry_cache->budget())
+							&&	(!m_settings.spill_threshold || (static_cast<size_t>(info.size_uncompressed) <= m_settings.spill_threshold));
+
+	if((mode & MODE_STREAM) && !b_cacheable && p_decompressor->can_stream())
 	{
-		switch(p_info->compression_method)
+		auto p_new_file = std::make_unique<FileZIPStream>();
+		if(!p_new_file->open(get_source(),info,std::move(p_decompressor),mode))
+			p_file = std::move(p_new_file);
+
+		return p_file;
+	}
+
+	try
+	{
+		//---------------------------------------------------------------------
+		//	Very large entries are decompressed into a temporary file so that
+		//	the kernel can page them out. If the file can't be created then the
+		//	entry is decompressed into memory as usual.
+		//---------------------------------------------------------------------
+		if(		m_settings.spill_threshold
+			&&	(static_cast<size_t>(info.size_uncompressed) > m_settings.spill_threshold) )
 		{
-			//-----------------------------------------------------------------
-			case ZIP_UNCOMPRESSED :
-			//-----------------------------------------------------------------
+			auto p_spill = SpillBuffer::create(info.size_uncompressed,m_settings.spill_directory);
+			if(p_spill)
+			{
+				if(decompress(info,*p_decompressor,p_spill->data()))
 				{
-					auto p_new_file = std::make_unique<FileZIPStore>();
-					if(!p_new_file->open(m_filename,*p_info,mode))
-						p_file = std::move(p_new_file);
+					std::clog << "PACKAGEZIP: Failed to decompress entry " << id << " of '" << m_filename << "'\n";
+					return p_file;
 				}
-				break;
 
-			//-----------------------------------------------------------------
-			case ZIP_DEFLATED :
-			//-----------------------------------------------------------------
-				{
-					std::ifstream infile(m_filename,std::ios_base::in | std::ios_base::binary);
-
-					if(infile.is_open())
-					{
-						std::vector<char> data(p_info->size_compressed);
-						infile.seekg(p_info->file_offset,std::ios_base::beg);
-						if(infile.read(&data[0],p_info->size_compressed).gcount() == p_info->size_compressed)
-						{
-							try
-							{
-								auto p_new_file = std::make_unique<FileInMemory>(MODE_READ);
-								p_new_file->resize(p_info->size_uncompressed);
-								inflate((std::uint8_t *)&data[0],data.size(),(std::uint8_t *)p_new_file->data(),p_new_file->size());
-								p_file = std::move(p_new_file);
-							}
-							catch(...){}
-						}
-					}
-				}
-				break;
+				p_spill->seal();
+				return std::make_unique<FileMemoryView>(p_spill,p_spill->data(),p_spill->size());
+			}
+		}
 
-			default :
-				break;
+		std::vector<char> output(info.size_uncompressed);
+
+		if(decompress(info,*p_decompressor,output.data()))
+		{
+			std::clog << "PACKAGEZIP: Failed to decompress entry " << id << " of '" << m_filename << "'\n";
+			return p_file;
+		}
+
+		//---------------------------------------------------------------------
+		//	Cached entries are shared with later opens.
+		//---------------------------------------------------------------------
+		if(m_p_entry_cache)
+		{
+			auto p_buffer = m_p_entry_cache->insert(m_cache_owner,id,std::move(output));
+			p_file = std::make_unique<FileMemoryView>(p_buffer,p_buffer->data(),p_buffer->size());
+		}
+		else
+		{
+			auto p_new_file = std::make_unique<FileInMemory>(MODE_READ);
+			p_new_file->swap(output);
+			p_file = std::move(p_new_file);
 		}
 	}
+	catch(...){}
 
 	return p_file;
 }
 
+int
+PackageZIP::decompress(	const FileInfo &	info,
+						IDecompressor &		decompressor,
+						char *				p_target )
+{
+	auto p_source = get_source();
+	if(!p_source)
+		return -1;
 
-void
-PackageZIP::inflate(const std::uint8_t *	p_source,
-					size_t					source_size,
-					std::uint8_t *			p_target,
-					size_t					target_size )
+	//-------------------------------------------------------------------------
+	//	If the package is in memory then the compressed data can be used 
+	//	where it is.
+	//-------------------------------------------------------------------------
+	if(p_source->data())
+		return decompressor.decompress(	reinterpret_cast<const std::uint8_t *>(p_source->data() + info.file_offset),info.size_compressed,
+										reinterpret_cast<std::uint8_t *>(p_target),info.size_uncompressed );
+
+	//-------------------------------------------------------------------------
+	//	Most entries are read into a pooled scratch buffer in one go and 
+	//	decompressed in a single call.
+	//-------------------------------------------------------------------------
+	if(		!decompressor.can_stream()
+		||	(static_cast<size_t>(info.size_compressed) <= STREAM_CHUNK_SIZE) )
+	{
+		auto data = m_p_buffer_pool->acquire(info.size_compressed);
+		if(p_source->read_at(info.file_offset,data.data(),data.size()) != data.size())
+			return -1;
+
+		return decompressor.decompress(	reinterpret_cast<const std::uint8_t *>(data.data()),data.size(),
+										reinterpret_cast<std::uint8_t *>(p_target),info.size_uncompressed );
+	}
+
+	//-------------------------------------------------------------------------
+	//	Large entries are fed to the decompressor a chunk at a time so that the
+	//	whole of the compressed data is never held in memory.
+	//-------------------------------------------------------------------------
+	if(decompressor.begin())
+		return -1;
+
+	auto					chunk		= m_p_buffer_pool->acquire(STREAM_CHUNK_SIZE);
+	std::uint8_t *			p_out		= reinterpret_cast<std::uint8_t *>(p_target);
+	size_t					out_avail	= info.size_uncompressed;
+	size_t					consumed	= 0;
+	int						result		= 0;
+
+	while(!result && (consumed < static_cast<size_t>(info.size_compressed)))
+	{
+		const size_t readsize = p_source->read_at(	info.file_offset + consumed,
+													chunk.data(),
+													std::min<size_t>(chunk.size(),info.size_compressed - consumed) );
+		if(!readsize)
+			return -1;
+
+		consumed += readsize;
+
+		auto	p_in		= reinterpret_cast<const std::uint8_t *>(chunk.data());
+		size_t	in_avail	= readsize;
+
+		while(!result && in_avail)
+		{
+			const size_t before_in	= in_avail;
+			const size_t before_out	= out_avail;
+
+			result = decompressor.stream(p_in,in_avail,p_out,out_avail);
+
+			if(!result && (before_in == in_avail) && (before_out == out_avail))
+				return -1;			// No progress can be made.
+		}
+	}
+
+	return ((result > 0) && !out_avail ? 0 : -1);
+}
+
+int
+PackageZIP::read_compressed(std::int32_t id,std::vector<char> & out_data)
 {
+	FileInfo info;
+	if(resolve(id,info))
+		return -1;
 
+	auto p_source = get_source();
+	if(!p_source)
+		return -1;
 
-#ifdef PKGZIP_INFLATE_ZLIB
+	out_data.resize(info.size_compressed);
 
-	#ifdef HAVE_ZLIB				
-		int		err;
-		z_stream s;
+	return (p_source->read_at(info.file_offset,out_data.data(),out_data.size()) == out_data.size() ? 0 : -1);
+}
+
+int
+PackageZIP::load_batch(std::vector<BatchEntry> & entries)
+{
+	//-------------------------------------------------------------------------
+	//	Until an entry has been opened the size of its local header is not
+	//	known, so its read is made big enough for a typical header. Entries 
+	//	whose headers are bigger are finished off with a read of their own.
+	//-------------------------------------------------------------------------
+	enum {HEADER_ALLOWANCE = 4 + sizeof_zipfile_header + 256};
+
+	struct Request
+	{
+		size_t				index;				// The index of the entry in 'entries'.
+		std::int32_t		id;
+		FileInfo			info;
+		std::uint64_t		begin;				// The offset of the entry's local header.
+		std::uint64_t		end;				// The offset of the end of the entry's data.
+	};
+
+	auto p_source = get_source();
+	if(!p_source)
+		return -1;
 
-		s.total_in	= 0;
-		s.total_out	= 0;
-		s.zalloc	= Z_NULL;
-		s.zfree		= Z_NULL;
-		s.opaque	= Z_NULL;
-		s.avail_in	= 0;
-		s.next_in	= Z_NULL;
+	std::vector<Request>	requests;
+	int						result = 0;
+
+	for(size_t index = 0;index < entries.size();++index)
+	{
+		auto & entry = entries[index];
 
-		err=inflateInit2(&s, -MAX_WBITS);
-		if(err == Z_OK)
+		entry.data.clear();
+		entry.result = -1;
+
+		Request request;
+		request.index	= index;
+		request.id		= find_file(entry.path);
+
+		if(request.id < 0)
 		{
-			s.avail_in	= source_size;
-			s.next_in	= (Bytef *)p_source;
+			result = -1;
+			continue;
+		}
 
-			s.avail_out = target_size;
-			s.next_out	= (Bytef *)p_target;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			request.info = m_file_info[request.id];
+		}
 
-			switch(err = ::inflate(&s,Z_FINISH)) //Z_SYNC_FLUSH))
+		//---------------------------------------------------------------------
+		//	Entries that are already in the cache don't need to be read.
+		//---------------------------------------------------------------------
+		if(m_p_entry_cache && (request.info.compression_method != ZIP_UNCOMPRESSED))
+		{
+			auto p_buffer = m_p_entry_cache->find(m_cache_owner,request.id);
+			if(p_buffer)
 			{
-				//---------------------------------------------------------
-				case	Z_OK :
-				case	Z_STREAM_END :
-				//---------------------------------------------------------
-					break;
-
-				//---------------------------------------------------------
-				case	Z_MEM_ERROR :
-				case	Z_BUF_ERROR :
-				case	Z_DATA_ERROR :
-				default :
-				//---------------------------------------------------------
-					throw std::exception(__FILE__,__LINE__);
-					break;
+				entry.data.assign(p_buffer->data(),p_buffer->data() + p_buffer->size());
+				entry.result = 0;
+				continue;
 			}
+		}
+
+		request.begin	= static_cast<std::uint64_t>(request.info.header_offset);
+		request.end		= static_cast<std::uint64_t>(request.info.size_compressed) + 
+							(request.info.file_offset >= 0 ? static_cast<std::uint64_t>(request.info.file_offset) : request.begin + HEADER_ALLOWANCE);
+
+		requests.push_back(request);
+	}
+
+	std::sort(requests.begin(),requests.end(),[](const Request & a,const Request & b) {return a.begin < b.begin;});
+
+	//-------------------------------------------------------------------------
+	//	Read the entries in groups. An entry joins the group if the gap before
+	//	it is small enough and the group does not grow too big.
+	//-------------------------------------------------------------------------
+	std::vector<char> group;
 
-			inflateEnd(&s);
+	for(size_t first = 0;first < requests.size();)
+	{
+		const std::uint64_t	begin	= requests[first].begin;
+		std::uint64_t		end		= requests[first].end;
+		size_t				last	= first + 1;
+
+		while(		(last < requests.size())
+				&&	(requests[last].begin <= end + m_settings.batch_max_gap)
+				&&	(std::max(end,requests[last].end) - begin <= m_settings.batch_max_read) )
+		{
+			end = std::max(end,requests[last].end);
+			++last;
 		}
 
-	#else
-		std::clog << "ZIP Deflate is not supported in this version.\n";	
-		throw std::exception(__FILE__,__LINE__);
-	#endif
+		end = std::min(end,p_source->size());
 
-//#else
-//
+		size_t readsize = 0;
+
+		if(end > begin)
+		{
+			group.resize(static_cast<size_t>(end - begin));
+			readsize = p_source->read_at(begin,group.data(),group.size());
+		}
+
+		for(;first < last;++first)
+		{
+			auto & request	= requests[first];
+			auto & entry	= entries[request.index];
+
+			if(extract(request.id,request.info,*p_source,group.data(),begin,readsize,entry.data))
+			{
+				std::clog << "PACKAGEZIP: Failed to load entry " << request.id << " of '" << m_filename << "'\n";
+				entry.data.clear();
+				result = -1;
+			}
+			else
+				entry.result = 0;
+		}
+	}
+
+	return result;
+}
+
+int
+PackageZIP::extract(	std::int32_t			id,
+						FileInfo &				info,
+						IDataSource &			source,
+						const char *			p_buffer,
+						std::uint64_t			buffer_offset,
+						size_t					buffer_size,
+						std::vector<char> &		out_data )
+{
+	//-------------------------------------------------------------------------
+	//	Find the start of the data from the local header.
+	//-------------------------------------------------------------------------
+	if(info.file_offset < 0)
+	{
+		const std::uint64_t header_pos = static_cast<std::uint64_t>(info.header_offset) - buffer_offset;
+
+		if(header_pos + 4 + sizeof_zipfile_header > buffer_size)
+			return -1;
+
+		const char *	p_header = p_buffer + header_pos;
+		zip_file_header	fileheader;
+
+		if(!(p_header[0]=='P' && p_header[1]=='K' && p_header[2]==0x03 && p_header[3]==0x04))
+			return -1;
+
+		std::memcpy(&fileheader,p_header + 4,sizeof_zipfile_header);
+
+		info.file_offset =	info.header_offset +
+							sizeof_zipfile_header +
+							4 +
+							fileheader.filename_size +
+							fileheader.extra_size;
+
+		if(static_cast<std::uint64_t>(info.file_offset + info.size_compressed) > source.size())
+			return -1;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_file_info[id].file_offset = info.file_offset;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Use the data where it is in the buffer. If it runs past the end of the
+	//	buffer then it has to be read separately.
+	//-------------------------------------------------------------------------
+	const std::uint64_t	data_pos	= static_cast<std::uint64_t>(info.file_offset) - buffer_offset;
+	const size_t		data_size	= static_cast<size_t>(info.size_compressed);
+	const char *		p_data		= p_buffer + data_pos;
+	BufferPool::Buffer	data;
+
+	if(data_pos + data_size > buffer_size)
+	{
+		data = m_p_buffer_pool->acquire(data_size);
+		if(source.read_at(info.file_offset,data.data(),data_size) != data_size)
+			return -1;
+
+		p_data = data.data();
+	}
+
+	out_data.resize(static_cast<size_t>(info.size_uncompressed));
+
+	if(info.compression_method == ZIP_UNCOMPRESSED)
+	{
+		if(data_size != out_data.size())
+			return -1;
+
+		if(data_size)
+			std::memcpy(out_data.data(),p_data,data_size);
+
+		return 0;
+	}
+
+	if(out_data.empty())
+		return 0;
+
+	auto p_decompressor = DecompressorRegistry::instance().create(info.compression_method);
+	if(!p_decompressor)
+		return -1;
+
+	return p_decompressor->decompress(	reinterpret_cast<const std::uint8_t *>(p_data),data_size,
+										reinterpret_cast<std::uint8_t *>(out_data.data()),out_data.size() );
+}
+
+std::int32_t
+PackageZIP::find_file(const std::string & path)
+{
+	std::string	dirpath;
+	std::string	name(path);
+
+	const auto pos = path.find_last_of('/');
+	if(pos != std::string::npos)
+	{
+		dirpath	= path.substr(0,pos);
+		name	= path.substr(pos + 1);
+	}
+
+	DirectoryNode * p_node = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		p_node = get_directory(dirpath);
+	}
+
+	if(!p_node || !p_node->p_directory)
+		return -1;
+
+	return static_cast<DirectoryZIP *>(p_node->p_directory.get())->find_file(name);
+}
+
+int
+PackageZIP::for_each_entry(const package_entry_func & func)
+{
+	auto p_source = get_source();
+	if(!p_source)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Find the path of each entry and sort the entries by where their local
+	//	headers are in the package.
+	//-------------------------------------------------------------------------
+	std::vector<std::string>	paths;
+	std::vector<std::int32_t>	ids;
+	std::vector<std::int64_t>	header_offsets;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		paths.resize(m_file_info.size());
+		list_files(m_root_directory,std::string(),paths);
+
+		for(auto & info : m_file_info)
+		{
+			const std::int64_t header_offset = info.header_offset;		// FileInfo is packed.
+			header_offsets.push_back(header_offset);
+		}
+	}
+
+	for(std::int32_t id = 0;id < static_cast<std::int32_t>(paths.size());++id)
+		if(!paths[id].empty())
+			ids.push_back(id);
+
+	std::sort(ids.begin(),ids.end(),[&](std::int32_t a,std::int32_t b) {return header_offsets[a] < header_offsets[b];});
+
+	//-------------------------------------------------------------------------
+	//	Everything is read through a read ahead buffer so that the package is
+	//	read in large sequential blocks. Packages in memory are used directly.
+	//-------------------------------------------------------------------------
+	data_source_shared_ptr p_read = p_source;
+	if(!p_source->data())
+		p_read = std::make_shared<DataSourceReadAhead>(p_source);
+
+	int result = 0;
+
+	for(auto id : ids)
+	{
+		FileInfo info;
+		if(resolve(id,info,p_read.get()))
+		{
+			result = -1;
+			continue;
+		}
+
+		auto p_file = open_stream(id,info,p_read);
+		if(!p_file)
+		{
+			result = -1;
+			continue;
+		}
+
+		PackageEntry entry;
+		entry.path			= std::move(paths[id]);
+		entry.size			= static_cast<std::uint64_t>(info.size_uncompressed);
+		entry.stored_size	= static_cast<std::uint64_t>(info.size_compressed);
+		entry.offset		= static_cast<std::uint64_t>(info.file_offset);
+		entry.compression	= info.compression_method;
+		entry.crc			= info.crc;
+
+		const int func_result = func(entry,*p_file);
+		if(func_result)
+			return func_result;
+	}
+
+	return result;
+}
+
+std::unique_ptr<IFile>
+PackageZIP::open_stream(std::int32_t id,const FileInfo & info,data_source_shared_ptr p_source)
+{
+	std::unique_ptr<IFile> p_file;
+
+	if(info.compression_method == ZIP_UNCOMPRESSED)
+	{
+		if(p_source->data())
+			return std::make_unique<FileMemoryView>(p_source,p_source->data() + info.file_offset,info.size_uncompressed);
+
+		auto p_new_file = std::make_unique<FileZIPStore>();
+		if(!p_new_file->open(p_source,info,MODE_READ))
+			p_file = std::move(p_new_file);
+
+		return p_file;
+	}
+
+	if(!info.size_uncompressed)
+		return std::make_unique<FileInMemory>(MODE_READ);
+
+	//-------------------------------------------------------------------------
+	//	Methods that can't be streamed are decompressed as usual.
+	//-------------------------------------------------------------------------
+	auto p_decompressor = DecompressorRegistry::instance().create(info.compression_method);
+	if(!p_decompressor || !p_decompressor->can_stream())
+		return openfile(id,MODE_READ);
+
+	auto p_new_file = std::make_unique<FileZIPStream>();
+	if(!p_new_file->open(p_source,info,std::move(p_decompressor),MODE_READ | MODE_STREAM))
+		p_file = std::move(p_new_file);
+
+	return p_file;
+}
+
+void
+PackageZIP::list_files(	const DirectoryNode &		dir_node,
+						const std::string &			path,
+						std::vector<std::string> &	out_paths ) const
+{
+	if(dir_node.p_directory)
+	{
+		auto p_dir = static_cast<const DirectoryZIP *>(dir_node.p_directory.get());
+
+		p_dir->for_each_file([&](const std::string & name,std::int32_t id)
+		{
+			if((id >= 0) && (id < static_cast<std::int32_t>(out_paths.size())))
+				out_paths[id] = path + name;
+		});
+	}
+
+	for(auto & dir_pair : dir_node.sub_directories)
+		list_files(dir_pair.second,path + dir_pair.first + "/",out_paths);
+}
+
+int
+PackageZIP::resolve(std::int32_t id,FileInfo & out_info,IDataSource * p_source)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if((id < 0) || (id >= static_cast<std::int32_t>(m_file_info.size())))
+			return -1;
+
+		out_info = m_file_info[id];
+	}
+
+	if(out_info.file_offset >= 0)
+		return 0;
+
+	//-------------------------------------------------------------------------
+	//	The entry's data follows its local header. The header's name and 
+	//	extra field can differ in length from the central directory's so the
+	//	header has to be read to find where the data starts. The sizes come 
+	//	from the central directory because they are zero in the local header
+	//	if the entry was written with a data descriptor.
+	//-------------------------------------------------------------------------
+	data_source_shared_ptr p_package_source;
+	if(!p_source)
+	{
+		p_package_source	= get_source();
+		p_source			= p_package_source.get();
+	}
+
+	if(!p_source)
+		return -1;
+
+	char			id_bytes[4];
+	zip_file_header	fileheader;
+	char			header[4 + sizeof_zipfile_header];
+
+	if(p_source->read_at(out_info.header_offset,header,sizeof(header)) != sizeof(header))
+		return -1;
+
+	std::memcpy(id_bytes,header,4);
+	std::memcpy(&fileheader,header + 4,sizeof_zipfile_header);
+
+	if(!(id_bytes[0]=='P' && id_bytes[1]=='K' && id_bytes[2]==0x03 && id_bytes[3]==0x04))
+	{
+		std::clog << "PACKAGEZIP: Bad local header for entry " << id << " of '" << m_filename << "'\n";
+		return -1;
+	}
+
+	out_info.file_offset =	out_info.header_offset +
+							sizeof_zipfile_header +
+							4 +
+							fileheader.filename_size +
+							fileheader.extra_size;
+
+	if(static_cast<std::uint64_t>(out_info.file_offset + out_info.size_compressed) > p_source->size())
+		return -1;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_file_info[id].file_offset = out_info.file_offset;
+
+	return 0;
+}
+
+
+//=============================================================================
 //
-//	std::clog << "INFLATE: source_size = " << source_size << " bytes. target_size = " << target_size << "bytes\r\n";
-//	std::clog << debug::hexdump(p_source,source_size) << std::endl;
 //
+//	PACKAGE ZIP - FACTORY CLASS
 //
-//	ade::Inflater inflater;
 //
-//	inflater.inflate((std::uint8_t *)p_source,source_size,p_target,target_size);
+//=============================================================================
 
-#else
-	(void) p_source;
-	(void)source_size;
-	(void)p_target;
-	(void)target_size;
-#endif
+bool
+PackageFactoryZIP::is_supported(const std::string & path)
+{
+	auto pos = path.find_last_of(".");
+
+	if(pos == std::string::npos)
+		return false;
 
+	std::string ext(path.substr(pos+1));
+	std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+	return !!(ext == "zip");
+}
+
+package_shared_ptr
+PackageFactoryZIP::create_package(const std::string & path)
+{
+	auto p_package = std::make_shared<PackageZIP>(path);
+	p_package->set_entry_cache(m_p_entry_cache);
+	p_package->set_settings(m_settings);
+	p_package->set_index_cache(m_p_index_cache);
+	return p_package;
 }
 
 
@@ -25,6 +25,12 @@
 #include <sys/stat.h>
 #include <stdio.h>
 #include "adefs.h"
+#include "entry_cache.h"
+#include "buffer_pool.h"
+#include "data_source.h"
+#include "index_cache.h"
+#include "spill_buffer.h"
+#include "decompressor.h"
 
 namespace adefs { namespace package_zip
 {
@@ -60,7 +66,7 @@ namespace adefs { namespace package_zip
 		std::uint16_t	version;						//	The version of this entry.
 		std::uint16_t	version_needed;					//	The version number needed to decompress this entry.
 		std::uint16_t	flag;							//	??
-		std::uint16_t	compression_method;				//	0 = uncompressed, 8 = deflated.
+		std::uint16_t	compression_method;				//	0 = uncompressed, 8 = deflated, 93 = zstd.
 		std::uint32_t	dos_date;						//
 		std::uint32_t	crc;							//	File CRC.
 		std::uint32_t	size_compressed;				//	The size of the file (compressed).
@@ -82,7 +88,7 @@ namespace adefs { namespace package_zip
 	{
 		std::uint16_t	version;						//	The version of this entry.
 		std::uint16_t	flag;							//	??
-		std::uint16_t	compression_method;				//	0 = uncompressed, 8 = deflated.
+		std::uint16_t	compression_method;				//	0 = uncompressed, 8 = deflated, 93 = zstd.
 		std::uint32_t	dos_date;						//
 		std::uint32_t	crc;							//	File CRC.
 		std::uint32_t	size_compressed;				//	The size of the file (compressed).
@@ -91,6 +97,33 @@ namespace adefs { namespace package_zip
 		std::uint16_t	extra_size;						//	??
 	};
 
+	//-----------------------------------------------------------------------------
+	//	ZIP64 end of central directory locator. This immediately precedes the
+	//	end of central directory record when the package uses ZIP64.
+	//-----------------------------------------------------------------------------
+	struct zip64_central_dir_locator
+	{
+		std::uint32_t	central_dir_disk_num;			//	Number of the disk that contains the ZIP64 end of central directory record.
+		std::uint64_t	central_dir_offset;				//	Offset of the ZIP64 end of central directory record.
+		std::uint32_t	disk_count;						//	Total number of disks.
+	};
+
+	//-----------------------------------------------------------------------------
+	//	ZIP64 end of central directory record.
+	//-----------------------------------------------------------------------------
+	struct zip64_central_dir
+	{
+		std::uint64_t	record_size;					//	Size of the rest of this record.
+		std::uint16_t	version;						//	The version that wrote the record.
+		std::uint16_t	version_needed;					//	The version number needed to extract.
+		std::uint32_t	disk_number;					//	Number of this disk.
+		std::uint32_t	central_dir_disk_num;			//	Number of the disk that contains the start of the central directory.
+		std::uint64_t	dir_entry_count_this_disk;		//	Number of central directory entries on this disk.
+		std::uint64_t	dir_entry_count;				//	Total number of directory entries in the central directory.
+		std::uint64_t	dir_size;						//	Size of the central directory.
+		std::uint64_t	dir_offset;						//	Offset of the start of the central directory.
+	};
+
 	//-----------------------------------------------------------------------------
 	//	GZIP header.
 	//-----------------------------------------------------------------------------
@@ -110,23 +143,53 @@ namespace adefs { namespace package_zip
 	static const size_t	sizeof_dir_entry		= (sizeof(zip_dir_entry)-1);
 	static const size_t	sizeof_zipfile_header	= (sizeof(zip_file_header));
 
+	static const std::uint16_t	ZIP64_EXTRA_ID	= 0x0001;		//	Header id of the ZIP64 extended information extra field.
+	static const std::uint32_t	ZIP64_MARKER	= 0xFFFFFFFF;	//	A 32 bit size or offset of this value is stored in the ZIP64 extra field.
+
 	struct FileInfo
 	{
-		std::int32_t				size_compressed;
-		std::int32_t				size_uncompressed;
-		std::int32_t				file_offset;
-		std::int32_t				dir_entry_file_offset;
+		std::int64_t				size_compressed;
+		std::int64_t				size_uncompressed;
+		std::int64_t				file_offset;				// Offset of the entry's data. -1 until the local header has been read.
+		std::int64_t				header_offset;				// Offset of the entry's local header.
+		std::int64_t				dir_entry_file_offset;
 		std::uint32_t				crc;
 		std::uint16_t				compression_method;
 	};
 
 	enum
 	{
-		ZIP_UNCOMPRESSED	= 0,
-		ZIP_DEFLATED		= 8
+		ZIP_UNCOMPRESSED	= COMPRESSION_STORE,
+		ZIP_DEFLATED		= COMPRESSION_DEFLATE,
+		ZIP_ZSTD			= COMPRESSION_ZSTD
 	};
 #pragma pack(pop)
 
+//-----------------------------------------------------------------------------
+//	Settings for a package. These can be given to the factory so that every
+//	package it creates uses them.
+//-----------------------------------------------------------------------------
+struct Settings
+{
+	size_t							spill_threshold	= 0;		// Entries that decompress to more than this many bytes are
+																// decompressed into a temporary file. Zero disables spilling.
+	std::string						spill_directory;			// Where the temporary files go. Empty uses TMPDIR or /tmp.
+	size_t							batch_max_gap	= 64 * 1024;	// load_batch() reads entries that are no more than this many 
+																// bytes apart with a single read.
+	size_t							batch_max_read	= 8 * 1024 * 1024;	// The most that load_batch() reads at once, unless a single
+																// entry is bigger.
+};
+
+//-----------------------------------------------------------------------------
+//	A file to be loaded by PackageZIP::load_batch().
+//-----------------------------------------------------------------------------
+struct BatchEntry
+{
+	std::string						path;						// The path of the file in the package.
+	std::vector<char>				data;						// Receives the contents of the file.
+	int								result			= -1;		// 0 if the file was loaded.
+};
+
 //=============================================================================
 //
 //
@@ -138,19 +201,21 @@ class FileZIPStore : public IFile
 {
 private:
 	FileInfo						m_fileinfo;
-	std::ifstream					m_zip_file;
-	size_t							m_count;
+	data_source_shared_ptr			m_p_source;						// The package data.
+	std::uint64_t					m_position		= 0;			// Current position in the entry.
+	size_t							m_count			= 0;
+	bool							m_b_fail		= false;
 
 public:
 	FileZIPStore(const FileZIPStore &) = delete;
 	FileZIPStore & operator=(const FileZIPStore & x) = delete;
 
-	FileZIPStore(void);
-	~FileZIPStore(void);
+	FileZIPStore(void) = default;
+	~FileZIPStore(void) = default;
 
-	int								open(	const std::string &	zip_filename,
-											const FileInfo &	fileinfo,
-											std::uint32_t		mode );
+	int								open(	data_source_shared_ptr	p_source,
+											const FileInfo &		fileinfo,
+											std::uint32_t			mode );
 
 	int								get();
 	size_t							read(char * p_buffer,size_t size);
@@ -158,17 +223,72 @@ public:
 	void							ignore(size_t count,int delimeter = -1);
 	void							seek(filepos pos);
 	void							seek(fileoffset offset,adefs::Seek dir);
-	size_t							tell()			{return static_cast<size_t>(m_zip_file.tellg())-m_fileinfo.file_offset;}
-	bool							is_fail() 		{return m_zip_file.fail();}
-	bool							is_eof() 		{return !!(m_zip_file.tellg() >= (m_fileinfo.file_offset + m_fileinfo.size_uncompressed));}
-	size_t							count() 		{return static_cast<size_t>(m_zip_file.gcount());}
+	size_t							tell()			{return static_cast<size_t>(m_position);}
+	bool							is_fail() 		{return m_b_fail;}
+	bool							is_eof() 		{return !!(m_position >= static_cast<std::uint64_t>(m_fileinfo.size_uncompressed));}
+	size_t							count() 		{return m_count;}
 	size_t							size() 			{return m_fileinfo.size_uncompressed;}
 
 private:
-	bool							is_open() const {return !!m_zip_file.is_open();}
+	bool							is_open() const {return !!m_p_source;}
 
 };
 
+//=============================================================================
+//
+//
+//	PACKAGE ZIP - FILE CLASS (STREAM)
+//
+//	Decodes a compressed entry as it is read so that the whole entry never 
+//	has to be held in memory. Reading forwards is cheap but seeking backwards
+//	has to restart the decompressor from the start of the entry.
+//
+//=============================================================================
+class FileZIPStream : public IFile
+{
+private:
+	enum {INPUT_SIZE = 64 * 1024};
+
+	FileInfo						m_fileinfo;
+	data_source_shared_ptr			m_p_source;						// The package data.
+	decompressor_unique_ptr			m_p_decompressor;
+	std::vector<char>				m_input;						// Compressed data read from the package.
+	const std::uint8_t *			m_p_in			= nullptr;		// The next compressed byte to decode.
+	size_t							m_in_avail		= 0;			// Compressed bytes left in the input buffer.
+	size_t							m_consumed		= 0;			// Compressed bytes read from the package so far.
+	size_t							m_position		= 0;			// Current position in the uncompressed data.
+	size_t							m_count			= 0;
+	bool							m_b_fail		= false;
+
+public:
+	FileZIPStream(const FileZIPStream &) = delete;
+	FileZIPStream & operator=(const FileZIPStream &) = delete;
+
+	FileZIPStream(void) = default;
+	~FileZIPStream(void) = default;
+
+	int								open(	data_source_shared_ptr		p_source,
+											const FileInfo &			fileinfo,
+											decompressor_unique_ptr		p_decompressor,
+											std::uint32_t				mode );
+
+	int								get()			{char c; return (read(&c,1) ? static_cast<unsigned char>(c) : EOF);}
+	size_t							read(char * p_buffer,size_t size);
+	void							write(const char * /*p_data*/,size_t /*size*/) {}
+	void							ignore(size_t count,int delimeter = -1);
+	void							seek(filepos pos);
+	void							seek(fileoffset offset,adefs::Seek dir);
+	size_t							tell()			{return m_position;}
+	bool							is_fail() 		{return m_b_fail;}
+	bool							is_eof() 		{return !!(m_position >= static_cast<size_t>(m_fileinfo.size_uncompressed));}
+	size_t							count() 		{return m_count;}
+	size_t							size() 			{return m_fileinfo.size_uncompressed;}
+
+private:
+	int								restart();
+	size_t							decode(char * p_buffer,size_t size);
+};
+
 //=============================================================================
 //
 //
@@ -216,6 +336,16 @@ public:
 	void							add_file(	const std::string & filename,
 												std::int32_t		id );
 
+									// Save and restore the directory's file list for the index cache.
+	void							write_index(IndexWriter & writer) const;
+	int								read_index(IndexReader & reader);
+
+									// Call 'func' with the name and id of each file in the directory.
+	void							for_each_file(const std::function<void(const std::string & name,std::int32_t id)> & func) const;
+
+									// Get the id of a file. Returns -1 if the file is not in the directory.
+	std::int32_t					find_file(const std::string & filename);
+
 	//-------------------------------------------------------------------------
 	//	INTERFACE FUNCTIONS
 	//-------------------------------------------------------------------------
@@ -252,6 +382,9 @@ public:
 class PackageZIP : public IPackage
 {
 private:
+	enum {STREAM_CHUNK_SIZE = 1024 * 1024};						// Compressed data bigger than this is decompressed a chunk at a time.
+	enum {INDEX_VERSION = 1};									// The layout of the cached index. Change it if FileInfo changes.
+
 	struct DirectoryNode
 	{
 		directory_shared_ptr					p_directory;
@@ -262,6 +395,13 @@ private:
 	std::mutex									m_mutex;			// Mutex for exclusive access.
 	std::vector<FileInfo>						m_file_info;		// An array of FileInfo objects. One entry for each file in the package.
 	DirectoryNode								m_root_directory;	// The root node of the directory tree.
+	entry_cache_shared_ptr						m_p_entry_cache;	// Optional cache of decompressed entries.
+	std::uint32_t								m_cache_owner;		// The id that identifies this package's entries in the cache.
+	buffer_pool_shared_ptr						m_p_buffer_pool;	// Scratch buffers for compressed data.
+	data_source_shared_ptr						m_p_source;			// The package data. A file is opened on first use.
+	bool										m_b_own_source;		// True if m_p_source is opened from m_filename.
+	index_cache_shared_ptr						m_p_index_cache;	// Optional on-disk cache of the parsed directory.
+	Settings									m_settings;
 
 	//-------------------------------------------------------------------------
 	// Prevent the object from being copied.
@@ -272,9 +412,22 @@ private:
 
 public:
 	PackageZIP(const std::string & filename);
+
+									// Create a package that reads the archive from a data source rather
+									// than a file, for example an archive inside another package. The 
+									// name is only used in messages. The index cache is not used.
+	PackageZIP(data_source_shared_ptr p_source,const std::string & name);
 	~PackageZIP(void);
 
 	const std::string &				get_filename() const				{return m_filename;}
+	size_t							get_file_count() const				{return m_file_info.size();}
+									// Note that file_offset is -1 until the entry has been opened.
+	const FileInfo *				get_file_info(std::int32_t id) const
+									{
+										if((id>=0) && (id<(std::int32_t)m_file_info.size()))
+											return &m_file_info[id];
+										return nullptr;
+									}
 	size_t							get_filesize(std::int32_t id) const
 									{
 										if((id>=0) && (id<(std::int32_t)m_file_info.size()))
@@ -285,38 +438,107 @@ public:
 	std::unique_ptr<IFile>			openfile(	std::int32_t	id,
 												std::uint32_t	mode = MODE_READ);
 
+									// Read the raw (still compressed) data of an entry.
+	int								read_compressed(std::int32_t id,std::vector<char> & out_data);
+
+									// Load a list of files. The entries are read in the order that they are
+									// stored and entries that are close together are read with a single 
+									// read (see Settings::batch_max_gap), so loading many small files costs
+									// a few large reads rather than one small read each. Returns -1 if any
+									// of the files could not be loaded.
+	int								load_batch(std::vector<BatchEntry> & entries);
+
+									// Set the cache used to hold decompressed entries. The cache may be
+									// shared with other packages. Passing nullptr disables caching.
+	void							set_entry_cache(entry_cache_shared_ptr p_cache);
+	entry_cache_shared_ptr			get_entry_cache() const				{return m_p_entry_cache;}
+
+									// Set the pool of scratch buffers used to hold compressed data while it
+									// is decompressed. Passing nullptr selects the default pool.
+	void							set_buffer_pool(buffer_pool_shared_ptr p_pool);
+	buffer_pool_shared_ptr			get_buffer_pool() const				{return m_p_buffer_pool;}
+
+									// Set the cache that holds the parsed directory between runs. It must
+									// be set before the package is scanned. Passing nullptr disables it.
+	void							set_index_cache(index_cache_shared_ptr p_cache)	{m_p_index_cache = std::move(p_cache);}
+	index_cache_shared_ptr			get_index_cache() const				{return m_p_index_cache;}
+
+	void							set_settings(const Settings & settings)	{m_settings = settings;}
+	const Settings &				get_settings() const				{return m_settings;}
+
 	//-------------------------------------------------------------------------
 	//	PACKAGE INTERFACE FUNCTIONS
 	//-------------------------------------------------------------------------
 	int								mount(MountPoint * p_mountpoint);
 	int								scan();
 	Attributes						attributes() const	{return ATTR_READ;}
+	int								for_each_entry(const package_entry_func & func);
 
 private:
 	std::int32_t					add_file(	const std::string & path,
 												FileInfo &			info );
 
 	DirectoryNode *					get_directory(const std::string & path,bool b_create = false);
-	const FileInfo *				get_file_info(std::int32_t id) const
-									{
-										if((id>=0) && (id<(std::int32_t)m_file_info.size()))
-											return &m_file_info[id];
-										return nullptr;
-									}
+	data_source_shared_ptr			get_source();
+	int								resolve(std::int32_t id,FileInfo & out_info,IDataSource * p_source = nullptr);
+	std::unique_ptr<IFile>			open_stream(std::int32_t id,const FileInfo & info,data_source_shared_ptr p_source);
+	std::int32_t					find_file(const std::string & path);
+	int								extract(	std::int32_t			id,
+												FileInfo &				info,
+												IDataSource &			source,
+												const char *			p_buffer,
+												std::uint64_t			buffer_offset,
+												size_t					buffer_size,
+												std::vector<char> &		out_data );
+	void							list_files(	const DirectoryNode &		dir_node,
+												const std::string &			path,
+												std::vector<std::string> &	out_paths ) const;
+	int								read_zip64_extra(	const char *			p_extra,
+														const zip_dir_entry &	direntry,
+														FileInfo &				info );
+	int								decompress(	const FileInfo &	info,
+												IDecompressor &		decompressor,
+												char *				p_target );
 
 	int								mount_directory(MountPoint *			p_mountpoint,
 													const std::string &		path,
 													DirectoryNode &			dir_node );
 
-	void							inflate(const std::uint8_t *	p_source,
-											size_t					source_size,
-											std::uint8_t *			p_target,
-											size_t					target_size );
+	int								load_index(const IndexCache::Key & key);
+	void							store_index(const IndexCache::Key & key);
+	void							write_directory(IndexWriter & writer,const DirectoryNode & dir_node) const;
+	int								read_directory(IndexReader & reader,DirectoryNode & dir_node);
 
 };
 
+//=============================================================================
+//
+//
+//	PACKAGE FACTORY CLASS
+//
+//
+//=============================================================================
+
+class PackageFactoryZIP : public IPackageFactory
+{
+private:
+	entry_cache_shared_ptr			m_p_entry_cache;	// Cache shared by all of the packages created by this factory.
+	Settings						m_settings;			// Settings given to all of the packages created by this factory.
+	index_cache_shared_ptr			m_p_index_cache;	// Index cache shared by all of the packages created by this factory.
+
+public:
+	explicit PackageFactoryZIP(entry_cache_shared_ptr p_cache = nullptr) : m_p_entry_cache(std::move(p_cache)) {}
+	PackageFactoryZIP(entry_cache_shared_ptr p_cache,const Settings & settings) : m_p_entry_cache(std::move(p_cache)), m_settings(settings) {}
 
+	void							set_index_cache(index_cache_shared_ptr p_cache)	{m_p_index_cache = std::move(p_cache);}
 
+	std::string						name() const override			{return "ZIP";}
+	std::string						description() const	override	{return "PKWARE ZIP Archive";}
+	std::vector<std::string>		file_types() const override		{std::vector<std::string> v;v.push_back("zip");return v;}
+
+	bool							is_supported(const std::string & path) override;
+	package_shared_ptr				create_package(const std::string & path) override;
+};
 
 
 }} // namespace package_zip, adefs
@@ -0,0 +1,137 @@
+//=============================================================================
+//	FILE:					spill_buffer.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Memory buffer backed by a temporary file.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#include <cstdlib>
+#include <vector>
+#include "spill_buffer.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+#endif
+
+namespace adefs
+{
+
+#ifdef _WIN32
+
+SpillBuffer::~SpillBuffer(void)
+{
+}
+
+spill_buffer_shared_ptr
+SpillBuffer::create(size_t /*size*/,const std::string & /*directory*/)
+{
+	return nullptr;
+}
+
+void
+SpillBuffer::seal()
+{
+}
+
+#else
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+//	Open an anonymous temporary file in a directory. The file has no name so
+//	it disappears as soon as it is closed.
+//-----------------------------------------------------------------------------
+int
+open_temp_file(const std::string & directory)
+{
+	int fd = -1;
+
+#ifdef O_TMPFILE
+	fd = ::open(directory.c_str(),O_TMPFILE | O_RDWR | O_CLOEXEC,0600);
+	if(fd >= 0)
+		return fd;
+#endif
+
+	//-------------------------------------------------------------------------
+	//	Not every file system supports O_TMPFILE so fall back to creating a
+	//	named file and removing it straight away.
+	//-------------------------------------------------------------------------
+	std::string			pattern = directory + "/adefs-spill-XXXXXX";
+	std::vector<char>	name(pattern.begin(),pattern.end());
+	name.push_back(0);
+
+	fd = ::mkstemp(name.data());
+	if(fd >= 0)
+	{
+		::unlink(name.data());
+		::fcntl(fd,F_SETFD,FD_CLOEXEC);
+	}
+
+	return fd;
+}
+
+} // anonymous namespace
+
+SpillBuffer::~SpillBuffer(void)
+{
+	if(m_p_data)
+		::munmap(m_p_data,m_size);
+
+	if(m_fd >= 0)
+		::close(m_fd);
+}
+
+spill_buffer_shared_ptr
+SpillBuffer::create(size_t size,const std::string & directory)
+{
+	if(!size)
+		return nullptr;
+
+	std::string dir = directory;
+	if(dir.empty())
+	{
+		const char * p_tmpdir = std::getenv("TMPDIR");
+		dir = (p_tmpdir && *p_tmpdir ? p_tmpdir : "/tmp");
+	}
+
+	auto p_buffer = std::make_shared<SpillBuffer>();
+
+	p_buffer->m_fd = open_temp_file(dir);
+	if(p_buffer->m_fd < 0)
+		return nullptr;
+
+	//-------------------------------------------------------------------------
+	//	Reserve the disk space now. A sparse file would let the mapping be
+	//	created but writing to it would raise SIGBUS if the disk filled up.
+	//-------------------------------------------------------------------------
+	if(::posix_fallocate(p_buffer->m_fd,0,static_cast<off_t>(size)))
+		return nullptr;
+
+	void * p_map = ::mmap(nullptr,size,PROT_READ | PROT_WRITE,MAP_SHARED,p_buffer->m_fd,0);
+	if(p_map == MAP_FAILED)
+		return nullptr;
+
+	p_buffer->m_p_data	= static_cast<char *>(p_map);
+	p_buffer->m_size	= size;
+
+	return p_buffer;
+}
+
+void
+SpillBuffer::seal()
+{
+	if(m_p_data)
+		::mprotect(m_p_data,m_size,PROT_READ);
+}
+
+#endif
+
+} // namespace adefs
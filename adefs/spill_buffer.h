@@ -0,0 +1,69 @@
+//=============================================================================
+//	FILE:					spill_buffer.h
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Memory buffer backed by a temporary file.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+#ifndef GUARD_ADEFS_SPILL_BUFFER_H
+#define GUARD_ADEFS_SPILL_BUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace adefs
+{
+
+//=============================================================================
+//
+//
+//	SPILL BUFFER
+//
+//	A buffer that is mapped from an unlinked temporary file rather than
+//	allocated from the heap. The kernel can write its pages out to the file
+//	and drop them when memory is short, so very large buffers do not have to
+//	stay resident. The file is removed when the buffer is destroyed (or when
+//	the process exits).
+//
+//	Spill buffers are only available on POSIX systems. create() returns
+//	nullptr elsewhere, or if the file could not be created, and the caller
+//	is expected to fall back to an ordinary buffer.
+//
+//=============================================================================
+
+class SpillBuffer
+{
+private:
+	char *							m_p_data	= nullptr;
+	size_t							m_size		= 0;
+	int								m_fd		= -1;
+
+public:
+	SpillBuffer(const SpillBuffer &) = delete;
+	SpillBuffer & operator=(const SpillBuffer &) = delete;
+
+	SpillBuffer(void) = default;
+	~SpillBuffer(void);
+
+									// Create a buffer of 'size' bytes in 'directory'. If directory is
+									// empty then TMPDIR is used, or /tmp if that is not set. The space is
+									// reserved up front so that writing to the buffer can not fail.
+	static std::shared_ptr<SpillBuffer>	create(size_t size,const std::string & directory = std::string());
+
+	char *							data()				{return m_p_data;}
+	const char *					data() const		{return m_p_data;}
+	size_t							size() const		{return m_size;}
+
+									// Make the buffer read only once it has been filled.
+	void							seal();
+};
+
+typedef std::shared_ptr<SpillBuffer>	spill_buffer_shared_ptr;
+
+} // namespace adefs
+
+#endif // ! defined GUARD_ADEFS_SPILL_BUFFER_H
@@ -0,0 +1,135 @@
+//=============================================================================
+//	FILE:					adepak.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Builds ADEPAK packages.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+//
+//	Usage: adefs_adepak [-m store|deflate|zstd] [-l level] <output> <input>...
+//
+//	Each input is a directory on the host file system or a ZIP, GCF or
+//	ADEPAK package. The files from all of the inputs are written to the
+//	output package; where two inputs hold the same path the later one wins.
+//
+//=============================================================================
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include "adefs/package_adepak.h"
+#include "adefs/package_fs.h"
+#include "adefs/package_gcf.h"
+#include "adefs/package_zip.h"
+
+using namespace adefs;
+using namespace adefs::package_adepak;
+
+namespace
+{
+
+int
+usage(const char * p_name)
+{
+	std::cerr << "Usage: " << p_name << " [-m store|deflate|zstd] [-l level] <output> <input>...\n";
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+//	Open an input as a package.
+//-----------------------------------------------------------------------------
+package_shared_ptr
+open_input(const std::string & path)
+{
+	struct stat st;
+	if(::stat(path.c_str(),&st))
+		return nullptr;
+
+	if(S_ISDIR(st.st_mode))
+		return std::make_shared<package_fs::PackageFS>(path);
+
+	std::string ext(path.substr(path.find_last_of('.') + 1));
+	std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+
+	if(ext == "zip")
+		return std::make_shared<package_zip::PackageZIP>(path);
+
+	if(ext == "gcf")
+		return std::make_shared<package_gcf::PackageGCF>(path);
+
+	if(ext == "adepak")
+		return std::make_shared<PackageADEPAK>(path);
+
+	return nullptr;
+}
+
+} // anonymous namespace
+
+int
+main(int argc,char ** argv)
+{
+	WriterADEPAK::Options		options;
+	std::vector<std::string>	paths;
+
+	for(int arg = 1;arg < argc;++arg)
+	{
+		if(!std::strcmp(argv[arg],"-m") && (arg + 1 < argc))
+		{
+			const std::string method(argv[++arg]);
+
+			if(method == "store")
+				options.compression = COMPRESSION_STORE;
+			else if(method == "deflate")
+				options.compression = COMPRESSION_DEFLATE;
+			else if(method == "zstd")
+				options.compression = COMPRESSION_ZSTD;
+			else
+				return usage(argv[0]);
+		}
+		else if(!std::strcmp(argv[arg],"-l") && (arg + 1 < argc))
+			options.level = std::atoi(argv[++arg]);
+		else if(argv[arg][0] == '-')
+			return usage(argv[0]);
+		else
+			paths.push_back(argv[arg]);
+	}
+
+	if(paths.size() < 2)
+		return usage(argv[0]);
+
+	if(!WriterADEPAK::can_compress(options.compression))
+	{
+		std::cerr << "The compression method is not available in this build\n";
+		return 1;
+	}
+
+	WriterADEPAK writer;
+	if(writer.open(paths[0],options))
+	{
+		std::cerr << "Failed to create '" << paths[0] << "'\n";
+		return 1;
+	}
+
+	for(size_t index = 1;index < paths.size();++index)
+	{
+		auto p_package = open_input(paths[index]);
+
+		if(!p_package || p_package->scan() || writer.add_package(*p_package))
+		{
+			std::cerr << "Failed to add '" << paths[index] << "'\n";
+			return 1;
+		}
+	}
+
+	if(writer.close())
+	{
+		std::cerr << "Failed to write '" << paths[0] << "'\n";
+		return 1;
+	}
+
+	return 0;
+}
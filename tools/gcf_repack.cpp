@@ -0,0 +1,844 @@
+//=============================================================================
+//	FILE:					gcf_repack.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Rewrites a fragmented GCF so that every file is in one piece.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+//
+//	Usage: adefs_gcf_repack [-f gcf|zip] [-o order] [-t threads] [-p page_size]
+//							<input.gcf> <output>
+//
+//	Every file in the GCF is read through its block chain and written out
+//	again in one piece.
+//
+//		gcf		A copy of the GCF with the data blocks moved so that the blocks
+//				of each file follow each other. The block entries and the
+//				fragmentation map are rewritten; the directory and checksums
+//				are copied as they are.
+//		zip		A ZIP with every file stored. Files of a page or more start on
+//				a page boundary and smaller ones never cross one.
+//
+//	Files are written in directory order, or in the order of the paths listed
+//	in the 'order' file, one per line. Files that are not listed follow in
+//	directory order. The files are read by several threads (one per core by
+//	default) and the output is written in large sequential blocks.
+//
+//=============================================================================
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "adefs/checksum.h"
+#include "adefs/data_source.h"
+#include "adefs/package_gcf.h"
+#include "adefs/package_zip.h"
+
+using namespace adefs;
+using namespace adefs::package_gcf;
+
+namespace
+{
+
+const size_t			OUTPUT_BUFFER_SIZE	= 8 * 1024 * 1024;		// Writes are gathered into blocks of this size.
+const size_t			READ_WINDOW_SIZE	= 64 * 1024 * 1024;		// How much data can be read ahead of the writer.
+const std::uint16_t		ZIP_ALIGNMENT_ID	= 0xD935;				// Extra field that pads a ZIP entry's data to an alignment.
+
+int
+usage(const char * p_name)
+{
+	std::cerr << "Usage: " << p_name << " [-f gcf|zip] [-o order] [-t threads] [-p page_size] <input.gcf> <output>\n";
+	return 1;
+}
+
+//=============================================================================
+//
+//	OUTPUT FILE
+//
+//	Gathers small writes into large ones.
+//
+//=============================================================================
+class OutputFile
+{
+private:
+	std::FILE *						m_p_file	= nullptr;
+	std::vector<char>				m_buffer;
+	size_t							m_used		= 0;
+	std::uint64_t					m_offset	= 0;			// The offset of the next byte written.
+
+public:
+	OutputFile(const OutputFile &) = delete;
+	OutputFile & operator=(const OutputFile &) = delete;
+
+	OutputFile(void) : m_buffer(OUTPUT_BUFFER_SIZE) {}
+	~OutputFile(void)				{if(m_p_file) std::fclose(m_p_file);}
+
+	std::uint64_t					offset() const		{return m_offset;}
+
+	int
+	open(const std::string & filename)
+	{
+		m_p_file = std::fopen(filename.c_str(),"wb");
+		return (m_p_file ? 0 : -1);
+	}
+
+	int
+	write(const void * p_data,size_t size)
+	{
+		auto p_bytes = static_cast<const char *>(p_data);
+
+		if(!size)
+			return 0;
+
+		m_offset += size;
+
+		if(m_used + size <= m_buffer.size())
+		{
+			std::memcpy(m_buffer.data() + m_used,p_bytes,size);
+			m_used += size;
+			return 0;
+		}
+
+		if(flush())
+			return -1;
+
+		if(size >= m_buffer.size())
+			return (std::fwrite(p_bytes,1,size,m_p_file) == size ? 0 : -1);
+
+		std::memcpy(m_buffer.data(),p_bytes,size);
+		m_used = size;
+
+		return 0;
+	}
+
+	int
+	write_zeros(std::uint64_t size)
+	{
+		static const char zeros[4096] = {0};
+
+		while(size)
+		{
+			const size_t count = static_cast<size_t>(std::min<std::uint64_t>(size,sizeof(zeros)));
+
+			if(write(zeros,count))
+				return -1;
+
+			size -= count;
+		}
+
+		return 0;
+	}
+
+	int
+	flush()
+	{
+		if(m_used && (std::fwrite(m_buffer.data(),1,m_used,m_p_file) != m_used))
+			return -1;
+
+		m_used = 0;
+		return 0;
+	}
+
+	int
+	close()
+	{
+		const int result = flush() | std::fclose(m_p_file);
+		m_p_file = nullptr;
+		return (result ? -1 : 0);
+	}
+};
+
+//=============================================================================
+//
+//	PIPELINE
+//
+//	Reads items on a number of threads and writes them in order on the
+//	calling thread. Readers wait while the data that has been read but not
+//	yet written would go over READ_WINDOW_SIZE. The next item to be written
+//	is always read, so the pipeline can't stall.
+//
+//=============================================================================
+typedef std::function<int(size_t index,std::vector<char> & out_data)>		read_item_func;
+typedef std::function<int(size_t index,const std::vector<char> & data)>	write_item_func;
+
+int
+run_pipeline(	const std::vector<std::uint64_t> &	sizes,
+				unsigned							thread_count,
+				const read_item_func &				read_item,
+				const write_item_func &				write_item )
+{
+	struct Slot
+	{
+		std::vector<char>	data;
+		bool				b_ready		= false;
+		int					result		= 0;
+	};
+
+	std::vector<Slot>		slots(sizes.size());
+	std::mutex				mutex;
+	std::condition_variable	cond;
+	std::atomic<size_t>		next(0);
+	size_t					written		= 0;
+	std::uint64_t			buffered	= 0;
+	bool					b_abort		= false;
+
+	auto worker = [&]()
+	{
+		for(;;)
+		{
+			const size_t index = next++;
+			if(index >= sizes.size())
+				break;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock,[&] {return b_abort || (index == written) || (buffered + sizes[index] <= READ_WINDOW_SIZE);});
+
+				if(b_abort)
+					break;
+
+				buffered += sizes[index];
+			}
+
+			std::vector<char>	data;
+			const int			result = read_item(index,data);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			slots[index].data		= std::move(data);
+			slots[index].result		= result;
+			slots[index].b_ready	= true;
+			cond.notify_all();
+		}
+	};
+
+	if(!thread_count)
+		thread_count = std::max(1u,std::thread::hardware_concurrency());
+
+	std::vector<std::thread> threads;
+	int result = 0;
+
+	try
+	{
+		for(unsigned index = 0;index < thread_count;++index)
+			threads.emplace_back(worker);
+	}
+	catch(...)
+	{
+		if(threads.empty())
+			result = -1;
+	}
+
+	for(size_t index = 0;!result && (index < sizes.size());++index)
+	{
+		std::vector<char> data;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock,[&] {return slots[index].b_ready;});
+
+			data.swap(slots[index].data);
+			result = slots[index].result;
+		}
+
+		if(!result)
+			result = write_item(index,data);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		buffered -= sizes[index];
+		++written;
+		cond.notify_all();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		b_abort = true;
+		cond.notify_all();
+	}
+
+	for(auto & thread : threads)
+		thread.join();
+
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	Put the files in the order that they will be written. Files listed in
+//	the order file come first.
+//-----------------------------------------------------------------------------
+int
+order_files(const std::vector<std::string> &	paths,
+			const std::string &					order_filename,
+			std::vector<std::uint32_t> &		out_ids )
+{
+	std::vector<char> b_placed(paths.size(),0);
+
+	out_ids.clear();
+
+	if(!order_filename.empty())
+	{
+		std::ifstream in(order_filename);
+		if(!in)
+		{
+			std::cerr << "Failed to read '" << order_filename << "'\n";
+			return -1;
+		}
+
+		std::unordered_map<std::string,std::uint32_t> ids;
+		for(std::uint32_t id = 0;id < paths.size();++id)
+			if(!paths[id].empty())
+				ids[paths[id]] = id;
+
+		std::string	line;
+		size_t		unknown = 0;
+
+		while(std::getline(in,line))
+		{
+			line.erase(line.find_last_not_of(" \t\r\n") + 1);
+			std::replace(line.begin(),line.end(),'\\','/');
+			std::transform(line.begin(),line.end(),line.begin(),::tolower);
+			line.erase(0,line.find_first_not_of('/'));
+
+			if(line.empty())
+				continue;
+
+			auto ifind = ids.find(line);
+			if(ifind == ids.end())
+				++unknown;
+			else if(!b_placed[ifind->second])
+			{
+				b_placed[ifind->second] = 1;
+				out_ids.push_back(ifind->second);
+			}
+		}
+
+		if(unknown)
+			std::cerr << unknown << " paths in '" << order_filename << "' are not in the package\n";
+	}
+
+	for(std::uint32_t id = 0;id < paths.size();++id)
+		if(!paths[id].empty() && !b_placed[id])
+			out_ids.push_back(id);
+
+	return 0;
+}
+
+//=============================================================================
+//
+//	GCF OUTPUT
+//
+//=============================================================================
+int
+repack_gcf(	PackageGCF &						package,
+			const std::vector<std::uint32_t> &	file_ids,
+			unsigned							thread_count,
+			OutputFile &						output,
+			std::uint64_t &						out_bytes )
+{
+	auto p_source = package.get_source();
+	if(!p_source)
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Everything up to the first data block is copied, with the block entries
+	//	and the fragmentation map changed.
+	//-------------------------------------------------------------------------
+	const std::uint64_t	block_size		= package.get_blocksize();
+	const std::uint64_t	first_block		= package.get_first_block_offset();
+	const std::uint64_t	header_size		= sizeof(GCFHeader) + sizeof(GCFBlockEntryHeader);
+	std::vector<char>	metadata(static_cast<size_t>(first_block));
+
+	if(		!block_size
+		||	(first_block < header_size)
+		||	(p_source->read_at(0,metadata.data(),metadata.size()) != metadata.size()) )
+		return -1;
+
+	GCFBlockEntryHeader block_entry_header;
+	std::memcpy(&block_entry_header,metadata.data() + sizeof(GCFHeader),sizeof(GCFBlockEntryHeader));
+
+	const std::uint64_t	frag_header_offset	= header_size + (sizeof(GCFBlockEntry) * static_cast<std::uint64_t>(block_entry_header.BlockCount));
+	GCFFragMapHeader	frag_header;
+
+	if(frag_header_offset + sizeof(GCFFragMapHeader) > metadata.size())
+		return -1;
+
+	std::memcpy(&frag_header,metadata.data() + frag_header_offset,sizeof(GCFFragMapHeader));
+
+	const std::uint64_t	frag_map_offset	= frag_header_offset + sizeof(GCFFragMapHeader);
+	const std::uint32_t	data_blocks		= frag_header.BlockCount;
+
+	if(frag_map_offset + (sizeof(std::uint32_t) * static_cast<std::uint64_t>(data_blocks)) > metadata.size())
+		return -1;
+
+	auto p_entries	= reinterpret_cast<GCFBlockEntry *>(metadata.data() + header_size);
+	auto p_frag_map	= reinterpret_cast<std::uint32_t *>(metadata.data() + frag_map_offset);
+
+	//-------------------------------------------------------------------------
+	//	Order the block entries: those of the files in file order, then any
+	//	others that have data.
+	//-------------------------------------------------------------------------
+	std::vector<std::uint32_t>	entries;
+	std::vector<char>			b_listed(block_entry_header.BlockCount,0);
+
+	for(auto id : file_ids)
+	{
+		std::uint32_t entry_index;
+		std::uint32_t size;
+
+		if(		package.get_file_info(id,entry_index,size)
+			&&	(entry_index < block_entry_header.BlockCount)
+			&&	!b_listed[entry_index] )
+		{
+			b_listed[entry_index] = 1;
+			entries.push_back(entry_index);
+		}
+	}
+
+	for(std::uint32_t index = 0;index < block_entry_header.BlockCount;++index)
+		if(!b_listed[index] && (p_entries[index].FirstDataBlockIndex < data_blocks))
+			entries.push_back(index);
+
+	//-------------------------------------------------------------------------
+	//	Walk each entry's chain and give its blocks new numbers in order. The
+	//	value that ends a chain is kept from the original.
+	//-------------------------------------------------------------------------
+	std::vector<std::vector<std::uint32_t>>	chains(entries.size());
+	std::vector<std::uint64_t>				sizes(entries.size());
+	std::vector<char>						b_used(data_blocks,0);
+	std::uint32_t							terminator	= data_blocks;
+	bool									b_terminator = false;
+	std::uint32_t							new_block	= 0;
+
+	for(size_t item = 0;item < entries.size();++item)
+	{
+		GCFBlockEntry &		entry	= p_entries[entries[item]];
+		const std::uint64_t	count	= std::max<std::uint64_t>(1,(entry.FileDataSize + block_size - 1) / block_size);
+		std::uint32_t		block	= entry.FirstDataBlockIndex;
+
+		while((block < data_blocks) && (chains[item].size() < count) && !b_used[block])
+		{
+			b_used[block] = 1;
+			chains[item].push_back(block);
+			block = p_frag_map[block];
+		}
+
+		if(!b_terminator && (block >= data_blocks))
+		{
+			terminator		= block;
+			b_terminator	= true;
+		}
+
+		if(!chains[item].empty())
+			entry.FirstDataBlockIndex = new_block;
+
+		new_block	+= static_cast<std::uint32_t>(chains[item].size());
+		sizes[item]	= chains[item].size() * block_size;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Build the new fragmentation map. Unused blocks go at the end.
+	//-------------------------------------------------------------------------
+	const std::uint32_t	used_blocks	= new_block;
+	std::uint32_t		block		= 0;
+
+	for(auto & chain : chains)
+	{
+		for(size_t index = 0;index < chain.size();++index,++block)
+			p_frag_map[block] = (index + 1 < chain.size() ? block + 1 : terminator);
+	}
+
+	for(;block < data_blocks;++block)
+		p_frag_map[block] = terminator;
+
+	//-------------------------------------------------------------------------
+	//	The header holds the index of the first unused block. Its checksum is
+	//	the sum of the other fields, so it is only updated if it was right.
+	//-------------------------------------------------------------------------
+	if(frag_header.Checksum == frag_header.BlockCount + frag_header.Dummy0 + frag_header.Dummy1)
+		frag_header.Checksum = frag_header.BlockCount + used_blocks + frag_header.Dummy1;
+
+	frag_header.Dummy0 = used_blocks;
+	std::memcpy(metadata.data() + frag_header_offset,&frag_header,sizeof(GCFFragMapHeader));
+
+	if(output.write(metadata.data(),metadata.size()))
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Copy the data blocks.
+	//-------------------------------------------------------------------------
+	auto read_item = [&](size_t item,std::vector<char> & out_data) -> int
+	{
+		const auto & chain = chains[item];
+
+		out_data.resize(static_cast<size_t>(sizes[item]));
+
+		for(size_t index = 0;index < chain.size();)
+		{
+			size_t count = 1;
+			while((index + count < chain.size()) && (chain[index + count] == chain[index] + count))
+				++count;
+
+			const std::uint64_t	offset	= first_block + (chain[index] * block_size);
+			const size_t		size	= static_cast<size_t>(count * block_size);
+
+			if(p_source->read_at(offset,out_data.data() + (index * block_size),size) != size)
+				return -1;
+
+			index += count;
+		}
+
+		return 0;
+	};
+
+	auto write_item = [&](size_t /*item*/,const std::vector<char> & data) -> int
+	{
+		out_bytes += data.size();
+		return output.write(data.data(),data.size());
+	};
+
+	if(run_pipeline(sizes,thread_count,read_item,write_item))
+		return -1;
+
+	if(output.write_zeros(static_cast<std::uint64_t>(data_blocks - used_blocks) * block_size))
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Copy anything that follows the data blocks.
+	//-------------------------------------------------------------------------
+	std::uint64_t		offset	= first_block + (data_blocks * block_size);
+	std::vector<char>	buffer(OUTPUT_BUFFER_SIZE);
+
+	while(offset < p_source->size())
+	{
+		const size_t size = p_source->read_at(offset,buffer.data(),buffer.size());
+		if(!size || output.write(buffer.data(),size))
+			return -1;
+
+		offset += size;
+	}
+
+	return 0;
+}
+
+//=============================================================================
+//
+//	ZIP OUTPUT
+//
+//=============================================================================
+struct ZipEntry
+{
+	std::string							path;
+	std::uint64_t						size;
+	std::uint64_t						header_offset;
+	std::uint32_t						crc;
+};
+
+void
+append(std::vector<char> & buffer,const void * p_data,size_t size)
+{
+	buffer.insert(buffer.end(),static_cast<const char *>(p_data),static_cast<const char *>(p_data) + size);
+}
+
+template<typename T>
+void
+append_value(std::vector<char> & buffer,T value)
+{
+	append(buffer,&value,sizeof(T));
+}
+
+int
+repack_zip(	PackageGCF &						package,
+			const std::vector<std::string> &	paths,
+			const std::vector<std::uint32_t> &	file_ids,
+			unsigned							thread_count,
+			std::uint32_t						page_size,
+			OutputFile &						output,
+			std::uint64_t &						out_bytes )
+{
+	using namespace adefs::package_zip;
+
+	const std::uint32_t		DOS_DATE	= 0x00210000;		// 1-JAN-1980 00:00.
+	std::vector<ZipEntry>	entries(file_ids.size());
+	std::vector<std::uint64_t> sizes(file_ids.size());
+
+	for(size_t item = 0;item < file_ids.size();++item)
+	{
+		std::uint32_t block_index;
+		std::uint32_t size = 0;
+
+		package.get_file_info(file_ids[item],block_index,size);
+
+		entries[item].path	= paths[file_ids[item]];
+		entries[item].size	= size;
+		sizes[item]			= size;
+	}
+
+	auto read_item = [&](size_t item,std::vector<char> & out_data) -> int
+	{
+		FileGCF file(file_ids[item],MODE_READ,&package);
+
+		out_data.resize(static_cast<size_t>(sizes[item]));
+
+		if(file.is_fail() || (file.read(out_data.data(),out_data.size()) != out_data.size()))
+			return -1;
+
+		entries[item].crc = crc32(out_data.data(),out_data.size());
+		return 0;
+	};
+
+	//-------------------------------------------------------------------------
+	//	Each entry is written with an extra field that pads its data to the
+	//	right alignment.
+	//-------------------------------------------------------------------------
+	std::vector<char> header;
+
+	auto write_item = [&](size_t item,const std::vector<char> & data) -> int
+	{
+		ZipEntry &		entry		= entries[item];
+		const bool		b_zip64		= (entry.size >= ZIP64_MARKER);
+		zip_file_header	file_header;
+
+		entry.header_offset = output.offset();
+
+		file_header.version				= (b_zip64 ? 45 : 10);
+		file_header.flag				= 0;
+		file_header.compression_method	= ZIP_UNCOMPRESSED;
+		file_header.dos_date			= DOS_DATE;
+		file_header.crc					= entry.crc;
+		file_header.size_compressed		= (b_zip64 ? ZIP64_MARKER : static_cast<std::uint32_t>(entry.size));
+		file_header.size_uncompressed	= file_header.size_compressed;
+		file_header.filename_size		= static_cast<std::uint16_t>(entry.path.size());
+
+		std::uint64_t data_offset = entry.header_offset + 4 + sizeof_zipfile_header + entry.path.size() + (b_zip64 ? 20 : 0) + 6;
+		std::uint64_t padding = 0;
+
+		if(page_size && entry.size)
+		{
+			const std::uint64_t page_offset = data_offset % page_size;
+
+			if((entry.size >= page_size) || (page_offset + entry.size > page_size))
+				padding = (page_size - page_offset) % page_size;
+		}
+
+		file_header.extra_size = static_cast<std::uint16_t>((b_zip64 ? 20 : 0) + 6 + padding);
+
+		header.clear();
+		append(header,"PK\x03\x04",4);
+		append(header,&file_header,sizeof_zipfile_header);
+		append(header,entry.path.data(),entry.path.size());
+
+		if(b_zip64)
+		{
+			append_value<std::uint16_t>(header,ZIP64_EXTRA_ID);
+			append_value<std::uint16_t>(header,16);
+			append_value<std::uint64_t>(header,entry.size);
+			append_value<std::uint64_t>(header,entry.size);
+		}
+
+		append_value<std::uint16_t>(header,ZIP_ALIGNMENT_ID);
+		append_value<std::uint16_t>(header,static_cast<std::uint16_t>(2 + padding));
+		append_value<std::uint16_t>(header,static_cast<std::uint16_t>(std::min<std::uint32_t>(page_size,0xFFFF)));
+		header.resize(header.size() + static_cast<size_t>(padding),0);
+
+		out_bytes += data.size();
+
+		return ((output.write(header.data(),header.size()) || output.write(data.data(),data.size())) ? -1 : 0);
+	};
+
+	if(page_size > 0xFFFF)
+	{
+		std::cerr << "The page size must be less than 64KB\n";
+		return -1;
+	}
+
+	if(run_pipeline(sizes,thread_count,read_item,write_item))
+		return -1;
+
+	//-------------------------------------------------------------------------
+	//	Write the central directory.
+	//-------------------------------------------------------------------------
+	const std::uint64_t dir_offset = output.offset();
+
+	for(auto & entry : entries)
+	{
+		zip_dir_entry	dir_entry;
+		std::vector<char> extra;
+
+		if(entry.size >= ZIP64_MARKER)
+		{
+			append_value<std::uint64_t>(extra,entry.size);
+			append_value<std::uint64_t>(extra,entry.size);
+		}
+
+		if(entry.header_offset >= ZIP64_MARKER)
+			append_value<std::uint64_t>(extra,entry.header_offset);
+
+		dir_entry.version				= 45;
+		dir_entry.version_needed		= (extra.empty() ? 10 : 45);
+		dir_entry.flag					= 0;
+		dir_entry.compression_method	= ZIP_UNCOMPRESSED;
+		dir_entry.dos_date				= DOS_DATE;
+		dir_entry.crc					= entry.crc;
+		dir_entry.size_compressed		= static_cast<std::uint32_t>(std::min<std::uint64_t>(entry.size,ZIP64_MARKER));
+		dir_entry.size_uncompressed		= dir_entry.size_compressed;
+		dir_entry.filename_size			= static_cast<std::uint16_t>(entry.path.size());
+		dir_entry.extra_size			= static_cast<std::uint16_t>(extra.empty() ? 0 : 4 + extra.size());
+		dir_entry.comment_size			= 0;
+		dir_entry.disk_num_start		= 0;
+		dir_entry.internal_fa			= 0;
+		dir_entry.external_fa			= 0;
+		dir_entry.file_offset			= static_cast<std::uint32_t>(std::min<std::uint64_t>(entry.header_offset,ZIP64_MARKER));
+
+		header.clear();
+		append(header,"PK\x01\x02",4);
+		append(header,&dir_entry,sizeof_dir_entry);
+		append(header,entry.path.data(),entry.path.size());
+
+		if(!extra.empty())
+		{
+			append_value<std::uint16_t>(header,ZIP64_EXTRA_ID);
+			append_value<std::uint16_t>(header,static_cast<std::uint16_t>(extra.size()));
+			append(header,extra.data(),extra.size());
+		}
+
+		if(output.write(header.data(),header.size()))
+			return -1;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Write the end of central directory records.
+	//-------------------------------------------------------------------------
+	const std::uint64_t	dir_size	= output.offset() - dir_offset;
+	const bool			b_zip64		= (entries.size() >= 0xFFFF) || (dir_offset >= ZIP64_MARKER) || (dir_size >= ZIP64_MARKER);
+
+	header.clear();
+
+	if(b_zip64)
+	{
+		zip64_central_dir			central_dir64;
+		zip64_central_dir_locator	locator;
+
+		central_dir64.record_size				= sizeof(zip64_central_dir) - sizeof(std::uint64_t);
+		central_dir64.version					= 45;
+		central_dir64.version_needed			= 45;
+		central_dir64.disk_number				= 0;
+		central_dir64.central_dir_disk_num		= 0;
+		central_dir64.dir_entry_count_this_disk	= entries.size();
+		central_dir64.dir_entry_count			= entries.size();
+		central_dir64.dir_size					= dir_size;
+		central_dir64.dir_offset				= dir_offset;
+
+		locator.central_dir_disk_num			= 0;
+		locator.central_dir_offset				= output.offset();
+		locator.disk_count						= 1;
+
+		append(header,"PK\x06\x06",4);
+		append(header,&central_dir64,sizeof(zip64_central_dir));
+		append(header,"PK\x06\x07",4);
+		append(header,&locator,sizeof(zip64_central_dir_locator));
+	}
+
+	zip_central_dir central_dir;
+
+	central_dir.disk_number					= 0;
+	central_dir.central_dir_disk_num		= 0;
+	central_dir.dir_entry_count_this_disk	= static_cast<std::uint16_t>(std::min<size_t>(entries.size(),0xFFFF));
+	central_dir.dir_entry_count				= central_dir.dir_entry_count_this_disk;
+	central_dir.dir_size					= static_cast<std::uint32_t>(std::min<std::uint64_t>(dir_size,ZIP64_MARKER));
+	central_dir.dir_offset					= static_cast<std::uint32_t>(std::min<std::uint64_t>(dir_offset,ZIP64_MARKER));
+	central_dir.comment_length				= 0;
+
+	append(header,"PK\x05\x06",4);
+	append(header,&central_dir,sizeof_central_dir);
+
+	return output.write(header.data(),header.size());
+}
+
+} // anonymous namespace
+
+int
+main(int argc,char ** argv)
+{
+	std::string					format("gcf");
+	std::string					order_filename;
+	unsigned					thread_count	= 0;
+	std::uint32_t				page_size		= 4096;
+	std::vector<std::string>	paths;
+
+	for(int arg = 1;arg < argc;++arg)
+	{
+		if(!std::strcmp(argv[arg],"-f") && (arg + 1 < argc))
+			format = argv[++arg];
+		else if(!std::strcmp(argv[arg],"-o") && (arg + 1 < argc))
+			order_filename = argv[++arg];
+		else if(!std::strcmp(argv[arg],"-t") && (arg + 1 < argc))
+			thread_count = static_cast<unsigned>(std::atoi(argv[++arg]));
+		else if(!std::strcmp(argv[arg],"-p") && (arg + 1 < argc))
+			page_size = static_cast<std::uint32_t>(std::atoi(argv[++arg]));
+		else if(argv[arg][0] == '-')
+			return usage(argv[0]);
+		else
+			paths.push_back(argv[arg]);
+	}
+
+	if((paths.size() != 2) || ((format != "gcf") && (format != "zip")))
+		return usage(argv[0]);
+
+	//-------------------------------------------------------------------------
+	//	Open the GCF and decide the order of the files.
+	//-------------------------------------------------------------------------
+	PackageGCF package(paths[0]);
+
+	if(package.scan() || !package.get_file_count())
+	{
+		std::cerr << "Failed to read '" << paths[0] << "'\n";
+		return 1;
+	}
+
+	std::vector<std::string>	file_paths;
+	std::vector<std::uint32_t>	file_ids;
+
+	package.list_files(file_paths);
+
+	if(order_files(file_paths,order_filename,file_ids))
+		return 1;
+
+	//-------------------------------------------------------------------------
+	//	Write the output.
+	//-------------------------------------------------------------------------
+	OutputFile output;
+
+	if(output.open(paths[1]))
+	{
+		std::cerr << "Failed to create '" << paths[1] << "'\n";
+		return 1;
+	}
+
+	const auto		start	= std::chrono::steady_clock::now();
+	std::uint64_t	bytes	= 0;
+	const int		result	= (format == "gcf"	? repack_gcf(package,file_ids,thread_count,output,bytes)
+												: repack_zip(package,file_paths,file_ids,thread_count,page_size,output,bytes));
+
+	if(result || output.close())
+	{
+		std::cerr << "Failed to write '" << paths[1] << "'\n";
+		return 1;
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout	<< file_ids.size() << " files, " << (bytes / (1024.0 * 1024.0)) << " MB of data in " << seconds << " s ("
+				<< (seconds > 0 ? (bytes / (1024.0 * 1024.0)) / seconds : 0.0) << " MB/s)\n";
+
+	return 0;
+}
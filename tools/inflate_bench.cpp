@@ -0,0 +1,127 @@
+//=============================================================================
+//	FILE:					inflate_bench.cpp
+//	SYSTEM:				Ade's Virtual File System
+//	DESCRIPTION:	Compares the throughput of the decompressor backends.
+//-----------------------------------------------------------------------------
+//  COPYRIGHT:		(C) Copyright 2026 Adrian Purser. All Rights Reserved.
+//	LICENCE:			MIT - See LICENSE file for details
+//	MAINTAINER:		Adrian Purser <ade@adrianpurser.co.uk>
+//	CREATED:			18-OCT-2026 Adrian Purser <ade@adrianpurser.co.uk>
+//=============================================================================
+//
+//	Usage: adefs_inflate_bench <zipfile> [passes]
+//
+//	Every entry in the ZIP file is decompressed with each backend that is
+//	registered for the entry's compression method. The compressed data is
+//	read into memory first so only the decompression is timed.
+//
+//=============================================================================
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include "adefs/package_zip.h"
+
+using namespace adefs;
+using namespace adefs::package_zip;
+
+namespace
+{
+
+struct Entry
+{
+	std::vector<char>		compressed;
+	size_t					size_uncompressed;
+};
+
+} // anonymous namespace
+
+int
+main(int argc,char ** argv)
+{
+	if(argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <zipfile> [passes]\n";
+		return 1;
+	}
+
+	const int passes = (argc > 2 ? std::max(1,std::atoi(argv[2])) : 3);
+
+	PackageZIP package(argv[1]);
+	if(package.scan())
+	{
+		std::cerr << "Failed to read '" << argv[1] << "'\n";
+		return 1;
+	}
+
+	//-------------------------------------------------------------------------
+	//	Load the compressed entries grouped by compression method.
+	//-------------------------------------------------------------------------
+	std::map<std::uint16_t,std::vector<Entry>>	entries;
+	size_t										max_size = 0;
+
+	for(size_t id = 0;id < package.get_file_count();++id)
+	{
+		auto p_info = package.get_file_info(static_cast<std::int32_t>(id));
+		if(!p_info || (p_info->compression_method == ZIP_UNCOMPRESSED))
+			continue;
+
+		Entry entry;
+		if(package.read_compressed(static_cast<std::int32_t>(id),entry.compressed))
+			continue;
+
+		entry.size_uncompressed	= p_info->size_uncompressed;
+		max_size				= std::max(max_size,entry.size_uncompressed);
+		entries[p_info->compression_method].push_back(std::move(entry));
+	}
+
+	std::vector<std::uint8_t> output(max_size);
+
+	//-------------------------------------------------------------------------
+	//	Time each backend. The best pass is reported.
+	//-------------------------------------------------------------------------
+	auto & registry = DecompressorRegistry::instance();
+
+	for(auto & method : entries)
+	{
+		size_t total = 0;
+		for(auto & entry : method.second)
+			total += entry.size_uncompressed;
+
+		std::cout << "Method " << method.first << ": " << method.second.size() << " entries, " << total << " bytes (default '" << registry.selected(method.first) << "')\n";
+
+		for(auto & name : registry.backends(method.first))
+		{
+			auto p_decompressor = registry.create(method.first,name);
+			if(!p_decompressor)
+				continue;
+
+			double	best	= 0.0;
+			size_t	errors	= 0;
+
+			for(int pass = 0;pass < passes;++pass)
+			{
+				auto start = std::chrono::steady_clock::now();
+
+				for(auto & entry : method.second)
+				{
+					if(p_decompressor->decompress(	reinterpret_cast<const std::uint8_t *>(entry.compressed.data()),entry.compressed.size(),
+													output.data(),entry.size_uncompressed ))
+						++errors;
+				}
+
+				const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				if(elapsed.count() > 0.0)
+					best = std::max(best,(static_cast<double>(total) / (1024.0 * 1024.0)) / elapsed.count());
+			}
+
+			std::cout << "  " << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << best << " MB/s";
+			if(errors)
+				std::cout << "  (" << errors << " errors)";
+			std::cout << '\n';
+		}
+	}
+
+	return 0;
+}